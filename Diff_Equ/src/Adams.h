@@ -0,0 +1,195 @@
+#pragma once
+#include <cmath>
+
+#include "Adaptive.h"
+#include "Integrators.h"
+
+//fourth order Adams-Bashforth-Moulton in PEC mode: AB4 predicts, one evaluation at the prediction,
+//AM4 corrects, and the corrected state is not evaluated again, so a step costs exactly one evaluation.
+//the error is Milne's estimate 19/270 (corrected - predicted), which is also taken off the corrected
+//state (local extrapolation, about 1.3x fewer steps for the same final error). the last four
+//derivatives live in a ring buffer at equal spacing; a step size change re-samples that buffer from
+//its interpolating cubic instead of restarting. the first three steps come from rk4
+template <typename T, typename F>
+class AdamsBashforthMoulton {
+public:
+	static const int history = 4;
+
+	AdamsBashforthMoulton(F& f, Tolerance tolerance) : f(f), tolerance(tolerance) {}
+
+	//first_step 0 picks one from the local derivative scale
+	void start(T t0, T x0, T y0, T first_step = T(0)) {
+		t = previous_t = t0;
+		x = x0;
+		y = y0;
+		last_h = T(0);
+		stats = StepStats();
+		head = 0;
+		filled = 0;
+
+		T dx, dy;
+		eval(t, x, y, dx, dy);
+		push(dx, dy);
+		h = first_step > T(0) ? first_step : initial_step(f, tolerance, 4, t, x, y, dx, dy, stats);
+	}
+
+	//one accepted step that never passes t_stop. false once t_stop is reached,
+	//or when the step size underflows or the solution stops being finite
+	bool step(T t_stop) {
+		if (!(t < t_stop))
+			return false;
+
+		while (true) {
+			if (!(h > T(0)) || (double)h <= std::fabs((double)t) * 1e-15)
+				return false;
+			if (t + h >= t_stop)
+				resize(t_stop - t);
+
+			if (filled < history)
+				return bootstrap(t_stop);
+
+			//AB4 from the history, newest first
+			T px = x + h / T(24) * (T(55) * fx(0) - T(59) * fx(1) + T(37) * fx(2) - T(9) * fx(3));
+			T py = y + h / T(24) * (T(55) * fy(0) - T(59) * fy(1) + T(37) * fy(2) - T(9) * fy(3));
+			T dx, dy;
+			eval(t + h, px, py, dx, dy);
+			T cx = x + h / T(24) * (T(9) * dx + T(19) * fx(0) - T(5) * fx(1) + fx(2));
+			T cy = y + h / T(24) * (T(9) * dy + T(19) * fy(0) - T(5) * fy(1) + fy(2));
+
+			const T milne = T(19) / T(270);
+			double error = error_norm(tolerance, milne * (cx - px), milne * (cy - py), x, y, cx, cy);
+			if (!std::isfinite(error) || error > 1.0) {
+				double shrink = std::isfinite(error) ? 0.9 * std::pow(error, -0.2) : 0.2;
+				resize(h * T(shrink < 0.2 ? 0.2 : shrink));
+				stats.rejected++;
+				continue;
+			}
+
+			accept(cx - milne * (cx - px), cy - milne * (cy - py), dx, dy, t_stop);
+			//every resize costs interpolation error, so small gains keep the current spacing
+			double grow = error > 1e-10 ? 0.9 * std::pow(error, -0.2) : 2.0;
+			if (grow > 1.5 && t < t_stop)
+				resize(h * T(grow > 2.0 ? 2.0 : grow));
+			return true;
+		}
+	}
+
+	//state anywhere inside the last accepted step [previous_t, t], cubic Hermite on the end derivatives
+	void dense(T time, T& out_x, T& out_y) const {
+		if (!(last_h > T(0))) {
+			out_x = x;
+			out_y = y;
+			return;
+		}
+		T s = (time - previous_t) / last_h;
+		T s2 = s * s;
+		T s3 = s2 * s;
+		T h00 = T(2) * s3 - T(3) * s2 + T(1);
+		T h10 = s3 - T(2) * s2 + s;
+		T h01 = T(3) * s2 - T(2) * s3;
+		T h11 = s3 - s2;
+		out_x = h00 * px0 + h10 * last_h * pdx + h01 * x + h11 * last_h * ndx;
+		out_y = h00 * py0 + h10 * last_h * pdy + h01 * y + h11 * last_h * ndy;
+	}
+
+	T t = T(0);
+	T x = T(0);
+	T y = T(0);
+	T previous_t = T(0);
+	T h = T(0);                 //step size of the history spacing, the next step to try
+	StepStats stats;
+
+private:
+	void eval(T time, T ex, T ey, T& dx, T& dy) {
+		stats.evaluations++;
+		f(time, ex, ey, dx, dy);
+	}
+
+	//j steps back from the newest entry
+	T fx(int j) const { return ring_x[(head - j + history) % history]; }
+	T fy(int j) const { return ring_y[(head - j + history) % history]; }
+
+	void push(T dx, T dy) {
+		head = (head + 1) % history;
+		ring_x[head] = dx;
+		ring_y[head] = dy;
+		if (filled < history)
+			filled++;
+	}
+
+	void accept(T nx, T ny, T dx, T dy, T t_stop) {
+		px0 = x;
+		py0 = y;
+		pdx = fx(0);
+		pdy = fy(0);
+		ndx = dx;
+		ndy = dy;
+		previous_t = t;
+		t = t + h >= t_stop ? t_stop : t + h;
+		x = nx;
+		y = ny;
+		last_h = h;
+		push(dx, dy);
+		stats.accepted++;
+	}
+
+	//rk4 steps at the starting spacing until the buffer holds four derivatives. no error control here,
+	//the starting step is already sized for a fourth order method
+	bool bootstrap(T t_stop) {
+		T nx = x;
+		T ny = y;
+		rk4_step(f, t, nx, ny, h);
+		stats.evaluations += 4;
+		T dx, dy;
+		eval(t + h, nx, ny, dx, dy);
+		if (!std::isfinite((double)nx) || !std::isfinite((double)ny))
+			return false;
+		accept(nx, ny, dx, dy, t_stop);
+		return true;
+	}
+
+	//re-samples the derivative history at spacing next from the cubic through the current entries
+	void resize(T next) {
+		if (filled < history) {
+			//while bootstrapping there is no polynomial yet, restart from the newest derivative
+			T dx = fx(0), dy = fy(0);
+			filled = 0;
+			push(dx, dy);
+			h = next;
+			return;
+		}
+		T ratio = next / h;
+		T old_x[history], old_y[history];
+		for (int j = 0; j < history; j++) {
+			old_x[j] = fx(j);
+			old_y[j] = fy(j);
+		}
+		for (int j = 0; j < history; j++) {
+			//Lagrange basis on nodes 0, -1, -2, -3 (units of the old h) at -j ratio
+			T s = -T(j) * ratio;
+			T nx = T(0), ny = T(0);
+			for (int i = 0; i < history; i++) {
+				T basis = T(1);
+				for (int m = 0; m < history; m++) {
+					if (m != i)
+						basis = basis * (s + T(m)) / T(m - i);
+				}
+				nx += basis * old_x[i];
+				ny += basis * old_y[i];
+			}
+			ring_x[(head - j + history) % history] = nx;
+			ring_y[(head - j + history) % history] = ny;
+		}
+		h = next;
+	}
+
+	F& f;
+	Tolerance tolerance;
+	T ring_x[history], ring_y[history];
+	int head = 0;
+	int filled = 0;
+	//ends of the last step for dense output, a resize re-samples the ring afterwards
+	T px0 = T(0), py0 = T(0), pdx = T(0), pdy = T(0);
+	T ndx = T(0), ndy = T(0);
+	T last_h = T(0);
+};
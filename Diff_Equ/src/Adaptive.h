@@ -0,0 +1,85 @@
+#pragma once
+#include <cmath>
+
+//pieces shared by the adaptive integrators (DormandPrince, Rosenbrock2, Bdf)
+
+//step counters, per trajectory
+struct StepStats {
+	unsigned long long accepted = 0;
+	unsigned long long rejected = 0;
+	unsigned long long evaluations = 0;
+	unsigned long long jacobians = 0;       //implicit methods only
+	unsigned long long factorizations = 0;
+};
+
+//mixed error tolerance, a component passes when |error| <= absolute + relative * |value|
+struct Tolerance {
+	double relative = 1e-6;
+	double absolute = 1e-9;
+};
+
+//rms over both components of error scaled by the tolerance at the larger of two states, <= 1 passes
+template <typename T>
+inline double error_norm(const Tolerance& tolerance, T ex, T ey, T x0, T y0, T x1, T y1) {
+	double ax = std::fmax(std::fabs((double)x0), std::fabs((double)x1));
+	double ay = std::fmax(std::fabs((double)y0), std::fabs((double)y1));
+	double sx = (double)ex / (tolerance.absolute + tolerance.relative * ax);
+	double sy = (double)ey / (tolerance.absolute + tolerance.relative * ay);
+	return std::sqrt(0.5 * (sx * sx + sy * sy));
+}
+
+//Hairer's starting step for a method of the given order: an explicit Euler probe sized from |y| / |f|,
+//corrected by the second derivative. costs one evaluation, counted in stats
+template <typename T, typename F>
+inline T initial_step(F& f, const Tolerance& tolerance, int order, T t, T x, T y, T dx, T dy, StepStats& stats) {
+	double d0 = error_norm(tolerance, x, y, x, y, x, y);
+	double d1 = error_norm(tolerance, dx, dy, x, y, x, y);
+	double h0 = (d0 < 1e-5 || d1 < 1e-5) ? 1e-6 : 0.01 * d0 / d1;
+
+	T px, py;
+	stats.evaluations++;
+	f(t + T(h0), x + T(h0) * dx, y + T(h0) * dy, px, py);
+	double d2 = error_norm(tolerance, px - dx, py - dy, x, y, x, y) / h0;
+	double largest = std::fmax(d1, d2);
+	double h1 = largest <= 1e-15 ? std::fmax(1e-6, h0 * 1e-3) : std::pow(0.01 / largest, 1.0 / (order + 1));
+	return T(std::fmin(100.0 * h0, h1));
+}
+
+//LU of a 2x2 matrix with partial pivoting, for the implicit methods' Newton and stage systems
+template <typename T>
+struct Lu2 {
+	//row major a b / c d, false when singular
+	bool factor(T a, T b, T c, T d) {
+		using std::fabs;
+		swapped = fabs(c) > fabs(a);
+		if (swapped) {
+			T s;
+			s = a; a = c; c = s;
+			s = b; b = d; d = s;
+		}
+		if (a == T(0))
+			return false;
+		l = c / a;
+		u11 = a;
+		u12 = b;
+		u22 = d - l * b;
+		return u22 != T(0);
+	}
+
+	void solve(T bx, T by, T& out_x, T& out_y) const {
+		if (swapped) {
+			T s = bx;
+			bx = by;
+			by = s;
+		}
+		by = by - l * bx;
+		out_y = by / u22;
+		out_x = (bx - u12 * out_y) / u11;
+	}
+
+	bool swapped = false;
+	T l = T(0);
+	T u11 = T(1);
+	T u12 = T(0);
+	T u22 = T(1);
+};
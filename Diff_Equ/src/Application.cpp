@@ -1,17 +1,85 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include "exprtk.hpp"
+#include "EquationCache.h"
+#include "Benchmark.h"
+#include "CompileWorker.h"
+#include "Adams.h"
+#include "AutoSwitch.h"
+#include "Bdf.h"
+#include "BulirschStoer.h"
+#include "ButcherTableau.h"
+#include "DormandPrince.h"
+#include "DoubleDouble.h"
+#include "Energy.h"
+#include "Events.h"
+#include "FrameScheduler.h"
+#include "IncrementalPath.h"
+#include "Integrators.h"
+#include "Rosenbrock.h"
+#include "SystemEval.h"
+#include "TaskScheduler.h"
+#include "Taylor.h"
+#include "WorkerContexts.h"
 
 //must be multiples of 4
 #define NUM_LINES 200
-exprtk::expression<float> expression_x;
-exprtk::expression<float> expression_y;
+//vector field samples per side, spread over the visible [-1, 1] square
+#define FIELD_GRID 24
+#define FIELD_POINTS (FIELD_GRID * FIELD_GRID)
+//field samples per scheduler chunk, six grid rows
+#define FIELD_CHUNK (FIELD_GRID * 6)
+EquationCache equation_cache;
+EvalContext* equations = nullptr;
+//compile each system to native code with the system C compiler, off by default since it blocks a frame
+bool native_equations = false;
+//equations compile off the render thread, these track what it was last asked for
+CompileWorker compile_worker;
+std::string requested_x;
+std::string requested_y;
+bool requested_native = false;
+bool have_request = false;
+std::string compile_error;
+//every core, for the field and anything else that splits into independent pieces. each participant
+//evaluates through its own copy of the active system
+TaskScheduler scheduler;
+WorkerContexts worker_contexts;
+//parameter values by name, kept across equation edits so retyping dx does not reset the sliders
+std::map<std::string, float> parameter_values;
+//scalar type paths are integrated in: 0 float, 1 double, 2 double-double
+int path_precision = 1;
+//stepper for traced paths: 0 adaptive dormand-prince, 1 tsit5 and 2 verner 6(5) on the tableau engine,
+//3 adams-bashforth-moulton at one evaluation per step, 4 bulirsch-stoer extrapolation, 5 taylor series,
+//6 rosenbrock and 7 bdf for stiff systems, 8 switching between dormand-prince and bdf on detected stiffness,
+//then Method + 9 for the fixed step ones
+int path_method = 0;
+#define PATH_TAYLOR_METHOD 5
+#define PATH_ADAPTIVE_METHODS 9
+float path_tolerance = 1e-6f;
+//the path persists across frames and grows by a slice of each, starting over only when its inputs change
+std::unique_ptr<IncrementalPath> path;
+unsigned long long path_generation = 0;     //counts restarts, so the buffer knows its samples are stale
+float path_start[2] = { 0.0f, 0.0f };
+float path_length = 20.0f;      //time the path runs to
+//method switches the automatic stepper made on the current path, printed as they happen
+size_t path_switches_printed = 0;
+//event function watched along adaptive paths, crossings located on the solver's dense output
+EventSet path_events;
+std::string event_requested;
+int event_crossing = 0;         //0 both directions, 1 rising, 2 falling
+bool event_terminal = false;
+std::string event_error;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
@@ -78,19 +146,92 @@ static unsigned int CreateShaderVectors(const std::string& vertexShader, const s
 
 
 
+//restores remembered slider values into a newly active system
+void bind_parameters() {
+	for (const std::string& name : equations->parameter_names()) {
+		float* slot = equations->parameter(name);
+		auto found = parameter_values.find(name);
+		if (found == parameter_values.end())
+			parameter_values[name] = *slot;
+		else
+			*slot = found->second;
+	}
+}
+
 //Equation x & y are equations while x and y are variables in equations
-int set_diff_eq(std::string Equation_x, std::string Equation_y, float x, float y) {
+//a cached system swaps in at once, anything else is compiled on the worker while the last good one keeps drawing
+int set_diff_eq(const std::string& Equation_x, const std::string& Equation_y) {
+	//last frame's path and worker copies were rebuilt for this system, anything it replaced can go
+	equation_cache.set_active(equations);
+
+	bool changed = !have_request || Equation_x != requested_x || Equation_y != requested_y || native_equations != requested_native;
+	if (changed) {
+		requested_x = Equation_x;
+		requested_y = Equation_y;
+		requested_native = native_equations;
+		have_request = true;
+
+		EvalContext* cached = equation_cache.find(Equation_x, Equation_y);
+		if (cached && (!native_equations || !cached->has_program() || cached->native_attempted())) {
+			equations = cached;
+			bind_parameters();
+			compile_error.clear();
+		}
+		else {
+			compile_worker.submit(Equation_x, Equation_y, native_equations);
+		}
+	}
+
+	//results for text that has since changed are dropped, a newer request is already queued
+	CompileResult result;
+	if (compile_worker.poll(result) && result.equation_x == requested_x && result.equation_y == requested_y) {
+		if (result.context->ok()) {
+			equations = &equation_cache.adopt(result.equation_x, result.equation_y, std::vector<std::string>(),
+				std::move(result.context), result.compile_ms);
+			bind_parameters();
+			compile_error.clear();
+		}
+		else if (!requested_x.empty() || !requested_y.empty()) {
+			compile_error = result.context->error();
+		}
+	}
 
-	exprtk::symbol_table<float> symbol_table;
-	symbol_table.add_variable("x", x);
-	symbol_table.add_variable("y", y);
+	//a cached context keeps its native code when the box is unticked, it just stops being used
+	if (equations)
+		equations->enable_native(native_equations);
+	return equations && equations->ok();
+}
 
-	expression_x.register_symbol_table(symbol_table);
-	expression_y.register_symbol_table(symbol_table);
+//recompiles the event only when its text or flags change, an empty text turns events off
+void set_event(const std::string& text, int crossing, bool terminal) {
+	if (text == event_requested && crossing == event_crossing && terminal == event_terminal)
+		return;
+	event_requested = text;
+	event_crossing = crossing;
+	event_terminal = terminal;
+
+	std::vector<EventSpec> specs;
+	if (!text.empty()) {
+		EventSpec spec;
+		spec.expression = text;
+		spec.direction = crossing == 1 ? 1 : (crossing == 2 ? -1 : 0);
+		spec.terminal = terminal;
+		specs.push_back(spec);
+	}
+	path_events.compile(specs);
+	event_error = path_events.error();
+}
 
-	exprtk::parser<float> parser;
+//one slider per free symbol, dragging only rewrites the bound slot and never reaches the parser
+void parameter_sliders() {
+	if (!equations)
+		return;
 
-	return parser.compile(Equation_x, expression_x) && parser.compile(Equation_y, expression_y);
+	for (const std::string& name : equations->parameter_names()) {
+		float* slot = equations->parameter(name);
+		if (ImGui::SliderFloat(name.c_str(), slot, -10.0f, 10.0f))
+			parameter_values[name] = *slot;
+	}
 }
 
 bool set_equations_for_ui(char* hold_x, char* hold_y, bool render_elems) {
@@ -105,22 +246,295 @@ bool set_equations_for_ui(char* hold_x, char* hold_y, bool render_elems) {
 	return false;
 }
 
-//eulers method for finding vectors
-void graph_equations(float* vector_positions) {
-	float x = 0;
-	float y = 0;
-
-	for (int i = NUM_LINES; i < 200; i = i + 2) {
-		vector_positions[i] = x;
-		vector_positions[i + 1] = y;
-		//step size is 0.005
-		x += expression_x.value() * 0.005;
-		y += expression_y.value() * 0.005;
-	}	
+//path samples are PATH_DT apart in time, the same spacing the fixed step loop always used
+#define PATH_DT 0.005
+
+//everything a path depends on, any change starts it over
+struct PathKey {
+	const EvalContext* system = nullptr;
+	unsigned long long generation = 0;
+	unsigned long long events = 0;
+	std::vector<float> parameters;
+	int method = -1;
+	int precision = -1;
+	float tolerance = 0.0f;
+	float start_x = 0.0f;
+	float start_y = 0.0f;
+	float length = 0.0f;
+
+	bool operator==(const PathKey& other) const {
+		return system == other.system && generation == other.generation && events == other.events &&
+			parameters == other.parameters && method == other.method && precision == other.precision &&
+			tolerance == other.tolerance && start_x == other.start_x && start_y == other.start_y && length == other.length;
+	}
+};
+PathKey path_key;
+
+PathKey current_path_key() {
+	PathKey key;
+	key.system = equations;
+	key.generation = equations->generation();
+	key.events = path_events.generation();
+	for (const std::string& name : equations->parameter_names())
+		key.parameters.push_back(*equations->parameter(name));
+	key.method = path_method;
+	key.precision = path_precision;
+	key.tolerance = path_tolerance;
+	key.start_x = path_start[0];
+	key.start_y = path_start[1];
+	key.length = path_length;
+	return key;
+}
+
+template <typename T, typename F>
+using Tsit5 = EmbeddedRk<Tsit5Tableau, T, F>;
+template <typename T, typename F>
+using Verner65 = EmbeddedRk<Verner65Tableau, T, F>;
+
+template <typename T, template <typename, typename> class Solver>
+IncrementalPath* adaptive_path() {
+	Tolerance tolerance;
+	tolerance.relative = path_tolerance;
+	tolerance.absolute = path_tolerance;
+	return new AdaptivePath<T, Solver>(*equations, path_events, tolerance, T(path_start[0]), T(path_start[1]), PATH_DT, path_length);
+}
+
+template <typename T>
+IncrementalPath* make_path() {
+	switch (path_method) {
+	case 0: return adaptive_path<T, DormandPrince>();
+	case 1: return adaptive_path<T, Tsit5>();
+	case 2: return adaptive_path<T, Verner65>();
+	case 3: return adaptive_path<T, AdamsBashforthMoulton>();
+	case 4: return adaptive_path<T, BulirschStoer>();
+	case PATH_TAYLOR_METHOD: return adaptive_path<T, Taylor>();
+	case 6: return adaptive_path<T, Rosenbrock2>();
+	case 7: return adaptive_path<T, Bdf>();
+	case 8: return adaptive_path<T, AutoSwitch>();
+	default:
+		return new FixedPath<T>(*equations, (Method)(path_method - PATH_ADAPTIVE_METHODS), T(path_start[0]), T(path_start[1]),
+			PATH_DT, path_length);
+	}
+}
+
+//the automatic stepper's switches are printed once each as the path grows past them
+void print_switches() {
+	const std::vector<MethodSwitch>& switches = path->switches;
+	for (; path_switches_printed < switches.size(); path_switches_printed++) {
+		const MethodSwitch& entry = switches[path_switches_printed];
+		std::cout << "switched to " << (entry.to_implicit ? "bdf" : "dopri45") << " at t = " << entry.t
+			<< ": " << entry.reason_text() << " (h rho = " << entry.h_rho << ")" << std::endl;
+	}
+}
+
+//starts the path over when the equations, parameters, start point, method or event changed since the last
+//frame. growing it is PathTask's, in whatever time the frame has left
+void graph_equations() {
+	if (!equations || !equations->ok())
+		return;
+
+	path_events.bind_parameters(*equations);
+	PathKey key = current_path_key();
+	if (!path || !(key == path_key)) {
+		switch (path_precision) {
+		case 0: path.reset(make_path<float>()); break;
+		case 2: path.reset(make_path<DoubleDouble>()); break;
+		default: path.reset(make_path<double>()); break;
+		}
+		path_key = key;
+		path_generation++;
+		path_switches_printed = 0;
+	}
+}
+
+//uploads only the samples added since the last frame, the buffer doubles when the path outgrows it.
+//a restarted path is uploaded from its start, it may already have grown past the old one's length
+void draw_path(unsigned int path_buffer, size_t& capacity, size_t& uploaded, unsigned long long& generation) {
+	size_t count = path ? path->samples() : 0;
+	glBindBuffer(GL_ARRAY_BUFFER, path_buffer);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, 0);
+	if (generation != path_generation || count < uploaded)
+		uploaded = 0;
+	generation = path_generation;
+	if (count > capacity) {
+		while (capacity < count)
+			capacity = capacity < 1024 ? 1024 : capacity * 2;
+		glBufferData(GL_ARRAY_BUFFER, capacity * 2 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+		uploaded = 0;
+	}
+	if (count > uploaded)
+		glBufferSubData(GL_ARRAY_BUFFER, uploaded * 2 * sizeof(float), (count - uploaded) * 2 * sizeof(float), path->points.data() + uploaded * 2);
+	uploaded = count;
+	glDrawArrays(GL_LINES, 0, (GLsizei)(count & ~(size_t)1));
+}
+
+//one short line per grid point in the direction of (dx, dy). the grid is only sampled again when the system
+//or a parameter changed, in rounds of one chunk per participant so a resample can stop between rounds
+//and finish next frame
+class FieldTask : public FrameTask {
+public:
+	explicit FieldTask(float* field_positions) : field_positions(field_positions) {}
+
+	const char* name() const override { return "field"; }
+	//the field covers the whole view
+	int priority() const override { return 0; }
+
+	bool pending() const override {
+		if (!equations || !equations->ok())
+			return false;
+		return next < FIELD_POINTS || equations != system || equations->generation() != generation || parameters() != values;
+	}
+
+	bool run(double seconds) override {
+		auto start = std::chrono::steady_clock::now();
+		if (next >= FIELD_POINTS) {
+			system = equations;
+			generation = equations->generation();
+			values = parameters();
+			next = 0;
+		}
+
+		const float spacing = 2.0f / FIELD_GRID;
+		worker_contexts.bind(*equations, scheduler.participants());
+		const size_t round = FIELD_CHUNK * (size_t)scheduler.participants();
+		while (next < FIELD_POINTS) {
+			size_t first = next;
+			size_t count = FIELD_POINTS - first < round ? FIELD_POINTS - first : round;
+			for (size_t i = first; i < first + count; i++) {
+				xs[i] = -1.0f + spacing * (0.5f + i % FIELD_GRID);
+				ys[i] = -1.0f + spacing * (0.5f + i / FIELD_GRID);
+			}
+			scheduler.parallel_for(count, FIELD_CHUNK, [&](size_t begin, size_t end, int participant) {
+				worker_contexts[participant].eval_batch(0.0f, xs + first + begin, ys + first + begin, dxs + first + begin,
+					dys + first + begin, end - begin);
+			});
+
+			const float arrow = spacing * 0.4f;
+			for (size_t i = first; i < first + count; i++) {
+				float length = std::sqrt(dxs[i] * dxs[i] + dys[i] * dys[i]);
+				float scale = (length > 0.0f && std::isfinite(length)) ? arrow / length : 0.0f;
+				field_positions[i * 4] = xs[i];
+				field_positions[i * 4 + 1] = ys[i];
+				field_positions[i * 4 + 2] = xs[i] + dxs[i] * scale;
+				field_positions[i * 4 + 3] = ys[i] + dys[i] * scale;
+			}
+			next = first + count;
+			if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= seconds)
+				break;
+		}
+		return next < FIELD_POINTS;
+	}
+
+private:
+	static std::vector<float> parameters() {
+		std::vector<float> out;
+		for (const std::string& name : equations->parameter_names())
+			out.push_back(*equations->parameter(name));
+		return out;
+	}
+
+	float* field_positions;
+	float xs[FIELD_POINTS];
+	float ys[FIELD_POINTS];
+	float dxs[FIELD_POINTS];
+	float dys[FIELD_POINTS];
+	size_t next = FIELD_POINTS;     //first point of an unfinished resample
+	const EvalContext* system = nullptr;
+	unsigned long long generation = 0;
+	std::vector<float> values;
+};
+
+//grows the path, energy tracking and event location included. while its end is in view the growth is what
+//the user is watching and it goes with the field, once it has left the view it only gets what is left over
+class PathTask : public FrameTask {
+public:
+	const char* name() const override { return "path"; }
+
+	int priority() const override {
+		size_t count = path->points.size();
+		if (count < 2)
+			return 0;
+		float x = path->points[count - 2];
+		float y = path->points[count - 1];
+		return (std::fabs(x) <= 1.0f && std::fabs(y) <= 1.0f) ? 0 : 2;
+	}
+
+	bool pending() const override { return path && !path->complete(); }
+
+	bool run(double seconds) override {
+		PathBudget budget;
+		budget.seconds = seconds;
+		bool more = path->extend(budget);
+		print_switches();
+		return more;
+	}
+};
+
+//the last FrameScheduler::history frames as stacked bars, render then each task, against the budget line
+void frame_timeline(const FrameScheduler& frames, const std::vector<FrameTask*>& tasks) {
+	static const ImU32 colors[FrameRecord::max_tasks] = { IM_COL32(80, 200, 120, 255), IM_COL32(230, 180, 60, 255),
+		IM_COL32(200, 90, 200, 255), IM_COL32(90, 200, 230, 255) };
+	const float interval_ms = (float)(frames.interval() * 1e3);
+	const float scale_ms = interval_ms * 1.5f;
+
+	if (frames.recorded() > 0) {
+		const FrameRecord& last = frames.record(0);
+		ImGui::Text("Frame %.2f ms of %.2f: render %.2f, compute %.2f of %.2f budget, %llu over", last.frame, interval_ms,
+			last.render, last.compute, last.budget, frames.overruns);
+		//the last chunk of a task, or the OS taking the thread, can still carry compute past its budget
+		float past = 0.0f;
+		for (int age = 0; age < frames.recorded(); age++)
+			past = std::fmax(past, frames.record(age).compute - frames.record(age).budget);
+		ImGui::Text("Compute ran at most %.2f ms past its budget in the last %d frames", past, frames.recorded());
+	}
+
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImVec2 size(ImGui::GetContentRegionAvail().x, 120.0f);
+	ImDrawList* draw = ImGui::GetWindowDrawList();
+	draw->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(30, 30, 30, 255));
+	const float bar = size.x / FrameScheduler::history;
+	for (int age = 0; age < frames.recorded(); age++) {
+		const FrameRecord& record = frames.record(age);
+		float x1 = origin.x + size.x - bar * age;
+		float x0 = x1 - bar;
+		float bottom = origin.y + size.y;
+		//render first, then compute per task stacked on it
+		float top = bottom - size.y * std::fmin(record.render / scale_ms, 1.0f);
+		draw->AddRectFilled(ImVec2(x0, top), ImVec2(x1, bottom), IM_COL32(90, 120, 220, 255));
+		float ms = record.render;
+		for (int i = 0; i < FrameRecord::max_tasks; i++) {
+			if (record.tasks[i] <= 0.0f)
+				continue;
+			float low = bottom - size.y * std::fmin(ms / scale_ms, 1.0f);
+			ms += record.tasks[i];
+			float high = bottom - size.y * std::fmin(ms / scale_ms, 1.0f);
+			draw->AddRectFilled(ImVec2(x0, high), ImVec2(x1, low), colors[i]);
+		}
+		//what the frame took in all, vsync wait included
+		float frame_y = bottom - size.y * std::fmin(record.frame / scale_ms, 1.0f);
+		draw->AddLine(ImVec2(x0, frame_y), ImVec2(x1, frame_y), IM_COL32(160, 160, 160, 255));
+		//where compute had to stop
+		float budget_y = bottom - size.y * std::fmin((record.render + record.budget) / scale_ms, 1.0f);
+		draw->AddLine(ImVec2(x0, budget_y), ImVec2(x1, budget_y), IM_COL32(255, 255, 255, 255));
+	}
+	float interval_y = origin.y + size.y - size.y * interval_ms / scale_ms;
+	draw->AddLine(ImVec2(origin.x, interval_y), ImVec2(origin.x + size.x, interval_y), IM_COL32(230, 70, 70, 255));
+	ImGui::Dummy(size);
+
+	ImGui::TextColored(ImVec4(90 / 255.0f, 120 / 255.0f, 220 / 255.0f, 1.0f), "render");
+	for (size_t i = 0; i < tasks.size() && i < (size_t)FrameRecord::max_tasks; i++) {
+		ImGui::SameLine();
+		ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(colors[i]), "%s", tasks[i]->name());
+	}
+	ImGui::SameLine();
+	ImGui::TextUnformatted("white: budget, red: refresh interval");
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
+	if (argc > 1 && std::string(argv[1]) == "--bench")
+		return run_benchmarks(argc > 2 ? argv[2] : "");
+
 	GLFWwindow* window;
 
 	/* Initialize the library */
@@ -138,6 +552,10 @@ int main(void)
 	/* Make the window's context current */
 	glfwMakeContextCurrent(window);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	//one frame per refresh, the frame scheduler's deadline is this interval
+	glfwSwapInterval(1);
+	const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	double refresh_rate = (mode && mode->refreshRate > 0) ? mode->refreshRate : 60.0;
 
 	if (glewInit() != GLEW_OK) {
 		std::cout << "Error!" << std::endl;
@@ -147,7 +565,8 @@ int main(void)
 
 	//allocate how many lines? we are allowed to render
 	float* positions = (float*)alloca((NUM_LINES * 2) * sizeof(float));
-	float* vector_positions = (float*)alloca((NUM_LINES * 2) * sizeof(float));
+	float* field_positions = (float*)alloca((FIELD_POINTS * 4) * sizeof(float));
+	memset(field_positions, 0, (FIELD_POINTS * 4) * sizeof(float));
 
 	
 	//draw y lines 
@@ -311,6 +730,14 @@ int main(void)
 		"}\n";
 	std::string fragmentShaderVectors =
 		"void main() { color = vec4(1,1,0,1); }\n";
+	//the path gets a buffer of its own that grows with it
+	unsigned int path_buffer;
+	glGenBuffers(1, &path_buffer);
+	size_t path_capacity = 0;
+	size_t path_uploaded = 0;
+	unsigned long long path_drawn = 0;      //path_generation of the buffer's samples
+	glBindBuffer(GL_ARRAY_BUFFER, buffer_vectors);
+
 	unsigned int shaderVectors = CreateShaderVectors(vertexShaderVectors, fragmentShaderVectors);
 	glUniform2f(glGetUniformLocation(shaderVectors, "coord_one"), float(int(NUM_LINES / 2)), 1.0f);
 	glUniform2f(glGetUniformLocation(shaderVectors, "coord_two"), float(int(NUM_LINES / 2)), 1.0f);
@@ -323,12 +750,26 @@ int main(void)
 	ImGui::StyleColorsDark();
 	bool render_elems = false;
 
-	float x = -200;
-	float y = -200;
+	//equation text has to outlive the frame or InputText can never hold an edit
+	char Equation_x[256];
+	memset(Equation_x, 0, sizeof(Equation_x));
+	char Equation_y[256];
+	memset(Equation_y, 0, sizeof(Equation_y));
+	char Event_text[256];
+	memset(Event_text, 0, sizeof(Event_text));
+	int crossing = 0;
+	bool stop_at_event = false;
+
+	//compute runs after the frame is drawn and only until the frame's deadline, what is left waits for the next
+	FrameScheduler frames(refresh_rate);
+	FieldTask field_task(field_positions);
+	PathTask path_task;
+	std::vector<FrameTask*> frame_tasks = { &field_task, &path_task };
 
 	/* Loop until the user closes the window */
 	while (!glfwWindowShouldClose(window))
 	{
+		frames.begin_frame();
 
 		// Render the graph:
 		glClear(GL_COLOR_BUFFER_BIT);
@@ -336,8 +777,13 @@ int main(void)
 		glDrawArrays(GL_LINES, 0, NUM_LINES);
 		
 		//Render the vectors:
-		glBufferSubData(GL_ARRAY_BUFFER, 0, (NUM_LINES * 2) * sizeof(float), vector_positions);
-		glDrawArrays(GL_LINES, 0, NUM_LINES);
+		draw_path(path_buffer, path_capacity, path_uploaded, path_drawn);
+
+		//Render the field:
+		glBindBuffer(GL_ARRAY_BUFFER, buffer_vectors);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, 0);
+		glBufferData(GL_ARRAY_BUFFER, (FIELD_POINTS * 4) * sizeof(float), field_positions, GL_DYNAMIC_DRAW);
+		glDrawArrays(GL_LINES, 0, FIELD_POINTS * 2);
 
 		//render UI
 		ImGui_ImplOpenGL3_NewFrame();
@@ -348,36 +794,90 @@ int main(void)
 		ImGui::Begin("Vector field generator");
 
 		//Input field for first equation
-		char Equation_x[256];
-		memset(Equation_x, 0, sizeof(Equation_x));
-		
 		ImGui::InputText("dx", Equation_x, IM_ARRAYSIZE(Equation_x));
 		char* hold_x = Equation_x;
 
 		//Input field for second equation
-		char Equation_y[256];
-		memset(Equation_y, 0, sizeof(Equation_y));
-		
 		ImGui::InputText("dy", Equation_y, IM_ARRAYSIZE(Equation_y));
 		char* hold_y = Equation_y;
 
 		ImGui::SetWindowFontScale(2.0f);
 
-		set_diff_eq(Equation_x, Equation_y, x, y);
+		set_diff_eq(Equation_x, Equation_y);
+		parameter_sliders();
 
 		set_equations_for_ui(hold_x, hold_y, render_elems);
+
+		const EquationCacheStats& cache_stats = equation_cache.stats();
+		ImGui::Text("Compiles: %llu misses, %llu hits, %.2f ms total (last %.2f ms)",
+			cache_stats.misses, cache_stats.hits, cache_stats.compile_ms, cache_stats.last_compile_ms);
+
+		ImGui::Combo("Method", &path_method, "dopri45\0tsit5\0verner65\0abm4 (1 eval/step)\0bulirsch-stoer\0taylor series\0rosenbrock (stiff)\0bdf (stiff)\0auto (stiffness switching)\0euler\0heun\0rk4\0leapfrog (symplectic)\0yoshida4 (symplectic)\0");
+		if (path_method < PATH_ADAPTIVE_METHODS)
+			ImGui::SliderFloat("Tolerance", &path_tolerance, 1e-10f, 1e-2f, "%.0e", ImGuiSliderFlags_Logarithmic);
+		else if (is_symplectic((Method)(path_method - PATH_ADAPTIVE_METHODS)) && equations && equations->ok() && !equations->separable())
+			ImGui::TextUnformatted("Not separable: symplectic methods lose their energy bound");
+		if (path_method == PATH_TAYLOR_METHOD && equations && equations->ok() && !equations->has_taylor())
+			ImGui::TextUnformatted("Taylor series needs equations that lower to bytecode");
+		ImGui::Combo("Precision", &path_precision, "float\0double\0double-double\0");
+		ImGui::DragFloat2("Start", path_start, 0.01f, -10.0f, 10.0f);
+		ImGui::SliderFloat("Path time", &path_length, 1.0f, 1000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+		ImGui::InputText("event g(t,x,y)", Event_text, IM_ARRAYSIZE(Event_text));
+		ImGui::Combo("Crossing", &crossing, "both\0rising\0falling\0");
+		ImGui::Checkbox("Stop at event", &stop_at_event);
+		set_event(Event_text, crossing, stop_at_event);
+		if (!event_error.empty())
+			ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Event error: %s", event_error.c_str());
+		else if (!path_events.empty() && path_method >= PATH_ADAPTIVE_METHODS)
+			ImGui::TextUnformatted("Events need an adaptive method for dense output");
+		if (compile_worker.busy())
+			ImGui::TextUnformatted("Compiling...");
+		if (!compile_error.empty())
+			ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Error: %s", compile_error.c_str());
+		ImGui::Checkbox("Native code", &native_equations);
+		if (native_equations && equations && equations->native_attempted()) {
+			const NativeModule& native = equations->native_module();
+			if (native.loaded())
+				ImGui::Text("Native: %s, compile %.1f ms, load %.2f ms", native.from_cache ? "cached" : "built", native.compile_ms, native.load_ms);
+			else
+				ImGui::Text("Native unavailable: %s", native.error().empty() ? equations->lowering_error().c_str() : native.error().c_str());
+		}
 		
 		if (ImGui::Button("Graph", ImVec2(130.0f, 50.0f))) {
 			render_elems = true;
 			
 		}
-		graph_equations(vector_positions);
+		graph_equations();
+		if (path) {
+			const StepStats& stats = path->stats;
+			ImGui::Text("Path: t = %.4g of %.4g%s, %zu samples in %d frames (longest %.2f ms)", path->time(), path_length,
+				path->complete() ? "" : "...", path->samples(), path->slices, path->longest_slice * 1e3);
+			ImGui::Text("Steps: %llu, %llu rejected, %llu evaluations", stats.accepted, stats.rejected, stats.evaluations);
+			if (stats.jacobians)
+				ImGui::Text("Implicit: %llu jacobians, %llu factorizations", stats.jacobians, stats.factorizations);
+			if (path->energy_tracked)
+				ImGui::Text("Energy drift: %.3g (relative %.3g)", path->energy.max_drift, path->energy.relative());
+			if (!path->hits.empty())
+				ImGui::Text("Events: %zu, first at t = %.6g (%.4g, %.4g)%s", path->hits.size(), path->hits[0].t, path->hits[0].x,
+					path->hits[0].y, path_events.any_terminal() ? ", path stopped" : "");
+			if (!path->switches.empty())
+				ImGui::Text("Switches: %zu, last at t = %.4g to %s", path->switches.size(), path->switches.back().t,
+					path->switches.back().to_implicit ? "bdf" : "dopri45");
+		}
 	
+		ImGui::End();
+
+		ImGui::Begin("Frame timeline");
+		frame_timeline(frames, frame_tasks);
 		ImGui::End();
 		ImGui::Render();
 
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+		//compute gets what the frame has left, the GPU works through the frame meanwhile
+		frames.end_render();
+		frames.run(frame_tasks);
+
 		/* Swap front and back buffers */
 		glfwSwapBuffers(window);
 
@@ -0,0 +1,184 @@
+#pragma once
+#include <cmath>
+#include <vector>
+
+#include "Adaptive.h"
+#include "Bdf.h"
+#include "DormandPrince.h"
+
+//one method change made by AutoSwitch, kept so runs on real equations can be audited
+struct MethodSwitch {
+	enum Reason {
+		StabilityLimited,   //explicit steps were pinned at the stability boundary, h rho near 3.3
+		NonStiff,           //the implicit step fits well inside the explicit stability region
+		ExplicitFailed,     //dormand-prince underflowed or blew up, the implicit method gets a try
+	};
+
+	double t;
+	bool to_implicit;
+	Reason reason;
+	double h_rho;           //step size times spectral radius when the decision was made
+
+	const char* reason_text() const {
+		switch (reason) {
+		case StabilityLimited: return "explicit step held at the stability limit";
+		case NonStiff: return "implicit step within the explicit stability region";
+		default: return "explicit step failed";
+		}
+	}
+};
+
+//LSODA-style driver: starts on dormand-prince and moves to bdf and back mid-trajectory.
+//every check_interval accepted steps it takes one Jacobian and compares h rho(J) against
+//dormand-prince's stability boundary on the negative real axis (about 3.3). explicit steps that sit
+//near it for confirm_checks checks in a row mean the controller is limited by stability, not accuracy,
+//and the system is stiff; an implicit step that explicit could take at twice the size means it no longer is.
+//same interface as the other adaptive solvers, stats are summed over both methods
+template <typename T, typename F>
+class AutoSwitch {
+public:
+	static const int check_interval = 10;
+	static const int confirm_checks = 3;
+	static constexpr double stability_boundary = 3.3;
+
+	AutoSwitch(F& f, Tolerance tolerance) : f(f), explicit_solver(f, tolerance), implicit_solver(f, tolerance) {}
+
+	void start(T t0, T x0, T y0, T first_step = T(0)) {
+		switches.clear();
+		implicit = false;
+		last_implicit = false;
+		done = StepStats();
+		jacobians = 0;
+		explicit_solver.start(t0, x0, y0, first_step);
+		reset_checks();
+		sync();
+	}
+
+	bool step(T t_stop) {
+		if (!(t < t_stop))
+			return false;
+
+		bool stepped;
+		if (implicit) {
+			stepped = implicit_solver.step(t_stop);
+		} else {
+			stepped = explicit_solver.step(t_stop);
+			if (!stepped && t < t_stop) {
+				switch_method(true, MethodSwitch::ExplicitFailed, 0.0);
+				stepped = implicit_solver.step(t_stop);
+			}
+		}
+		if (!stepped)
+			return false;
+
+		last_implicit = implicit;
+		sync();
+		if (++since_check >= check_interval)
+			check_stiffness();
+		return true;
+	}
+
+	void dense(T time, T& out_x, T& out_y) const {
+		if (last_implicit)
+			implicit_solver.dense(time, out_x, out_y);
+		else
+			explicit_solver.dense(time, out_x, out_y);
+	}
+
+	bool is_implicit() const { return implicit; }
+
+	T t = T(0);
+	T x = T(0);
+	T y = T(0);
+	T previous_t = T(0);
+	T h = T(0);
+	StepStats stats;
+	std::vector<MethodSwitch> switches;
+
+private:
+	//largest eigenvalue magnitude of the 2x2 Jacobian, from its trace and determinant
+	static double spectral_radius(const T* J) {
+		double trace = (double)J[0] + (double)J[3];
+		double det = (double)J[0] * (double)J[3] - (double)J[1] * (double)J[2];
+		double disc = 0.25 * trace * trace - det;
+		if (disc < 0.0)
+			return std::sqrt(det);
+		double root = std::sqrt(disc);
+		return std::fmax(std::fabs(0.5 * trace + root), std::fabs(0.5 * trace - root));
+	}
+
+	void check_stiffness() {
+		since_check = 0;
+		T J[4];
+		f.jacobian(t, x, y, J);
+		jacobians++;
+		double h_rho = std::fabs((double)h) * spectral_radius(J);
+
+		//explicit: the controller keeps proposing steps at the boundary. implicit: twice its step would still be stable
+		bool vote = implicit ? h_rho < 0.5 * stability_boundary : h_rho > 0.8 * stability_boundary;
+		votes = vote ? votes + 1 : 0;
+		if (votes >= confirm_checks)
+			switch_method(!implicit, implicit ? MethodSwitch::NonStiff : MethodSwitch::StabilityLimited, h_rho);
+		sync();
+	}
+
+	void switch_method(bool to_implicit, MethodSwitch::Reason reason, double h_rho) {
+		MethodSwitch entry;
+		entry.t = (double)t;
+		entry.to_implicit = to_implicit;
+		entry.reason = reason;
+		entry.h_rho = h_rho;
+		switches.push_back(entry);
+
+		//the finished method's counters are banked, the new one restarts from the current state and step
+		if (implicit) {
+			add(done, implicit_solver.stats);
+			explicit_solver.start(t, x, y, h);
+		} else {
+			add(done, explicit_solver.stats);
+			implicit_solver.start(t, x, y, h);
+		}
+		implicit = to_implicit;
+		reset_checks();
+	}
+
+	void reset_checks() {
+		since_check = 0;
+		votes = 0;
+	}
+
+	static void add(StepStats& into, const StepStats& from) {
+		into.accepted += from.accepted;
+		into.rejected += from.rejected;
+		into.evaluations += from.evaluations;
+		into.jacobians += from.jacobians;
+		into.factorizations += from.factorizations;
+	}
+
+	//public state mirrors whichever method is running
+	void sync() {
+		if (implicit) {
+			t = implicit_solver.t; x = implicit_solver.x; y = implicit_solver.y;
+			previous_t = implicit_solver.previous_t; h = implicit_solver.h;
+		} else {
+			t = explicit_solver.t; x = explicit_solver.x; y = explicit_solver.y;
+			previous_t = explicit_solver.previous_t; h = explicit_solver.h;
+		}
+		//the step that was just taken keeps its start across a switch for dense output
+		if (last_implicit != implicit)
+			previous_t = last_implicit ? implicit_solver.previous_t : explicit_solver.previous_t;
+		stats = done;
+		add(stats, implicit ? implicit_solver.stats : explicit_solver.stats);
+		stats.jacobians += jacobians;
+	}
+
+	F& f;
+	DormandPrince<T, F> explicit_solver;
+	Bdf<T, F> implicit_solver;
+	bool implicit = false;
+	bool last_implicit = false;     //which method took the last accepted step, dense output belongs to it
+	int since_check = 0;
+	int votes = 0;
+	StepStats done;
+	unsigned long long jacobians = 0;
+};
@@ -0,0 +1,139 @@
+#include "BatchEval.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "Simd.h"
+
+void BatchEvaluator::bind(const Program& bound_program) {
+	program = &bound_program;
+	storage.assign((size_t)program->num_registers * block + 16, 0.0f);
+	uintptr_t address = (uintptr_t)storage.data();
+	registers = (float*)((address + 63) & ~(uintptr_t)63);
+
+	//the constant pool never gets overwritten, broadcast it once
+	for (size_t i = 0; i < program->constants.size(); i++)
+		set_uniform(program->num_inputs + (int)i, (float)program->constants[i]);
+}
+
+void BatchEvaluator::set_uniform(int slot, float value) {
+	float* lane = lanes(slot);
+	for (int i = 0; i < block; i++)
+		lane[i] = value;
+}
+
+void BatchEvaluator::eval(const float* xs, const float* ys, float* dxs, float* dys, size_t count) {
+	const unsigned short out_x = program->outputs[0];
+	const unsigned short out_y = program->outputs[1];
+
+	for (size_t start = 0; start < count; start += block) {
+		size_t n = count - start < (size_t)block ? count - start : (size_t)block;
+
+		std::memcpy(lanes(0), xs + start, n * sizeof(float));
+		std::memcpy(lanes(1), ys + start, n * sizeof(float));
+		run_block();
+		std::memcpy(dxs + start, lanes(out_x), n * sizeof(float));
+		std::memcpy(dys + start, lanes(out_y), n * sizeof(float));
+	}
+}
+
+//true when every lane is inside [low, high], NaN lanes count as outside
+static bool lanes_within(const float* a, int count, float low, float high) {
+	const simd_float lo = simd_set(low);
+	const simd_float hi = simd_set(high);
+	for (int i = 0; i < count; i += SIMD_WIDTH) {
+		simd_float v = simd_load(a + i);
+		if (simd_any(simd_not(simd_and(simd_le(lo, v), simd_le(v, hi)))))
+			return false;
+	}
+	return true;
+}
+
+template <typename T>
+static inline T round_half_away(T v) {
+	return v < T(0) ? std::ceil(v - T(0.5)) : std::floor(v + T(0.5));
+}
+
+//one SIMD expression over every lane of the block
+#define VECTOR(expr) for (int i = 0; i < block; i += SIMD_WIDTH) simd_store(d + i, expr)
+//ops without a vector form fall back to a plain loop per lane
+#define PER_LANE(expr) for (int i = 0; i < block; i++) d[i] = expr
+#define A simd_load(a + i)
+#define B simd_load(b + i)
+#define C simd_load(c + i)
+
+void BatchEvaluator::run_block() {
+	const simd_float zero = simd_set(0.0f);
+
+	for (const Instr& in : program->code) {
+		float* d = lanes(in.dst);
+		const float* a = lanes(in.a);
+		const float* b = lanes(in.b);
+		const float* c = lanes(in.c);
+
+		switch (in.op) {
+		case OpCode::Neg: VECTOR(simd_sub(zero, A)); break;
+		case OpCode::Add: VECTOR(simd_add(A, B)); break;
+		case OpCode::Sub: VECTOR(simd_sub(A, B)); break;
+		case OpCode::Mul: VECTOR(simd_mul(A, B)); break;
+		case OpCode::Div: VECTOR(simd_div(A, B)); break;
+		case OpCode::Mod: PER_LANE(std::fmod(a[i], b[i])); break;
+		case OpCode::Pow: PER_LANE(std::pow(a[i], b[i])); break;
+		case OpCode::Abs: VECTOR(simd_abs(A)); break;
+		case OpCode::Sqrt: VECTOR(simd_sqrt(A)); break;
+		case OpCode::Exp:
+			if (lanes_within(a, block, -87.0f, 88.0f)) VECTOR(simd_exp(A));
+			else PER_LANE(std::exp(a[i]));
+			break;
+		case OpCode::Log: PER_LANE(std::log(a[i])); break;
+		case OpCode::Log2: PER_LANE(std::log2(a[i])); break;
+		case OpCode::Log10: PER_LANE(std::log10(a[i])); break;
+		case OpCode::Sin:
+			if (lanes_within(a, block, -8192.0f, 8192.0f)) VECTOR(simd_sin(A));
+			else PER_LANE(std::sin(a[i]));
+			break;
+		case OpCode::Cos:
+			if (lanes_within(a, block, -8192.0f, 8192.0f)) VECTOR(simd_cos(A));
+			else PER_LANE(std::cos(a[i]));
+			break;
+		case OpCode::Tan: PER_LANE(std::tan(a[i])); break;
+		case OpCode::Asin: PER_LANE(std::asin(a[i])); break;
+		case OpCode::Acos: PER_LANE(std::acos(a[i])); break;
+		case OpCode::Atan: PER_LANE(std::atan(a[i])); break;
+		case OpCode::Sinh: PER_LANE(std::sinh(a[i])); break;
+		case OpCode::Cosh: PER_LANE(std::cosh(a[i])); break;
+		case OpCode::Tanh: PER_LANE(std::tanh(a[i])); break;
+		case OpCode::Floor: PER_LANE(std::floor(a[i])); break;
+		case OpCode::Ceil: PER_LANE(std::ceil(a[i])); break;
+		case OpCode::Round: PER_LANE(round_half_away(a[i])); break;
+		case OpCode::Trunc: PER_LANE(std::trunc(a[i])); break;
+		case OpCode::Sgn: VECTOR(simd_sub(simd_from_mask(simd_lt(zero, A)), simd_from_mask(simd_lt(A, zero)))); break;
+		case OpCode::Min: VECTOR(simd_min(A, B)); break;
+		case OpCode::Max: VECTOR(simd_max(A, B)); break;
+		case OpCode::Atan2: PER_LANE(std::atan2(a[i], b[i])); break;
+		case OpCode::Hypot: VECTOR(simd_sqrt(simd_add(simd_mul(A, A), simd_mul(B, B)))); break;
+		case OpCode::Lt: VECTOR(simd_from_mask(simd_lt(A, B))); break;
+		case OpCode::Le: VECTOR(simd_from_mask(simd_le(A, B))); break;
+		case OpCode::Gt: VECTOR(simd_from_mask(simd_lt(B, A))); break;
+		case OpCode::Ge: VECTOR(simd_from_mask(simd_le(B, A))); break;
+		case OpCode::Eq: VECTOR(simd_from_mask(simd_nearly_equal(A, B))); break;
+		case OpCode::Ne: VECTOR(simd_from_mask(simd_not(simd_nearly_equal(A, B)))); break;
+		case OpCode::And: VECTOR(simd_from_mask(simd_and(simd_nonzero(A), simd_nonzero(B)))); break;
+		case OpCode::Or: VECTOR(simd_from_mask(simd_or(simd_nonzero(A), simd_nonzero(B)))); break;
+		case OpCode::Not: VECTOR(simd_from_mask(simd_not(simd_nonzero(A)))); break;
+		//both branches are already computed for every lane, the condition only masks which one lands
+		case OpCode::Select: VECTOR(simd_select(simd_nonzero(A), B, C)); break;
+		case OpCode::MulAdd: VECTOR(simd_add(simd_mul(A, B), C)); break;
+		case OpCode::MulSub: VECTOR(simd_sub(simd_mul(A, B), C)); break;
+		case OpCode::NMulAdd: VECTOR(simd_sub(C, simd_mul(A, B))); break;
+		case OpCode::Sqr: VECTOR(simd_mul(A, A)); break;
+		}
+	}
+}
+
+#undef VECTOR
+#undef PER_LANE
+#undef A
+#undef B
+#undef C
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "Bytecode.h"
+
+//runs a two-output Program over many states at once. states are processed in blocks,
+//every instruction sweeps the whole block with SIMD lanes so dispatch is paid once per block.
+//x and y (input slots 0 and 1) vary per state, the other inputs are uniform across the batch
+class BatchEvaluator {
+public:
+	static const int block = 256;
+
+	void bind(const Program& program);
+	bool bound() const { return program != nullptr; }
+
+	//t and parameters, broadcast to every lane
+	void set_uniform(int slot, float value);
+
+	void eval(const float* xs, const float* ys, float* dxs, float* dys, size_t count);
+
+	//the lanes eval() writes, whole cache lines
+	void register_lanes(float*& first, size_t& count) const {
+		first = registers;
+		count = program ? (size_t)program->num_registers * block : 0;
+	}
+
+private:
+	void run_block();
+	float* lanes(int reg) { return registers + (size_t)reg * block; }
+
+	const Program* program = nullptr;
+	std::vector<float> storage;
+	float* registers = nullptr;     //storage aligned to 64 bytes, num_registers * block floats
+};
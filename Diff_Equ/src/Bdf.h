@@ -0,0 +1,288 @@
+#pragma once
+#include <cmath>
+
+#include "Adaptive.h"
+
+//variable order (1 to 5), variable step backward differentiation in the NDF form of Shampine and
+//Reichelt (ode15s, scipy's BDF). the history is kept as backward differences D scaled to the current
+//step, so changing h is a small matrix product instead of a restart. the corrector is a simplified
+//Newton iteration on (I - c J) that keeps both the Jacobian and its LU across steps:
+//an iteration that converges too slowly first refreshes J, and only a failure with a fresh J halves h.
+//F needs operator()(t, x, y, dx, dy) and jacobian(t, x, y, out[4]) (row major), e.g. SystemEval<T>
+template <typename T, typename F>
+class Bdf {
+public:
+	static const int max_order = 5;
+	static const int newton_iterations = 4;
+
+	Bdf(F& f, Tolerance tolerance) : f(f), tolerance(tolerance) {
+		//kappa = 0 at order 5 keeps the plain BDF there, NDF5 is not stable enough
+		const double kappa[max_order + 1] = { 0.0, -0.1850, -1.0 / 9.0, -0.0823, -0.0415, 0.0 };
+		gamma[0] = T(0);
+		for (int k = 1; k <= max_order; k++)
+			gamma[k] = gamma[k - 1] + T(1) / T(k);
+		for (int k = 0; k <= max_order; k++) {
+			alpha[k] = (T(1) - T(kappa[k])) * gamma[k];
+			error_constant[k] = T(kappa[k]) * gamma[k] + T(1) / T(k + 1);
+		}
+		newton_tolerance = std::fmax(10.0 * 2.2e-16 / tolerance.relative, std::fmin(0.03, std::sqrt(tolerance.relative)));
+	}
+
+	//first_step 0 picks one from the local derivative scale
+	void start(T t0, T x0, T y0, T first_step = T(0)) {
+		t = previous_t = t0;
+		x = x0;
+		y = y0;
+		stats = StepStats();
+		order = 1;
+		equal_steps = 0;
+		dense_order = 0;
+
+		T fx, fy;
+		eval(t, x, y, fx, fy);
+		h = first_step > T(0) ? first_step : initial_step(f, tolerance, 1, t, x, y, fx, fy, stats);
+		for (int i = 0; i < max_order + 3; i++)
+			D[i][0] = D[i][1] = T(0);
+		D[0][0] = x;
+		D[0][1] = y;
+		D[1][0] = h * fx;
+		D[1][1] = h * fy;
+		refresh_jacobian(t, x, y);
+	}
+
+	//one accepted step that never passes t_stop. false once t_stop is reached,
+	//or when the step size underflows or the solution stops being finite
+	bool step(T t_stop) {
+		if (!(t < t_stop))
+			return false;
+
+		bool current = false;       //J was evaluated during this step
+		while (true) {
+			if (!(h > T(0)) || (double)h <= std::fabs((double)t) * 1e-15)
+				return false;
+
+			T t_new = t + h;
+			if (t_new >= t_stop) {
+				t_new = t_stop;
+				rescale((t_new - t) / h);
+				h = t_new - t;
+				equal_steps = 0;
+				factored = false;
+			}
+
+			//predictor and the history part of the corrector equation
+			T px = T(0), py = T(0), psi_x = T(0), psi_y = T(0);
+			for (int i = 0; i <= order; i++) {
+				px += D[i][0];
+				py += D[i][1];
+			}
+			for (int j = 1; j <= order; j++) {
+				psi_x += gamma[j] * D[j][0];
+				psi_y += gamma[j] * D[j][1];
+			}
+			psi_x /= alpha[order];
+			psi_y /= alpha[order];
+			T c = h / alpha[order];
+
+			T nx = px, ny = py, dx = T(0), dy = T(0);
+			int iterations = 0;
+			bool converged = false;
+			while (true) {
+				if (!factored) {
+					stats.factorizations++;
+					factored = lu.factor(T(1) - c * J[0], -c * J[1], -c * J[2], T(1) - c * J[3]);
+				}
+				converged = factored && newton(t_new, c, px, py, psi_x, psi_y, nx, ny, dx, dy, iterations);
+				if (converged || current)
+					break;
+				refresh_jacobian(t_new, px, py);
+				current = true;
+			}
+
+			if (!converged) {
+				rescale(T(0.5));
+				h = h * T(0.5);
+				equal_steps = 0;
+				factored = false;
+				stats.rejected++;
+				continue;
+			}
+
+			double safety = 0.9 * (2 * newton_iterations + 1) / (2 * newton_iterations + iterations);
+			double error = error_norm(tolerance, error_constant[order] * dx, error_constant[order] * dy, nx, ny, nx, ny);
+			if (error > 1.0) {
+				//the iteration converged fine, so the LU stays even though c moves
+				double factor = std::fmax(0.2, safety * std::pow(error, -1.0 / (order + 1)));
+				rescale(T(factor));
+				h = h * T(factor);
+				equal_steps = 0;
+				stats.rejected++;
+				continue;
+			}
+
+			stats.accepted++;
+			equal_steps++;
+			previous_t = t;
+			t = t_new;
+			x = nx;
+			y = ny;
+
+			//fold the correction into the differences
+			D[order + 2][0] = dx - D[order + 1][0];
+			D[order + 2][1] = dy - D[order + 1][1];
+			D[order + 1][0] = dx;
+			D[order + 1][1] = dy;
+			for (int i = order; i >= 0; i--) {
+				D[i][0] += D[i + 1][0];
+				D[i][1] += D[i + 1][1];
+			}
+
+			//after order + 1 equal steps, try the neighbouring orders and take whichever allows the largest step
+			if (equal_steps >= order + 1) {
+				double lower = order > 1 ? error_norm(tolerance, error_constant[order - 1] * D[order][0],
+					error_constant[order - 1] * D[order][1], x, y, x, y) : INFINITY;
+				double higher = order < max_order ? error_norm(tolerance, error_constant[order + 1] * D[order + 2][0],
+					error_constant[order + 1] * D[order + 2][1], x, y, x, y) : INFINITY;
+				double factors[3] = {
+					std::pow(lower, -1.0 / order),
+					std::pow(error, -1.0 / (order + 1)),
+					std::pow(higher, -1.0 / (order + 2)),
+				};
+				int best = 0;
+				for (int i = 1; i < 3; i++)
+					if (factors[i] > factors[best])
+						best = i;
+				order += best - 1;
+				double factor = std::fmin(10.0, safety * factors[best]);
+				rescale(T(factor));
+				h = h * T(factor);
+				equal_steps = 0;
+				factored = false;
+			}
+
+			dense_order = order;
+			dense_h = h;
+			for (int i = 0; i <= order; i++) {
+				dense_D[i][0] = D[i][0];
+				dense_D[i][1] = D[i][1];
+			}
+			return true;
+		}
+	}
+
+	//state anywhere inside the last accepted step [previous_t, t], from the interpolating polynomial
+	void dense(T time, T& out_x, T& out_y) const {
+		out_x = dense_D[0][0];
+		out_y = dense_D[0][1];
+		if (dense_order == 0) {
+			out_x = x;
+			out_y = y;
+			return;
+		}
+		T p = T(1);
+		for (int i = 0; i < dense_order; i++) {
+			p = p * ((time - (t - dense_h * T(i))) / (dense_h * T(i + 1)));
+			out_x += p * dense_D[i + 1][0];
+			out_y += p * dense_D[i + 1][1];
+		}
+	}
+
+	T t = T(0);
+	T x = T(0);
+	T y = T(0);
+	T previous_t = T(0);
+	T h = T(0);                 //next step size to try
+	int order = 1;
+	StepStats stats;
+
+private:
+	void eval(T time, T ex, T ey, T& dx, T& dy) {
+		stats.evaluations++;
+		f(time, ex, ey, dx, dy);
+	}
+
+	void refresh_jacobian(T time, T jx, T jy) {
+		stats.jacobians++;
+		f.jacobian(time, jx, jy, J);
+		factored = false;
+	}
+
+	//simplified Newton on the corrector, d accumulates the correction from the predictor.
+	//gives up early when the observed contraction rate says the tolerance won't be met in time
+	bool newton(T t_new, T c, T px, T py, T psi_x, T psi_y, T& nx, T& ny, T& dx, T& dy, int& iterations) {
+		nx = px;
+		ny = py;
+		dx = dy = T(0);
+		double previous = -1.0;
+		for (int k = 0; k < newton_iterations; k++) {
+			iterations = k + 1;
+			T fx, fy, sx, sy;
+			eval(t_new, nx, ny, fx, fy);
+			if (!std::isfinite((double)fx) || !std::isfinite((double)fy))
+				return false;
+			lu.solve(c * fx - psi_x - dx, c * fy - psi_y - dy, sx, sy);
+			double norm = error_norm(tolerance, sx, sy, px, py, px, py);
+			double rate = previous > 0.0 ? norm / previous : -1.0;
+			if (rate >= 0.0 && (rate >= 1.0 || std::pow(rate, newton_iterations - k) / (1.0 - rate) * norm > newton_tolerance))
+				return false;
+			nx += sx;
+			ny += sy;
+			dx += sx;
+			dy += sy;
+			if (norm == 0.0 || (rate >= 0.0 && rate / (1.0 - rate) * norm < newton_tolerance))
+				return true;
+			previous = norm;
+		}
+		return false;
+	}
+
+	//re-expresses the differences for a step scaled by factor, D <- (R U)^T D
+	void rescale(T factor) {
+		T R[max_order + 1][max_order + 1], U[max_order + 1][max_order + 1];
+		difference_transform(factor, R);
+		difference_transform(T(1), U);
+		T next[max_order + 1][2];
+		for (int i = 0; i <= order; i++) {
+			next[i][0] = next[i][1] = T(0);
+			for (int k = 0; k <= order; k++) {
+				T ru = T(0);
+				for (int j = 0; j <= order; j++)
+					ru += R[k][j] * U[j][i];
+				next[i][0] += ru * D[k][0];
+				next[i][1] += ru * D[k][1];
+			}
+		}
+		for (int i = 0; i <= order; i++) {
+			D[i][0] = next[i][0];
+			D[i][1] = next[i][1];
+		}
+	}
+
+	//column-wise cumulative product of M, M[0][j] = 1, M[i][j] = (i - 1 - factor j) / i
+	void difference_transform(T factor, T (&R)[max_order + 1][max_order + 1]) const {
+		for (int j = 0; j <= order; j++)
+			R[0][j] = T(1);
+		for (int i = 1; i <= order; i++) {
+			R[i][0] = T(0);
+			for (int j = 1; j <= order; j++)
+				R[i][j] = R[i - 1][j] * (T(i - 1) - factor * T(j)) / T(i);
+		}
+	}
+
+	F& f;
+	Tolerance tolerance;
+	T gamma[max_order + 1];
+	T alpha[max_order + 1];
+	T error_constant[max_order + 1];
+	double newton_tolerance;
+
+	T D[max_order + 3][2];
+	int equal_steps = 0;
+	T J[4];
+	Lu2<T> lu;
+	bool factored = false;
+
+	int dense_order = 0;
+	T dense_h = T(0);
+	T dense_D[max_order + 1][2];
+};
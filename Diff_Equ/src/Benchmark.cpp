@@ -0,0 +1,1529 @@
+#include "Benchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Adams.h"
+#include "AutoSwitch.h"
+#include "Differentiate.h"
+#include "BatchEval.h"
+#include "Bdf.h"
+#include "BulirschStoer.h"
+#include "ButcherTableau.h"
+#include "DormandPrince.h"
+#include "DoubleDouble.h"
+#include "Energy.h"
+#include "Ensemble.h"
+#include "EvalContext.h"
+#include "Events.h"
+#include "ExprBuilder.h"
+#include "FrameScheduler.h"
+#include "IncrementalPath.h"
+#include "Integrators.h"
+#include "NativeModule.h"
+#include "Rosenbrock.h"
+#include "Simd.h"
+#include "SystemEval.h"
+#include "TaskScheduler.h"
+#include "Taylor.h"
+#include "WorkerContexts.h"
+
+struct TestSystem {
+	const char* name;
+	const char* dx;
+	const char* dy;
+};
+
+//the standard systems every benchmark runs against
+static const TestSystem test_systems[] = {
+	{ "linear", "-0.1*x - y", "x - 0.1*y" },
+	{ "van der pol", "y", "1.5*(1 - x^2)*y - x" },
+	{ "lotka-volterra", "1.1*x - 0.4*x*y", "0.1*x*y - 0.4*y" },
+	{ "pendulum", "y", "-sin(x)" },
+};
+
+//fields whose two components share heavy terms, for the cse benchmark
+static const TestSystem shared_systems[] = {
+	{ "limit cycle", "x*(1 - sqrt(x*x + y*y)) - y", "y*(1 - sqrt(x*x + y*y)) + x" },
+	{ "swirl", "-y*sin(x*x + y*y) + x*cos(x*x + y*y)", "x*sin(x*x + y*y) + y*cos(x*x + y*y)" },
+	{ "polar", "cos(atan2(y, x))*(1 - hypot(x, y)) - sin(atan2(y, x))", "sin(atan2(y, x))*(1 - hypot(x, y)) + cos(atan2(y, x))" },
+	{ "van der pol", "y", "1.5*(1 - x^2)*y - x" },
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//tree-walking exprtk value() against the register bytecode, same states for both. one state at a time the
+//interpreter only draws level with exprtk at best (see Program::run), the batch column is the same program
+//over the lanes, which is where lowering pays
+static void bench_bytecode() {
+	const int grid = 1000;
+	const int states = grid * grid;
+	const int passes = 4;
+	std::vector<float> xs(states);
+	std::vector<float> ys(states);
+	for (int i = 0; i < states; i++) {
+		xs[i] = (i % grid) * 0.004f - 2.0f;
+		ys[i] = (i / grid) * 0.004f - 2.0f;
+	}
+	std::vector<float> dxs(states), dys(states);
+	std::printf("%-16s %12s %12s %8s %12s %8s %6s %6s\n", "system", "tree Mev/s", "vm Mev/s", "speedup", "batch Mev/s", "speedup",
+		"instr", "fused");
+
+	for (const TestSystem& system : test_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%-16s failed to compile: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+
+		float checksum = 0.0f;
+		float out_x, out_y;
+		auto start = std::chrono::steady_clock::now();
+		for (int p = 0; p < passes; p++) {
+			for (int i = 0; i < states; i++) {
+				context.eval(0.0f, xs[i], ys[i], out_x, out_y);
+				checksum += out_x + out_y;
+			}
+		}
+		double tree_seconds = seconds_since(start);
+
+		start = std::chrono::steady_clock::now();
+		for (int p = 0; p < passes; p++) {
+			for (int i = 0; i < states; i++) {
+				context.eval_bytecode(0.0f, xs[i], ys[i], out_x, out_y);
+				checksum -= out_x + out_y;
+			}
+		}
+		double vm_seconds = seconds_since(start);
+
+		start = std::chrono::steady_clock::now();
+		for (int p = 0; p < passes; p++)
+			context.eval_batch(0.0f, xs.data(), ys.data(), dxs.data(), dys.data(), states);
+		double batch_seconds = seconds_since(start);
+
+		//two equations per state
+		double evals = 2.0 * passes * states;
+		const Program& program = context.bytecode();
+		std::printf("%-16s %12.1f %12.1f %7.2fx %12.1f %7.2fx %6d %6d   (checksum %g)\n", system.name,
+			evals / tree_seconds * 1e-6, evals / vm_seconds * 1e-6, tree_seconds / vm_seconds, evals / batch_seconds * 1e-6,
+			tree_seconds / batch_seconds, (int)program.code.size(), program.fused, checksum);
+	}
+}
+
+//vector field sampling over a 1000x1000 grid: one exprtk call per point against the SIMD batch path
+//states per second of scalar eval() and of eval_batch() over count states, passes times each
+static void batch_rates(EvalContext& context, int count, int passes, double& scalar_rate, double& batch_rate, float& max_diff) {
+	std::vector<float> xs(count), ys(count);
+	std::vector<float> dxs(count), dys(count);
+	std::vector<float> ref_x(count), ref_y(count);
+	for (int i = 0; i < count; i++) {
+		xs[i] = (i % 1000) * 0.004f - 2.0f;
+		ys[i] = (i / 1000) * 0.004f - 2.0f;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (int p = 0; p < passes; p++) {
+		for (int i = 0; i < count; i++)
+			context.eval(0.0f, xs[i], ys[i], ref_x[i], ref_y[i]);
+	}
+	scalar_rate = (double)passes * count / seconds_since(start);
+
+	start = std::chrono::steady_clock::now();
+	for (int p = 0; p < passes; p++)
+		context.eval_batch(0.0f, xs.data(), ys.data(), dxs.data(), dys.data(), count);
+	batch_rate = (double)passes * count / seconds_since(start);
+
+	for (int i = 0; i < count; i++) {
+		max_diff = std::fmax(max_diff, std::fabs(dxs[i] - ref_x[i]));
+		max_diff = std::fmax(max_diff, std::fabs(dys[i] - ref_y[i]));
+	}
+}
+
+//the target is 5x over scalar on the 1M grid. a million states streams 16 MB through memory every pass, so
+//simple systems are held to memory bandwidth there however fast the lanes are, and making the coordinates
+//tile by tile in cache instead of loading them gains nothing measurable. the 4096 state run stays in cache
+//like the field and the ensemble tiles do and only shows what the lanes manage without that limit
+static void bench_batch() {
+	const double target = 5.0;
+	std::printf("simd: %s, %d lanes\n", SIMD_NAME, SIMD_WIDTH);
+	std::printf("%-16s %12s %12s %10s %7s %12s %12s %10s %12s\n", "system", "scalar Ms/s", "batch Ms/s", "1M grid", "target",
+		"scalar Ms/s", "batch Ms/s", "in cache", "max diff");
+
+	for (const TestSystem& system : test_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%-16s failed to compile: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+
+		double scalar_big, batch_big, scalar_small, batch_small;
+		float max_diff = 0.0f;
+		batch_rates(context, 1000 * 1000, 3, scalar_big, batch_big, max_diff);
+		batch_rates(context, 4096, 732, scalar_small, batch_small, max_diff);
+		double speedup = batch_big / scalar_big;
+		std::printf("%-16s %12.1f %12.1f %9.2fx %7s %12.1f %12.1f %9.2fx %12g\n", system.name, scalar_big * 1e-6, batch_big * 1e-6,
+			speedup, speedup >= target ? "met" : "short", scalar_small * 1e-6, batch_small * 1e-6, batch_small / scalar_small, max_diff);
+	}
+}
+
+//cold compile of the generated C against how many states it takes to pay that back
+static void bench_native() {
+	const int grid = 1000;
+	const int states = grid * grid;
+	const int passes = 3;
+	std::vector<float> xs(states), ys(states);
+	std::vector<float> dxs(states), dys(states);
+	std::vector<float> ref_x(states), ref_y(states);
+	for (int i = 0; i < states; i++) {
+		xs[i] = (i % grid) * 0.004f - 2.0f;
+		ys[i] = (i / grid) * 0.004f - 2.0f;
+	}
+
+	std::printf("%-16s %10s %8s %12s %12s %12s %12s %10s\n", "system", "compile ms", "load ms",
+		"tree Ms/s", "batch Ms/s", "native Ms/s", "break-even", "max diff");
+
+	for (const TestSystem& system : test_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%-16s failed to compile: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+
+		NativeModule native;
+		if (!native.load(context.bytecode(), false)) {
+			std::printf("%-16s %s\n", system.name, native.error().c_str());
+			continue;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < states; i++)
+			context.eval(0.0f, xs[i], ys[i], ref_x[i], ref_y[i]);
+		double tree_seconds = seconds_since(start);
+
+		start = std::chrono::steady_clock::now();
+		for (int p = 0; p < passes; p++)
+			context.eval_batch(0.0f, xs.data(), ys.data(), dxs.data(), dys.data(), states);
+		double batch_seconds = seconds_since(start) / passes;
+
+		const float uniforms[1] = { 0.0f };
+		start = std::chrono::steady_clock::now();
+		for (int p = 0; p < passes; p++)
+			native.eval_batch(xs.data(), ys.data(), uniforms, dxs.data(), dys.data(), states);
+		double native_seconds = seconds_since(start) / passes;
+
+		float max_diff = 0.0f;
+		for (int i = 0; i < states; i++) {
+			max_diff = std::fmax(max_diff, std::fabs(dxs[i] - ref_x[i]));
+			max_diff = std::fmax(max_diff, std::fabs(dys[i] - ref_y[i]));
+		}
+
+		//states evaluated before the compile time is won back over the SIMD batch interpreter
+		double saved_per_state = (batch_seconds - native_seconds) / states;
+		char break_even[32] = "never";
+		if (saved_per_state > 0.0)
+			std::snprintf(break_even, sizeof(break_even), "%.3g", (native.compile_ms + native.load_ms) * 1e-3 / saved_per_state);
+
+		std::printf("%-16s %10.1f %8.2f %12.1f %12.1f %12.1f %12s %10g\n", system.name, native.compile_ms, native.load_ms,
+			states / tree_seconds * 1e-6, states / batch_seconds * 1e-6, states / native_seconds * 1e-6, break_even, max_diff);
+	}
+}
+
+//symbolic Jacobian against four-evaluation central differences, both in double
+static void bench_jacobian() {
+	const int grid = 300;
+	const int states = grid * grid;
+
+	std::printf("%-16s %6s %6s %6s %12s %12s %8s %10s\n", "system", "nodes", "shared", "instr",
+		"exact Mj/s", "central Mj/s", "speedup", "max diff");
+
+	for (const TestSystem& system : test_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_jacobian()) {
+			std::printf("%-16s no jacobian: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+
+		//rebuild the derivative tree just to count what hash-consing and simplification saved
+		std::vector<std::string> symbols = { "x", "y", "t" };
+		ExprTree tree;
+		std::string error;
+		int root_x = parse_expression(system.dx, symbols, tree, error);
+		int root_y = parse_expression(system.dy, symbols, tree, error);
+		size_t before = tree.nodes.size();
+		ExprBuilder builder(tree);
+		build_jacobian(builder, root_x, root_y);
+		int added = (int)(tree.nodes.size() - before);
+
+		SystemEval<double> f(context);
+		double jacobian[4];
+		double checksum = 0.0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < states; i++) {
+			f.jacobian(0.0, (i % grid) * 0.013 - 2.0, (i / grid) * 0.013 - 2.0, jacobian);
+			checksum += jacobian[0] + jacobian[3];
+		}
+		double exact_seconds = seconds_since(start);
+
+		double central[4];
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < states; i++) {
+			f.central_jacobian(0.0, (i % grid) * 0.013 - 2.0, (i / grid) * 0.013 - 2.0, central);
+			checksum += central[0] + central[3];
+		}
+		double central_seconds = seconds_since(start);
+
+		double max_diff = 0.0;
+		for (int i = 0; i < states; i += 97) {
+			double x = (i % grid) * 0.013 - 2.0;
+			double y = (i / grid) * 0.013 - 2.0;
+			f.jacobian(0.0, x, y, jacobian);
+			f.central_jacobian(0.0, x, y, central);
+			for (int k = 0; k < 4; k++)
+				max_diff = std::fmax(max_diff, std::fabs(jacobian[k] - central[k]));
+		}
+
+		std::printf("%-16s %6d %6d %6d %12.1f %12.1f %7.2fx %10.3g   (checksum %g)\n", system.name, added,
+			builder.reused + builder.simplified, (int)context.jacobian_bytecode().code.size(),
+			states / exact_seconds * 1e-6, states / central_seconds * 1e-6, central_seconds / exact_seconds, max_diff, checksum);
+	}
+}
+
+//the same equations lowered as parsed and after hash-consing both into one pool
+static void bench_cse() {
+	const int grid = 1000;
+	const int states = grid * grid;
+	std::vector<float> xs(states), ys(states);
+	std::vector<float> dxs(states), dys(states);
+	for (int i = 0; i < states; i++) {
+		xs[i] = (i % grid) * 0.004f - 2.0f;
+		ys[i] = (i / grid) * 0.004f - 2.0f;
+	}
+
+	std::printf("%-16s %6s %6s %9s %9s %10s %10s %8s %10s %10s %8s %6s\n", "system", "nodes", "elim", "instr", "cse instr",
+		"vm Ms/s", "cse Ms/s", "speedup", "batch Ms/s", "cse Ms/s", "speedup", "kept");
+
+	for (const TestSystem& system : shared_systems) {
+		std::vector<std::string> symbols = { "x", "y", "t" };
+		ExprTree parsed;
+		std::string error;
+		int root_x = parse_expression(system.dx, symbols, parsed, error);
+		int root_y = root_x < 0 ? -1 : parse_expression(system.dy, symbols, parsed, error);
+		if (root_y < 0) {
+			std::printf("%-16s failed to parse: %s\n", system.name, error.c_str());
+			continue;
+		}
+
+		ExprTree pooled;
+		ExprBuilder pool(pooled, false);
+		std::vector<int> pooled_roots = pool.import(parsed, { root_x, root_y });
+
+		Program programs[2];
+		programs[0].lower(parsed, { root_x, root_y }, 3);
+		programs[1].lower(pooled, pooled_roots, 3);
+
+		//best of interleaved rounds, a single pass of either is within the noise of the other
+		double vm_seconds[2] = { 1e30, 1e30 };
+		double batch_seconds[2] = { 1e30, 1e30 };
+		for (int round = 0; round < 5; round++) {
+			for (int p = 0; p < 2; p++) {
+				std::vector<float> registers(programs[p].num_registers);
+				programs[p].init_registers(registers.data());
+				float inputs[3] = { 0.0f, 0.0f, 0.0f };
+				float out[2];
+				auto start = std::chrono::steady_clock::now();
+				for (int i = 0; i < states; i++) {
+					inputs[0] = xs[i];
+					inputs[1] = ys[i];
+					programs[p].eval(inputs, out, registers.data());
+					dxs[i] = out[0];
+				}
+				vm_seconds[p] = std::min(vm_seconds[p], seconds_since(start));
+
+				BatchEvaluator batch;
+				batch.bind(programs[p]);
+				batch.set_uniform(2, 0.0f);
+				start = std::chrono::steady_clock::now();
+				batch.eval(xs.data(), ys.data(), dxs.data(), dys.data(), states);
+				batch_seconds[p] = std::min(batch_seconds[p], seconds_since(start));
+			}
+		}
+
+		//what EvalContext keeps, the pooled program only when it is shorter
+		EvalContext context;
+		context.compile(system.dx, system.dy);
+		const char* kept = context.eliminated_nodes() > 0 ? "cse" : "plain";
+
+		std::printf("%-16s %6d %6d %9d %9d %10.1f %10.1f %7.2fx %10.1f %10.1f %7.2fx %6s\n", system.name,
+			pool.imported, pool.imported - (int)pooled.nodes.size(), (int)programs[0].code.size(), (int)programs[1].code.size(),
+			states / vm_seconds[0] * 1e-6, states / vm_seconds[1] * 1e-6, vm_seconds[0] / vm_seconds[1],
+			states / batch_seconds[0] * 1e-6, states / batch_seconds[1] * 1e-6, batch_seconds[0] / batch_seconds[1], kept);
+	}
+}
+
+//systems with closed-form solutions for accuracy benchmarks, integrated over [0, end] from (x0, y0)
+struct ExactSystem {
+	const char* name;
+	const char* dx;
+	const char* dy;
+	double x0, y0, end;
+	void (*solution)(double t, double& x, double& y);
+};
+
+static void linear_solution(double t, double& x, double& y) {
+	x = std::exp(-0.1 * t) * std::cos(t);
+	y = std::exp(-0.1 * t) * std::sin(t);
+}
+
+static void oscillator_solution(double t, double& x, double& y) {
+	x = std::cos(t);
+	y = -std::sin(t);
+}
+
+static void logistic_solution(double t, double& x, double& y) {
+	x = 1.0 / (1.0 + 9.0 * std::exp(-t));
+	y = 2.0 * std::exp(-0.5 * t);
+}
+
+static void sharp_logistic_solution(double t, double& x, double& y) {
+	x = 1.0 / (1.0 + 9.0 * std::exp(-20.0 * t));
+	y = 2.0 * std::exp(-0.5 * t);
+}
+
+static const ExactSystem exact_systems[] = {
+	{ "linear", "-0.1*x - y", "x - 0.1*y", 1.0, 0.0, 10.0, linear_solution },
+	{ "oscillator", "y", "-x", 1.0, 0.0, 20.0, oscillator_solution },
+	{ "logistic", "x*(1 - x)", "-0.5*y", 0.1, 2.0, 8.0, logistic_solution },
+	{ "sharp logistic", "20*x*(1 - x)", "-0.5*y", 0.1, 2.0, 2.0, sharp_logistic_solution },
+};
+
+//final-state error at equal evaluation budgets, and the evaluations each method needs for 1e-6
+static void bench_accuracy() {
+	const long long budgets[] = { 240, 2400, 24000, 240000 };
+	const Method methods[] = { Method::Euler, Method::Heun, Method::Rk4 };
+	const char* method_names[] = { "euler", "heun", "rk4" };
+
+	std::printf("%-12s %-6s", "system", "method");
+	for (long long budget : budgets)
+		std::printf(" %9lld ev", budget);
+	std::printf(" %14s\n", "evals to 1e-6");
+
+	for (const ExactSystem& system : exact_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%-12s failed to lower: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+		double exact_x, exact_y;
+		system.solution(system.end, exact_x, exact_y);
+
+		for (int m = 0; m < 3; m++) {
+			auto final_error = [&](long long steps, unsigned long long& evaluations) {
+				SystemEval<double> f(context);
+				double x = system.x0;
+				double y = system.y0;
+				integrate_fixed(methods[m], f, 0.0, x, y, system.end / steps, steps);
+				evaluations = f.evaluations;
+				return std::fmax(std::fabs(x - exact_x), std::fabs(y - exact_y));
+			};
+
+			std::printf("%-12s %-6s", system.name, method_names[m]);
+			unsigned long long evaluations;
+			for (long long budget : budgets)
+				std::printf(" %12.3g", final_error(budget / method_stages(methods[m]), evaluations));
+
+			//double the step count until the tolerance holds
+			const char* reached = nullptr;
+			char text[32];
+			for (long long steps = 8; steps <= (1ll << 24); steps *= 2) {
+				if (final_error(steps, evaluations) <= 1e-6) {
+					std::snprintf(text, sizeof(text), "%llu", evaluations);
+					reached = text;
+					break;
+				}
+			}
+			std::printf(" %14s\n", reached ? reached : "-");
+		}
+	}
+}
+
+//fewest evaluations a fixed step rk4 needs to get within error, by doubling the step count
+static unsigned long long rk4_evaluations_for(EvalContext& context, const ExactSystem& system, double error) {
+	double exact_x, exact_y;
+	system.solution(system.end, exact_x, exact_y);
+	for (long long steps = 4; steps <= (1ll << 22); steps *= 2) {
+		SystemEval<double> f(context);
+		double x = system.x0;
+		double y = system.y0;
+		integrate_fixed(Method::Rk4, f, 0.0, x, y, system.end / steps, steps);
+		if (std::fmax(std::fabs(x - exact_x), std::fabs(y - exact_y)) <= error)
+			return f.evaluations;
+	}
+	return 0;
+}
+
+//dormand-prince across tolerances, against the rk4 evaluations for the same final error
+static void bench_adaptive() {
+	const double tolerances[] = { 1e-3, 1e-6, 1e-9, 1e-12 };
+
+	std::printf("%-16s %8s %9s %9s %10s %12s %12s %10s %12s\n", "system", "tol", "accepted", "rejected", "evals",
+		"error", "dense error", "rk4 evals", "savings");
+
+	for (const ExactSystem& system : exact_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%-16s failed to lower: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+		double exact_x, exact_y;
+		system.solution(system.end, exact_x, exact_y);
+
+		for (double tol : tolerances) {
+			SystemEval<double> f(context);
+			Tolerance tolerance;
+			tolerance.relative = tol;
+			tolerance.absolute = tol;
+			DormandPrince<double, SystemEval<double>> solver(f, tolerance);
+			solver.start(0.0, system.x0, system.y0);
+
+			//dense output checked at the midpoint of every step against the closed form
+			double dense_error = 0.0;
+			while (solver.step(system.end)) {
+				double mid = 0.5 * (solver.previous_t + solver.t);
+				double dense_x, dense_y, true_x, true_y;
+				solver.dense(mid, dense_x, dense_y);
+				system.solution(mid, true_x, true_y);
+				dense_error = std::fmax(dense_error, std::fmax(std::fabs(dense_x - true_x), std::fabs(dense_y - true_y)));
+			}
+
+			double error = std::fmax(std::fabs(solver.x - exact_x), std::fabs(solver.y - exact_y));
+			unsigned long long rk4 = rk4_evaluations_for(context, system, error);
+			char savings[32] = "-";
+			if (rk4)
+				std::snprintf(savings, sizeof(savings), "%.2fx", (double)rk4 / solver.stats.evaluations);
+
+			std::printf("%-16s %8.0e %9llu %9llu %10llu %12.3g %12.3g %10llu %12s\n", system.name, tol,
+				solver.stats.accepted, solver.stats.rejected, solver.stats.evaluations, error, dense_error, rk4, savings);
+		}
+	}
+}
+
+//final error of an adaptive solver on an exact system at one tolerance
+template <typename Solver>
+static double adaptive_error(EvalContext& context, const ExactSystem& system, double tol, unsigned long long& evaluations) {
+	SystemEval<double> f(context);
+	Tolerance tolerance;
+	tolerance.relative = tol;
+	tolerance.absolute = tol;
+	Solver solver(f, tolerance);
+	solver.start(0.0, system.x0, system.y0);
+	while (solver.step(system.end)) {}
+	evaluations = solver.stats.evaluations;
+	double exact_x, exact_y;
+	system.solution(system.end, exact_x, exact_y);
+	return std::fmax(std::fabs(solver.x - exact_x), std::fabs(solver.y - exact_y));
+}
+
+//adams-bashforth-moulton against dormand-prince at equal accuracy: abm's tolerance is tightened in
+//half decades until its final error is no worse than dopri45's
+static void bench_multistep() {
+	const double tolerances[] = { 1e-4, 1e-6, 1e-8, 1e-10 };
+	typedef SystemEval<double> F;
+
+	std::printf("%-16s %8s %11s %10s %10s %9s %11s %10s %10s %9s\n", "system", "dp tol", "dp error", "dp evals", "evals/t",
+		"abm tol", "abm error", "abm evals", "evals/t", "savings");
+	for (const ExactSystem& system : exact_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%-16s failed to lower: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+
+		for (double tol : tolerances) {
+			unsigned long long dp_evals = 0, abm_evals = 0;
+			double dp_error = adaptive_error<DormandPrince<double, F>>(context, system, tol, dp_evals);
+			double abm_tol = tol;
+			double abm_error = INFINITY;
+			for (int k = 0; k < 16 && !(abm_error <= dp_error); k++, abm_tol /= std::sqrt(10.0))
+				abm_error = adaptive_error<AdamsBashforthMoulton<double, F>>(context, system, abm_tol, abm_evals);
+			if (!(abm_error <= dp_error)) {
+				std::printf("%-16s %8.0e %11.3g %10llu %10.1f %9s\n", system.name, tol, dp_error, dp_evals, dp_evals / system.end, "-");
+				continue;
+			}
+			abm_tol *= std::sqrt(10.0);
+			std::printf("%-16s %8.0e %11.3g %10llu %10.1f %9.1e %11.3g %10llu %10.1f %8.2fx\n", system.name, tol, dp_error,
+				dp_evals, dp_evals / system.end, abm_tol, abm_error, abm_evals, abm_evals / system.end, (double)dp_evals / abm_evals);
+		}
+	}
+}
+
+//one adaptive run: final error, evaluations, and wall time averaged over repeats
+struct WorkPoint {
+	double error;
+	unsigned long long evaluations;
+	double seconds;
+};
+
+template <typename Solver>
+static WorkPoint work_point(EvalContext& context, const ExactSystem& system, double tol) {
+	WorkPoint point;
+	point.error = adaptive_error<Solver>(context, system, tol, point.evaluations);
+	//single runs are microseconds, repeat until the clock resolves them
+	int runs = 0;
+	auto start = std::chrono::steady_clock::now();
+	do {
+		unsigned long long evaluations;
+		adaptive_error<Solver>(context, system, tol, evaluations);
+		runs++;
+	} while (seconds_since(start) < 0.01);
+	point.seconds = seconds_since(start) / runs;
+	return point;
+}
+
+struct WorkSolver {
+	const char* name;
+	WorkPoint(*run)(EvalContext&, const ExactSystem&, double);
+};
+
+//every explicit adaptive solver swept over tolerances in half decades. per final error band each
+//column is the evaluations of that solver's fastest run reaching it, the last the fastest solver overall
+static void bench_work_precision() {
+	typedef SystemEval<double> F;
+	const WorkSolver solvers[] = {
+		{ "dopri45", work_point<DormandPrince<double, F>> },
+		{ "tsit5", work_point<EmbeddedRk<Tsit5Tableau, double, F>> },
+		{ "verner65", work_point<EmbeddedRk<Verner65Tableau, double, F>> },
+		{ "abm4", work_point<AdamsBashforthMoulton<double, F>> },
+		{ "bulirsch", work_point<BulirschStoer<double, F>> },
+	};
+	const int solver_count = sizeof(solvers) / sizeof(solvers[0]);
+	const double bands[] = { 1e-4, 1e-6, 1e-8, 1e-10, 1e-12 };
+	const int sweep = 25;
+
+	for (const ExactSystem& system : exact_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%-16s failed to lower: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+
+		std::vector<WorkPoint> points[solver_count];
+		for (int s = 0; s < solver_count; s++) {
+			for (int k = 0; k < sweep; k++)
+				points[s].push_back(solvers[s].run(context, system, 1e-2 * std::pow(10.0, -0.5 * k)));
+		}
+
+		std::printf("%-16s %8s", system.name, "error");
+		for (int s = 0; s < solver_count; s++)
+			std::printf(" %10s", solvers[s].name);
+		std::printf(" %10s %8s\n", "fastest", "us");
+		for (double band : bands) {
+			std::printf("%-16s %8.0e", "", band);
+			int fastest = -1;
+			double fastest_seconds = INFINITY;
+			for (int s = 0; s < solver_count; s++) {
+				const WorkPoint* best = nullptr;
+				for (const WorkPoint& point : points[s]) {
+					if (point.error <= band && (!best || point.seconds < best->seconds))
+						best = &point;
+				}
+				if (!best) {
+					std::printf(" %10s", "-");
+					continue;
+				}
+				std::printf(" %10llu", best->evaluations);
+				if (best->seconds < fastest_seconds) {
+					fastest_seconds = best->seconds;
+					fastest = s;
+				}
+			}
+			if (fastest >= 0)
+				std::printf(" %10s %8.1f\n", solvers[fastest].name, fastest_seconds * 1e6);
+			else
+				std::printf(" %10s\n", "-");
+		}
+	}
+}
+
+//taylor series against dormand-prince (rk45) on the exact systems, wall time per solve at the same tolerance.
+//taylor evals are expansions of order p, roughly p / 2 plain evaluations of work each
+static void bench_taylor() {
+	typedef SystemEval<double> F;
+	const double tolerances[] = { 1e-6, 1e-9, 1e-12 };
+
+	std::printf("%-16s %8s %10s %11s %9s %6s %10s %11s %9s %9s\n", "system", "tol", "dp evals", "dp error", "dp us",
+		"order", "tay steps", "tay error", "tay us", "speedup");
+	for (const ExactSystem& system : exact_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_taylor()) {
+			std::printf("%-16s no taylor program: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+
+		for (double tol : tolerances) {
+			WorkPoint dp = work_point<DormandPrince<double, F>>(context, system, tol);
+			WorkPoint taylor = work_point<Taylor<double, F>>(context, system, tol);
+			SystemEval<double> f(context);
+			Tolerance tolerance;
+			tolerance.relative = tol;
+			tolerance.absolute = tol;
+			int order = Taylor<double, F>(f, tolerance).order;
+			std::printf("%-16s %8.0e %10llu %11.3g %9.1f %6d %10llu %11.3g %9.1f %8.2fx\n", system.name, tol,
+				dp.evaluations, dp.error, dp.seconds * 1e6, order, taylor.evaluations, taylor.error, taylor.seconds * 1e6,
+				dp.seconds / taylor.seconds);
+		}
+	}
+}
+
+static const double precision_tolerances[] = { 1e-2, 1e-4, 1e-6, 1e-8, 1e-10, 1e-12 };
+static const int precision_tolerance_count = sizeof(precision_tolerances) / sizeof(precision_tolerances[0]);
+
+//fewest steps (doubling from 16) that bring the linear system to its exact solution at t = 10,
+//so rounding shows up as a tolerance a precision can never reach
+template <typename T>
+static void work_precision_row(EvalContext& context, const char* precision, Method method, const char* method_name) {
+	const double end = 10.0;
+	const int max_doublings = 18;
+
+	//x' = -0.1x - y, y' = x - 0.1y from (1, 0) is a decaying rotation
+	DoubleDouble decay = exp(-DoubleDouble(0.1) * DoubleDouble(end));
+	DoubleDouble exact_x = decay * cos(DoubleDouble(end));
+	DoubleDouble exact_y = decay * sin(DoubleDouble(end));
+
+	long long steps_needed[precision_tolerance_count];
+	for (int k = 0; k < precision_tolerance_count; k++)
+		steps_needed[k] = 0;
+
+	double best_error = INFINITY;
+	auto start = std::chrono::steady_clock::now();
+	for (int d = 0; d <= max_doublings; d++) {
+		long long steps = 16ll << d;
+		SystemEval<T> f(context);
+		T x = T(1);
+		T y = T(0);
+		integrate_fixed(method, f, T(0), x, y, T(end / steps), steps);
+
+		double error = std::fmax(std::fabs((double)(DoubleDouble(x) - exact_x)), std::fabs((double)(DoubleDouble(y) - exact_y)));
+		best_error = std::fmin(best_error, error);
+		for (int k = 0; k < precision_tolerance_count; k++) {
+			if (steps_needed[k] == 0 && error <= precision_tolerances[k])
+				steps_needed[k] = steps;
+		}
+	}
+	double seconds = seconds_since(start);
+
+	std::printf("%-14s %-6s", precision, method_name);
+	for (int k = 0; k < precision_tolerance_count; k++) {
+		if (steps_needed[k])
+			std::printf(" %9lld", steps_needed[k]);
+		else
+			std::printf(" %9s", "-");
+	}
+	std::printf(" %11.3g %8.2f\n", best_error, seconds);
+}
+
+//steps to reach each tolerance per scalar type, - means unreachable within 16 << 18 steps
+static void bench_precision() {
+	EvalContext context;
+	if (!context.compile(test_systems[0].dx, test_systems[0].dy) || !context.has_program()) {
+		std::printf("linear system failed to lower: %s%s\n", context.error().c_str(), context.lowering_error().c_str());
+		return;
+	}
+
+	std::printf("%-14s %-6s", "precision", "method");
+	for (int k = 0; k < precision_tolerance_count; k++)
+		std::printf(" %9.0e", precision_tolerances[k]);
+	std::printf(" %11s %8s\n", "best error", "seconds");
+
+	const Method methods[] = { Method::Euler, Method::Heun };
+	const char* method_names[] = { "euler", "heun" };
+	for (int m = 0; m < 2; m++) {
+		work_precision_row<float>(context, "float", methods[m], method_names[m]);
+		work_precision_row<double>(context, "double", methods[m], method_names[m]);
+		work_precision_row<DoubleDouble>(context, "double-double", methods[m], method_names[m]);
+	}
+}
+
+//the test systems plus one where every seed with x > tan(pi/2 - 1) blows up before t = 1
+static const TestSystem ensemble_systems[] = {
+	{ "linear", "-0.1*x - y", "x - 0.1*y" },
+	{ "van der pol", "y", "1.5*(1 - x^2)*y - x" },
+	{ "lotka-volterra", "1.1*x - 0.4*x*y", "0.1*x*y - 0.4*y" },
+	{ "pendulum", "y", "-sin(x)" },
+	{ "blow-up", "x^2 + 1", "-y" },
+};
+
+//the ensemble's rk4 on 1, 2, 4, 8 and 16 threads, speedup and efficiency against one. counts past the
+//hardware's still run, so stealing and the results are checked everywhere, but are marked oversubscribed
+//and cannot scale. every count has to reproduce the single thread results exactly
+static void ensemble_scaling() {
+	const int grid = 316;
+	const long long steps = 1000;
+	const float h = 0.001f;
+	const int most = 16;
+	int hardware = (int)std::thread::hardware_concurrency();
+
+	std::printf("hardware threads: %d, %d trajectories x %lld rk4 steps\n", hardware, grid * grid, steps);
+	std::printf("%-16s %7s %10s %12s %9s %11s %8s %10s %9s\n", "system", "threads", "seconds", "Msteps/s", "speedup",
+		"efficiency", "steals", "copies ms", "same");
+	for (int s = 0; s < 2; s++) {
+		const TestSystem& system = s == 0 ? ensemble_systems[1] : ensemble_systems[4];
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%-16s failed to lower: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+
+		std::vector<TrajectoryResult> reference;
+		double single = 0.0;
+		for (int threads = 1; threads <= most; threads *= 2) {
+			TaskScheduler scheduler(threads - 1);
+			WorkerContexts contexts;
+			contexts.bind(context, scheduler.participants());
+
+			Ensemble ensemble(context);
+			for (int i = 0; i < grid * grid; i++)
+				ensemble.add((i % grid) * (4.0f / grid) - 2.0f, (i / grid) * (4.0f / grid) - 2.0f, steps);
+			auto start = std::chrono::steady_clock::now();
+			ensemble.advance(Method::Rk4, h, steps, scheduler, contexts);
+			double seconds = seconds_since(start);
+
+			bool same = true;
+			if (threads == 1) {
+				reference = ensemble.results;
+				single = seconds;
+			}
+			for (size_t i = 0; i < reference.size() && same; i++) {
+				const TrajectoryResult& a = reference[i];
+				const TrajectoryResult& b = ensemble.results[i];
+				same = a.state == b.state && a.steps == b.steps &&
+					(a.x == b.x || (std::isnan(a.x) && std::isnan(b.x))) && (a.y == b.y || (std::isnan(a.y) && std::isnan(b.y)));
+			}
+			std::printf("%-16s %7d %10.3f %12.1f %8.2fx %10.0f%% %8llu %10.2f %9s%s\n", system.name, threads, seconds,
+				(double)grid * grid * steps / seconds * 1e-6, single / seconds, single / seconds / threads * 100.0,
+				scheduler.steals.load(), contexts.build_ms, same ? "yes" : "NO", threads > hardware ? "  oversubscribed" : "");
+		}
+	}
+}
+
+//100k trajectories from a seed grid for 1000 fixed steps in lockstep, against the same work as one scalar
+//SystemEval<float> loop per trajectory (timed on a tenth of the seeds and scaled up). lanes is the
+//evaluations made over what every trajectory running every step would cost, escaped ones are compacted out.
+//then the scaling over threads
+static void bench_ensemble() {
+	const int grid = 316;
+	const long long steps = 1000;
+	const float h = 0.001f;
+	const int scalar_stride = 10;
+	const Method methods[] = { Method::Euler, Method::Heun, Method::Rk4 };
+	const char* method_names[] = { "euler", "heun", "rk4" };
+
+	std::printf("simd: %s, %d lanes, %d trajectories x %lld steps\n", SIMD_NAME, SIMD_WIDTH, grid * grid, steps);
+	std::printf("%-16s %-6s %10s %12s %10s %12s %8s %9s %12s\n", "system", "method", "seconds", "Msteps/s", "escaped",
+		"scalar s", "speedup", "lanes", "max diff");
+	for (const TestSystem& system : ensemble_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%-16s failed to lower: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+
+		for (int m = 0; m < 3; m++) {
+			Ensemble ensemble(context);
+			for (int i = 0; i < grid * grid; i++)
+				ensemble.add((i % grid) * (4.0f / grid) - 2.0f, (i / grid) * (4.0f / grid) - 2.0f, steps);
+
+			auto start = std::chrono::steady_clock::now();
+			ensemble.advance(methods[m], h, steps);
+			double seconds = seconds_since(start);
+
+			//the scalar reference integrates every tenth seed, escape rules as in the ensemble
+			start = std::chrono::steady_clock::now();
+			float max_diff = 0.0f;
+			for (int i = 0; i < grid * grid; i += scalar_stride) {
+				SystemEval<float> f(context);
+				float x = (i % grid) * (4.0f / grid) - 2.0f;
+				float y = (i / grid) * (4.0f / grid) - 2.0f;
+				for (long long k = 0; k < steps; k++) {
+					step(methods[m], f, h * (float)k, x, y, h);
+					if ((k + 1) % Ensemble::check_interval == 0 && !(std::fabs(x) <= ensemble.escape_radius && std::fabs(y) <= ensemble.escape_radius))
+						break;
+				}
+				const TrajectoryResult& result = ensemble.results[i];
+				if (result.state == TrajectoryState::Finished)
+					max_diff = std::fmax(max_diff, std::fmax(std::fabs(result.x - x), std::fabs(result.y - y)));
+			}
+			double scalar_seconds = seconds_since(start) * scalar_stride;
+
+			int escaped = 0;
+			for (const TrajectoryResult& result : ensemble.results)
+				escaped += result.state == TrajectoryState::Escaped || result.state == TrajectoryState::Diverged;
+			double lanes = (double)ensemble.evaluations / ((double)grid * grid * steps * method_stages(methods[m]));
+			std::printf("%-16s %-6s %10.3f %12.1f %10d %12.3f %7.2fx %8.1f%% %12g\n", system.name, method_names[m], seconds,
+				(double)grid * grid * steps / seconds * 1e-6, escaped, scalar_seconds, scalar_seconds / seconds, lanes * 100.0, max_diff);
+		}
+	}
+
+	std::printf("\n");
+	ensemble_scaling();
+}
+
+
+//copies of a compiled system for 16 threads, parsed again against cloned from the lowered program. the
+//clones have to evaluate bit for bit like the source, and no cache line written by one context may be
+//written by another, or threads on separate copies would still contend
+static void bench_clone() {
+	const int copies = 16;
+	const int states = 1000;
+	std::vector<TestSystem> systems(test_systems, test_systems + 4);
+	systems.insert(systems.end(), shared_systems, shared_systems + 3);
+
+	std::printf("%d copies each\n", copies);
+	std::printf("%-16s %14s %14s %9s %6s %13s\n", "system", "reparse us", "clone us", "speedup", "same", "shared lines");
+	for (const TestSystem& system : systems) {
+		EvalContext source;
+		if (!source.compile(system.dx, system.dy) || !source.has_program()) {
+			std::printf("%-16s failed to lower: %s%s\n", system.name, source.error().c_str(), source.lowering_error().c_str());
+			continue;
+		}
+
+		std::vector<std::unique_ptr<EvalContext>> parsed;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < copies; i++) {
+			parsed.emplace_back(new EvalContext());
+			parsed.back()->compile_copy(source);
+		}
+		double parse_seconds = seconds_since(start);
+
+		//cloning is fast enough to need repeats for a stable time
+		std::vector<std::unique_ptr<EvalContext>> clones;
+		int rounds = 0;
+		start = std::chrono::steady_clock::now();
+		do {
+			clones.clear();
+			for (int i = 0; i < copies; i++) {
+				clones.emplace_back(new EvalContext());
+				clones.back()->clone_from(source);
+			}
+			rounds++;
+		} while (seconds_since(start) < 0.01);
+		double clone_seconds = seconds_since(start) / rounds;
+
+		std::vector<float> xs(states), ys(states), ref_x(states), ref_y(states), dxs(states), dys(states);
+		for (int i = 0; i < states; i++) {
+			xs[i] = -3.0f + 6.0f * (float)i / states;
+			ys[i] = 2.0f - 4.5f * (float)((i * 7) % states) / states;
+		}
+		source.eval_batch(0.5f, xs.data(), ys.data(), ref_x.data(), ref_y.data(), states);
+		bool same = true;
+		std::vector<std::vector<uintptr_t>> lines(copies + 1);
+		for (int c = 0; c < copies; c++) {
+			EvalContext& clone = *clones[c];
+			clone.eval_batch(0.5f, xs.data(), ys.data(), dxs.data(), dys.data(), states);
+			for (int i = 0; i < states; i++) {
+				float clone_x, clone_y, source_x, source_y;
+				clone.eval(0.5f, xs[i], ys[i], clone_x, clone_y);
+				source.eval_bytecode(0.5f, xs[i], ys[i], source_x, source_y);
+				same = same && std::memcmp(&dxs[i], &ref_x[i], sizeof(float)) == 0 && std::memcmp(&dys[i], &ref_y[i], sizeof(float)) == 0 &&
+					std::memcmp(&clone_x, &source_x, sizeof(float)) == 0 && std::memcmp(&clone_y, &source_y, sizeof(float)) == 0;
+			}
+			clone.written_lines(lines[c]);
+		}
+		source.written_lines(lines[copies]);
+
+		//lines that show up in more than one context's set
+		std::vector<uintptr_t> all;
+		for (std::vector<uintptr_t>& set : lines) {
+			std::sort(set.begin(), set.end());
+			set.erase(std::unique(set.begin(), set.end()), set.end());
+			all.insert(all.end(), set.begin(), set.end());
+		}
+		std::sort(all.begin(), all.end());
+		int shared = 0;
+		for (size_t i = 1; i < all.size(); i++)
+			shared += all[i] == all[i - 1] && (i < 2 || all[i - 1] != all[i - 2]);
+
+		std::printf("%-16s %14.1f %14.2f %8.0fx %6s %13d\n", system.name, parse_seconds / copies * 1e6,
+			clone_seconds / copies * 1e6, parse_seconds / clone_seconds, same ? "yes" : "NO", shared);
+	}
+}
+
+//the oscillator from (1, 0) crosses x = 0 at pi / 2 + k pi, the located times against those
+template <typename Solver>
+static double event_accuracy(const char* name, EvalContext& context, EventSet& events, double tol) {
+	const double pi = 3.14159265358979323846;
+	SystemEval<double> f(context);
+	Tolerance tolerance;
+	tolerance.relative = tol;
+	tolerance.absolute = tol;
+	Solver solver(f, tolerance);
+	EventTracker<double, Solver> tracker(events);
+	solver.start(0.0, 1.0, 0.0);
+	tracker.start(0.0, 1.0, 0.0);
+	while (solver.step(20.0))
+		tracker.check(solver);
+
+	double worst = 0.0;
+	for (size_t k = 0; k < tracker.hits.size(); k++)
+		worst = std::fmax(worst, std::fabs(tracker.hits[k].t - (pi / 2.0 + pi * (double)k)));
+	std::printf("%-10s %8.0e %6zu %14.3g %8llu %12llu\n", name, tol, tracker.hits.size(), worst, solver.stats.accepted,
+		tracker.evaluations);
+	return tracker.hits.size() == 6 ? worst : INFINITY;
+}
+
+//event location on dense output, then ensembles that stop members at terminal events instead of
+//integrating them to the end and scanning the points afterwards
+static void bench_events() {
+	typedef SystemEval<double> F;
+	EvalContext oscillator;
+	EventSet crossings;
+	std::vector<EventSpec> specs(1);
+	specs[0].expression = "x";
+	if (!oscillator.compile("y", "-x") || !crossings.compile(specs)) {
+		std::printf("failed to compile: %s%s\n", oscillator.error().c_str(), crossings.error().c_str());
+		return;
+	}
+
+	std::printf("oscillator x = 0 crossings on [0, 20], 6 expected\n");
+	std::printf("%-10s %8s %6s %14s %8s %12s\n", "method", "tol", "hits", "max t error", "steps", "event evals");
+	//the located times have to follow the tolerance, within a factor of it at every tolerance
+	const char* methods[] = { "dopri45", "verner65", "bulirsch", "taylor" };
+	const double tols[] = { 1e-6, 1e-8, 1e-10 };
+	const double slack = 100.0;
+	bool follows[4] = { true, true, true, true };
+	for (double tol : tols) {
+		double worst[4];
+		worst[0] = event_accuracy<DormandPrince<double, F>>(methods[0], oscillator, crossings, tol);
+		worst[1] = event_accuracy<EmbeddedRk<Verner65Tableau, double, F>>(methods[1], oscillator, crossings, tol);
+		worst[2] = event_accuracy<BulirschStoer<double, F>>(methods[2], oscillator, crossings, tol);
+		worst[3] = event_accuracy<Taylor<double, F>>(methods[3], oscillator, crossings, tol);
+		for (int m = 0; m < 4; m++)
+			follows[m] = follows[m] && worst[m] <= slack * tol;
+	}
+	std::printf("event times within %gx the tolerance:", slack);
+	for (int m = 0; m < 4; m++)
+		std::printf(" %s %s", methods[m], follows[m] ? "PASS" : "FAIL");
+	std::printf("\n");
+
+	//a first return to a section, and leaving the view instead of the escape box far outside it
+	struct EventCase {
+		const TestSystem* system;
+		const char* expression;
+		const char* name;
+	};
+	const EventCase cases[] = {
+		{ &ensemble_systems[1], "x", "first rising x = 0" },
+		{ &ensemble_systems[4], "x - 2", "leaves the view" },
+	};
+	const int grid = 316;
+	const long long steps = 1000;
+	const float h = 0.001f;
+
+	std::printf("%d trajectories x %lld rk4 steps\n", grid * grid, steps);
+	std::printf("%-16s %-20s %10s %14s %8s %10s %12s %12s\n", "system", "terminal event", "stopped", "steps", "saved",
+		"seconds", "no events s", "event evals");
+	for (const EventCase& test : cases) {
+		EvalContext context;
+		if (!context.compile(test.system->dx, test.system->dy)) {
+			std::printf("%-16s failed to compile: %s\n", test.system->name, context.error().c_str());
+			continue;
+		}
+		EventSet events;
+		std::vector<EventSpec> terminal(1);
+		terminal[0].expression = test.expression;
+		terminal[0].direction = 1;
+		terminal[0].terminal = true;
+		events.compile(terminal);
+		events.bind_parameters(context);
+
+		double seconds[2];
+		long long taken = 0;
+		int stopped = 0;
+		unsigned long long event_evaluations = 0;
+		for (int with = 1; with >= 0; with--) {
+			Ensemble ensemble(context);
+			ensemble.set_events(with ? &events : nullptr);
+			for (int i = 0; i < grid * grid; i++)
+				ensemble.add((i % grid) * (4.0f / grid) - 2.0f, (i / grid) * (4.0f / grid) - 2.0f, steps);
+			auto start = std::chrono::steady_clock::now();
+			ensemble.advance(Method::Rk4, h, steps);
+			seconds[with] = seconds_since(start);
+			if (!with)
+				continue;
+			for (const TrajectoryResult& result : ensemble.results) {
+				taken += result.steps;
+				stopped += result.state == TrajectoryState::Stopped;
+			}
+			event_evaluations = ensemble.event_evaluations;
+		}
+		double all = (double)grid * grid * steps;
+		std::printf("%-16s %-20s %10d %14lld %7.1f%% %10.3f %12.3f %12llu\n", test.system->name, test.name, stopped, taken,
+			(1.0 - (double)taken / all) * 100.0, seconds[1], seconds[0], event_evaluations);
+	}
+}
+
+//a long path built in frame sized slices against the same path in one go. the samples have to match
+//exactly, and no slice may run much past its budget
+template <typename Path>
+static void incremental_row(const char* name, double budget_ms, Path& whole, Path& sliced) {
+	PathBudget unlimited;
+	whole.extend(unlimited);
+
+	PathBudget budget;
+	budget.seconds = budget_ms * 1e-3;
+	while (sliced.extend(budget)) {}
+
+	bool same = whole.points == sliced.points;
+	std::printf("%-24s %8zu %10.2f %8d %12.3f %12.3f %6s\n", name, whole.samples(), whole.seconds * 1e3, sliced.slices,
+		sliced.seconds * 1e3 / (sliced.slices > 0 ? sliced.slices : 1), sliced.longest_slice * 1e3, same ? "yes" : "NO");
+}
+
+static void bench_incremental() {
+	const double spacing = 0.005;
+	const double budget_ms = 2.0;
+	EvalContext vdp;
+	EvalContext stiff;
+	EventSet events;
+	if (!vdp.compile("y", "1.5*(1 - x^2)*y - x") || !stiff.compile("y", "1000*(1 - x^2)*y - x")) {
+		std::printf("failed to compile: %s%s\n", vdp.error().c_str(), stiff.error().c_str());
+		return;
+	}
+	Tolerance tight;
+	tight.relative = tight.absolute = 1e-10;
+	Tolerance loose;
+	loose.relative = loose.absolute = 1e-6;
+
+	std::printf("%.1f ms slices, samples %g apart\n", budget_ms, spacing);
+	std::printf("%-24s %8s %10s %8s %12s %12s %6s\n", "path", "samples", "whole ms", "slices", "mean ms", "longest ms", "same");
+	{
+		AdaptivePath<double, DormandPrince> whole(vdp, events, tight, 0.5, 0.0, spacing, 1000.0);
+		AdaptivePath<double, DormandPrince> sliced(vdp, events, tight, 0.5, 0.0, spacing, 1000.0);
+		incremental_row("van der pol dopri 1e-10", budget_ms, whole, sliced);
+	}
+	{
+		AdaptivePath<DoubleDouble, Taylor> whole(vdp, events, tight, DoubleDouble(0.5), DoubleDouble(0.0), spacing, 300.0);
+		AdaptivePath<DoubleDouble, Taylor> sliced(vdp, events, tight, DoubleDouble(0.5), DoubleDouble(0.0), spacing, 300.0);
+		incremental_row("van der pol taylor dd", budget_ms, whole, sliced);
+	}
+	{
+		AdaptivePath<double, Bdf> whole(stiff, events, loose, 2.0, 0.0, spacing, 3000.0);
+		AdaptivePath<double, Bdf> sliced(stiff, events, loose, 2.0, 0.0, spacing, 3000.0);
+		incremental_row("van der pol 1e3 bdf", budget_ms, whole, sliced);
+	}
+	{
+		FixedPath<double> whole(vdp, Method::Rk4, 0.5, 0.0, spacing, 1000.0);
+		FixedPath<double> sliced(vdp, Method::Rk4, 0.5, 0.0, spacing, 1000.0);
+		incremental_row("van der pol rk4", budget_ms, whole, sliced);
+	}
+}
+
+//a path grown by the frame scheduler, as the application's PathTask does
+class BenchPathTask : public FrameTask {
+public:
+	explicit BenchPathTask(IncrementalPath& path) : path(path) {}
+	const char* name() const override { return "path"; }
+	int priority() const override { return 0; }
+	bool pending() const override { return !path.complete(); }
+	bool run(double seconds) override {
+		PathBudget budget;
+		budget.seconds = seconds;
+		return path.extend(budget);
+	}
+
+private:
+	IncrementalPath& path;
+};
+
+static void spin(double seconds) {
+	auto start = std::chrono::steady_clock::now();
+	while (seconds_since(start) < seconds) {}
+}
+
+//longest gap between two clock reads of a loop doing nothing else, what the OS alone adds to any slice
+static double clock_gap(double seconds) {
+	auto start = std::chrono::steady_clock::now();
+	auto previous = start;
+	double worst = 0.0;
+	while (seconds_since(start) < seconds) {
+		auto now = std::chrono::steady_clock::now();
+		worst = std::max(worst, std::chrono::duration<double>(now - previous).count());
+		previous = now;
+	}
+	return worst;
+}
+
+//frames at 60 Hz that spin for a fixed render cost and then wait out the interval as vsync would. compute
+//should fill what is left up to the deadline and never push a frame past it. a render that leaves less
+//than min_chunk before the deadline gets no compute, those rows stop after a history of frames
+static void bench_frames() {
+	const double spacing = 0.005;
+	EvalContext vdp;
+	EventSet events;
+	if (!vdp.compile("y", "1.5*(1 - x^2)*y - x")) {
+		std::printf("failed to compile: %s\n", vdp.error().c_str());
+		return;
+	}
+	Tolerance tight;
+	tight.relative = tight.absolute = 1e-10;
+
+	std::printf("60 Hz, deadline at 85%% of the interval, van der pol dopri 1e-10 to t = 2000\n");
+	std::printf("a bare loop reading the clock for 1 s saw gaps up to %.3f ms, worst past includes those\n",
+		clock_gap(1.0) * 1e3);
+	std::printf("%10s %8s %12s %12s %12s %9s\n", "render ms", "frames", "budget ms", "compute ms", "worst past", "overruns");
+	const double render_ms[] = { 1.0, 6.0, 12.0, 14.0, 15.0 };
+	for (double render : render_ms) {
+		AdaptivePath<double, DormandPrince> path(vdp, events, tight, 0.5, 0.0, spacing, 2000.0);
+		BenchPathTask task(path);
+		std::vector<FrameTask*> tasks = { &task };
+		FrameScheduler frames(60.0);
+		bool computes = render * 1e-3 + frames.min_chunk <= frames.interval() * frames.deadline_share;
+		int max_frames = computes ? 2000 : FrameScheduler::history;
+
+		int count = 0;
+		double budget = 0.0, compute = 0.0, worst = 0.0;
+		while (!path.complete() && count < max_frames) {
+			auto start = std::chrono::steady_clock::now();
+			frames.begin_frame();
+			spin(render * 1e-3);
+			frames.end_render();
+			frames.run(tasks);
+			//how far compute ran past its budget, timing noise of a shared machine included
+			worst = std::max(worst, (double)(frames.in_progress().compute - frames.in_progress().budget));
+			double left = frames.interval() - seconds_since(start);
+			if (left > 0.0)
+				std::this_thread::sleep_for(std::chrono::duration<double>(left));
+			count++;
+		}
+		frames.begin_frame();
+		for (int age = 0; age < frames.recorded(); age++) {
+			budget += frames.record(age).budget;
+			compute += frames.record(age).compute;
+		}
+		int recorded = frames.recorded() > 0 ? frames.recorded() : 1;
+		std::printf("%10.1f %8d %12.3f %12.3f %12.3f %9llu\n", render, count, budget / recorded, compute / recorded, worst,
+			frames.overruns);
+	}
+}
+
+struct StiffSystem {
+	const char* name;
+	const char* dx;
+	const char* dy;
+	double x0, y0;
+	double end;
+	double absolute_scale;      //absolute tolerance = relative * this, for components far below 1
+};
+
+//robertson's kinetics with the third species eliminated through x + y + z = 1,
+//y sits near 1e-5 while rates span nine orders of magnitude
+static const StiffSystem stiff_systems[] = {
+	{ "robertson", "-0.04*x + 1e4*y*(1 - x - y)", "0.04*x - 1e4*y*(1 - x - y) - 3e7*y^2", 1.0, 0.0, 40.0, 1e-4 },
+	{ "van der pol 1e3", "y", "1000*(1 - x^2)*y - x", 2.0, 0.0, 3000.0, 1.0 },
+};
+
+struct StiffRun {
+	StepStats stats;
+	double x, y;
+	double seconds;
+	bool finished;
+};
+
+//runs to the system's end unless evaluations pass the budget, explicit methods get stuck on stability
+template <typename Solver>
+static StiffRun run_stiff(EvalContext& context, const StiffSystem& system, double tol, unsigned long long budget) {
+	SystemEval<double> f(context);
+	Tolerance tolerance;
+	tolerance.relative = tol;
+	tolerance.absolute = tol * system.absolute_scale;
+	Solver solver(f, tolerance);
+
+	StiffRun run;
+	auto start = std::chrono::steady_clock::now();
+	solver.start(0.0, system.x0, system.y0);
+	while (solver.step(system.end) && solver.stats.evaluations < budget) {}
+	run.seconds = seconds_since(start);
+	run.stats = solver.stats;
+	run.x = solver.x;
+	run.y = solver.y;
+	run.finished = solver.t >= system.end;
+	return run;
+}
+
+static void stiff_row(const char* method, double tol, const StiffRun& run, double reference_x, double reference_y) {
+	if (!run.finished) {
+		std::printf("  %-10s %8.0e %9.2f %9llu %9llu %10llu %6llu %6llu %12s\n", method, tol, run.seconds * 1e3,
+			run.stats.accepted, run.stats.rejected, run.stats.evaluations, run.stats.jacobians, run.stats.factorizations, "gave up");
+		return;
+	}
+	double error = std::fmax(std::fabs(run.x - reference_x), std::fabs(run.y - reference_y));
+	std::printf("  %-10s %8.0e %9.2f %9llu %9llu %10llu %6llu %6llu %12.3g\n", method, tol, run.seconds * 1e3,
+		run.stats.accepted, run.stats.rejected, run.stats.evaluations, run.stats.jacobians, run.stats.factorizations, error);
+}
+
+//implicit solvers against dormand-prince on stiff systems, error is at the end against a tight bdf run
+static void bench_stiff() {
+	const double tolerances[] = { 1e-3, 1e-6, 1e-8 };
+	const unsigned long long budget = 4000000;
+
+	for (const StiffSystem& system : stiff_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%s failed to lower: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+		StiffRun reference = run_stiff<Bdf<double, SystemEval<double>>>(context, system, 1e-12, ~0ull);
+		std::printf("%s to t = %g, reference (%.10g, %.10g)\n", system.name, system.end, reference.x, reference.y);
+		std::printf("  %-10s %8s %9s %9s %9s %10s %6s %6s %12s\n", "method", "tol", "ms", "accepted", "rejected",
+			"evals", "jac", "lu", "error");
+
+		for (double tol : tolerances) {
+			stiff_row("bdf", tol, run_stiff<Bdf<double, SystemEval<double>>>(context, system, tol, budget), reference.x, reference.y);
+			stiff_row("rosenbrock", tol, run_stiff<Rosenbrock2<double, SystemEval<double>>>(context, system, tol, budget), reference.x, reference.y);
+			stiff_row("dopri45", tol, run_stiff<DormandPrince<double, SystemEval<double>>>(context, system, tol, budget), reference.x, reference.y);
+		}
+	}
+}
+
+//the stiff systems plus one that never is, automatic switching should leave it on dormand-prince
+static const StiffSystem switching_systems[] = {
+	stiff_systems[0],
+	stiff_systems[1],
+	{ "oscillator", "y", "-x", 1.0, 0.0, 100.0, 1.0 },
+};
+
+//automatic stiffness switching against staying on either method, with the switch log of each run
+static void bench_switching() {
+	const double tol = 1e-6;
+	const unsigned long long budget = 4000000;
+	const size_t shown_switches = 8;
+
+	for (const StiffSystem& system : switching_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program()) {
+			std::printf("%s failed to lower: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+		StiffRun reference = run_stiff<Bdf<double, SystemEval<double>>>(context, system, 1e-12, ~0ull);
+		std::printf("%s to t = %g, tol %.0e\n", system.name, system.end, tol);
+		std::printf("  %-10s %8s %9s %9s %9s %10s %6s %6s %12s\n", "method", "tol", "ms", "accepted", "rejected",
+			"evals", "jac", "lu", "error");
+		stiff_row("dopri45", tol, run_stiff<DormandPrince<double, SystemEval<double>>>(context, system, tol, budget), reference.x, reference.y);
+		stiff_row("bdf", tol, run_stiff<Bdf<double, SystemEval<double>>>(context, system, tol, budget), reference.x, reference.y);
+
+		SystemEval<double> f(context);
+		Tolerance tolerance;
+		tolerance.relative = tol;
+		tolerance.absolute = tol * system.absolute_scale;
+		AutoSwitch<double, SystemEval<double>> solver(f, tolerance);
+		StiffRun run;
+		auto start = std::chrono::steady_clock::now();
+		solver.start(0.0, system.x0, system.y0);
+		while (solver.step(system.end) && solver.stats.evaluations < budget) {}
+		run.seconds = seconds_since(start);
+		run.stats = solver.stats;
+		run.x = solver.x;
+		run.y = solver.y;
+		run.finished = solver.t >= system.end;
+		stiff_row("auto", tol, run, reference.x, reference.y);
+
+		std::printf("  %zu switches\n", solver.switches.size());
+		for (size_t i = 0; i < solver.switches.size() && i < shown_switches; i++) {
+			const MethodSwitch& entry = solver.switches[i];
+			std::printf("    t = %-12.6g to %-8s h rho = %-8.3g %s\n", entry.t, entry.to_implicit ? "bdf" : "dopri45",
+				entry.h_rho, entry.reason_text());
+		}
+	}
+}
+
+//separable systems, dx depends on y alone and dy on x alone
+static const TestSystem hamiltonian_systems[] = {
+	{ "harmonic", "y", "-x" },
+	{ "pendulum", "y", "-sin(x)" },
+	{ "quartic", "y", "-x^3" },
+};
+
+//energy drift of every fixed step method over a million steps from (1, 0), at a small and a large step.
+//energy sampled every thousand steps
+static void bench_symplectic() {
+	const long long steps = 1000000;
+	const long long sample_every = 1000;
+	const double step_sizes[] = { 0.01, 0.1 };
+	const Method methods[] = { Method::Euler, Method::Heun, Method::Rk4, Method::Leapfrog, Method::Yoshida4 };
+	const char* method_names[] = { "euler", "heun", "rk4", "leapfrog", "yoshida4" };
+
+	std::printf("%-10s %5s %-9s %10s %9s %14s %14s\n", "system", "h", "method", "evals", "seconds", "max drift", "final drift");
+	for (const TestSystem& system : hamiltonian_systems) {
+		EvalContext context;
+		if (!context.compile(system.dx, system.dy) || !context.has_program() || !context.separable()) {
+			std::printf("%-10s not a separable lowered system: %s%s\n", system.name, context.error().c_str(), context.lowering_error().c_str());
+			continue;
+		}
+
+		for (int k = 0; k < 2; k++)
+		for (int m = 0; m < 5; m++) {
+			const double h = step_sizes[k];
+			SystemEval<double> f(context);
+			SystemEval<double> energy_f(context);
+			EnergyMonitor energy;
+			double x = 1.0;
+			double y = 0.0;
+			energy.start(energy_f, 0.0, x, y);
+
+			double seconds = 0.0;
+			for (long long done = 0; done < steps; done += sample_every) {
+				auto start = std::chrono::steady_clock::now();
+				integrate_fixed(methods[m], f, h * done, x, y, h, sample_every);
+				seconds += seconds_since(start);
+				energy.sample(energy_f, h * (done + sample_every), x, y);
+			}
+			double final_drift = std::fabs(separable_energy(energy_f, h * steps, x, y) - energy.initial) / std::fabs(energy.initial);
+			std::printf("%-10s %5.2f %-9s %10llu %9.3f %14.3g %14.3g\n", system.name, h, method_names[m], f.evaluations, seconds,
+				energy.relative(), final_drift);
+		}
+	}
+}
+
+//the same tableaux as data in heap arrays, the loops a hand written runtime engine would run
+struct RuntimeTableau {
+	int stages;
+	std::vector<double> c, a, b;
+};
+
+template <typename Tableau>
+static RuntimeTableau runtime_tableau() {
+	RuntimeTableau tableau;
+	tableau.stages = Tableau::stages;
+	for (int i = 0; i < Tableau::stages; i++) {
+		tableau.c.push_back(Tableau::c(i));
+		tableau.b.push_back(Tableau::b(i));
+		for (int j = 0; j < Tableau::stages; j++)
+			tableau.a.push_back(Tableau::a(i, j));
+	}
+	return tableau;
+}
+
+template <typename T, typename F>
+static void runtime_step(const RuntimeTableau& tableau, F& f, T t, T& x, T& y, T h) {
+	T kx[16], ky[16];
+	const int s = tableau.stages;
+	for (int i = 0; i < s; i++) {
+		T sx = T(0);
+		T sy = T(0);
+		for (int j = 0; j < i; j++) {
+			sx += T(tableau.a[i * s + j]) * kx[j];
+			sy += T(tableau.a[i * s + j]) * ky[j];
+		}
+		f(t + T(tableau.c[i]) * h, x + h * sx, y + h * sy, kx[i], ky[i]);
+	}
+	T sx = T(0);
+	T sy = T(0);
+	for (int i = 0; i < s; i++) {
+		sx += T(tableau.b[i]) * kx[i];
+		sy += T(tableau.b[i]) * ky[i];
+	}
+	x += h * sx;
+	y += h * sy;
+}
+
+//the linear test system as plain C++, so the step overhead is not hidden behind the interpreter
+struct InlineLinear {
+	void operator()(double, double x, double y, double& dx, double& dy) const {
+		dx = -0.1 * x - y;
+		dy = x - 0.1 * y;
+	}
+};
+
+//ns per step of the compile-time tableau against the runtime one, final states should agree to rounding
+template <typename Tableau, typename F>
+static void tableau_row(const char* name, const char* field, F& f, long long steps) {
+	const double h = 1e-3;
+	RuntimeTableau tableau = runtime_tableau<Tableau>();
+
+	double x = 1.0, y = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	for (long long i = 0; i < steps; i++)
+		tableau_step<Tableau>(f, h * i, x, y, h);
+	double unrolled = seconds_since(start);
+
+	double rx = 1.0, ry = 0.0;
+	start = std::chrono::steady_clock::now();
+	for (long long i = 0; i < steps; i++)
+		runtime_step(tableau, f, h * i, rx, ry, h);
+	double runtime = seconds_since(start);
+
+	std::printf("%-10s %-9s %12.1f %12.1f %9.2fx %12.3g\n", name, field, unrolled / steps * 1e9, runtime / steps * 1e9,
+		runtime / unrolled, std::fmax(std::fabs(x - rx), std::fabs(y - ry)));
+}
+
+template <typename Tableau>
+static void tableau_rows(const char* name, EvalContext& context) {
+	InlineLinear inline_f;
+	SystemEval<double> bytecode_f(context);
+	tableau_row<Tableau>(name, "inline", inline_f, 2000000);
+	tableau_row<Tableau>(name, "bytecode", bytecode_f, 200000);
+}
+
+static void bench_tableau() {
+	EvalContext context;
+	if (!context.compile(test_systems[0].dx, test_systems[0].dy) || !context.has_program()) {
+		std::printf("linear system failed to lower: %s%s\n", context.error().c_str(), context.lowering_error().c_str());
+		return;
+	}
+
+	std::printf("%-10s %-9s %12s %12s %10s %12s\n", "tableau", "f", "template ns", "runtime ns", "speedup", "difference");
+	tableau_rows<EulerTableau>("euler", context);
+	tableau_rows<HeunTableau>("heun", context);
+	tableau_rows<Rk4Tableau>("rk4", context);
+	tableau_rows<DormandPrinceTableau>("dopri45", context);
+	tableau_rows<Tsit5Tableau>("tsit5", context);
+	tableau_rows<Verner65Tableau>("verner65", context);
+}
+
+struct BenchmarkEntry {
+	const char* name;
+	void (*run)();
+};
+
+static const BenchmarkEntry benchmarks[] = {
+	{ "bytecode", bench_bytecode },
+	{ "batch", bench_batch },
+	{ "native", bench_native },
+	{ "precision", bench_precision },
+	{ "jacobian", bench_jacobian },
+	{ "cse", bench_cse },
+	{ "accuracy", bench_accuracy },
+	{ "adaptive", bench_adaptive },
+	{ "multistep", bench_multistep },
+	{ "workprecision", bench_work_precision },
+	{ "taylor", bench_taylor },
+	{ "ensemble", bench_ensemble },
+	{ "clone", bench_clone },
+	{ "events", bench_events },
+	{ "incremental", bench_incremental },
+	{ "frames", bench_frames },
+	{ "stiff", bench_stiff },
+	{ "switching", bench_switching },
+	{ "symplectic", bench_symplectic },
+	{ "tableau", bench_tableau },
+};
+
+int run_benchmarks(const std::string& filter) {
+	int ran = 0;
+	for (const BenchmarkEntry& entry : benchmarks) {
+		if (!filter.empty() && std::string(entry.name).find(filter) == std::string::npos)
+			continue;
+		std::printf("== %s\n", entry.name);
+		entry.run();
+		ran++;
+	}
+	if (ran == 0)
+		std::printf("no benchmark matches '%s'\n", filter.c_str());
+	return ran == 0 ? 1 : 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include <string>
+
+//runs every benchmark whose name contains filter (all of them when empty) and prints the results,
+//started with "Diff_Equ --bench [filter]"
+int run_benchmarks(const std::string& filter);
@@ -0,0 +1,358 @@
+#pragma once
+#include <cmath>
+#include <utility>
+
+#include "Adaptive.h"
+
+//Bulirsch-Stoer: Gragg's modified midpoint rule over one big step with n = 2, 6, 10, ... substeps,
+//Aitken-Neville extrapolated to zero substep size in h^2. column k of the table is order 2k + 2 and
+//its difference to column k - 1 is the error estimate. the column and step are picked like Hairer's
+//ODEX, by the work per unit step each column would need, with convergence only looked for around
+//the target column. cheap at tight tolerances on smooth problems, poor on stiff or rough ones.
+//dense output is ODEX's: with n = 4k + 2 the middle of every row is an odd substep, so the midpoint rule's
+//value there and central differences of its derivatives around it extrapolate in h^2 like the step does.
+//the derivatives at the middle plus both ends make a polynomial of degree 2k + 3 for column k, at no
+//extra evaluations. it is fitted on the first dense() call of a step, so stepping alone does not pay for it
+template <typename T, typename F>
+class BulirschStoer {
+public:
+	static const int columns = 8;
+
+	BulirschStoer(F& f, Tolerance tolerance) : f(f), tolerance(tolerance) {
+		cost[0] = 1 + substeps(0);
+		for (int k = 1; k < columns; k++)
+			cost[k] = cost[k - 1] + substeps(k);
+		//looser tolerances start on a lower column
+		double digits = -std::log10(tolerance.relative + tolerance.absolute);
+		target = (int)(digits * 0.6 + 1.5);
+		target = target < 2 ? 2 : (target > columns - 2 ? columns - 2 : target);
+	}
+
+	//first_step 0 picks one from the local derivative scale
+	void start(T t0, T x0, T y0, T first_step = T(0)) {
+		t = previous_t = t0;
+		x = x0;
+		y = y0;
+		last_h = T(0);
+		stats = StepStats();
+		rejected_last = false;
+		eval(t, x, y, dx0, dy0);
+		h = first_step > T(0) ? first_step : initial_step(f, tolerance, 2 * target + 1, t, x, y, dx0, dy0, stats);
+	}
+
+	//one accepted step that never passes t_stop. false once t_stop is reached,
+	//or when the step size underflows or the solution stops being finite
+	bool step(T t_stop) {
+		if (!(t < t_stop))
+			return false;
+
+		while (true) {
+			T step_h = h;
+			bool last = false;
+			if (t + step_h >= t_stop) {
+				step_h = t_stop - t;
+				last = true;
+			}
+			if (!(step_h > T(0)) || (double)step_h <= std::fabs((double)t) * 1e-15)
+				return false;
+
+			int accepted_column = -1;
+			int reject_column = -1;
+			for (int k = 0; k <= target + 1 && k < columns; k++) {
+				midpoint(step_h, k, table_x[k][0], table_y[k][0]);
+				extrapolate(k);
+				if (k == 0)
+					continue;
+
+				error[k] = error_norm(tolerance, table_x[k][k] - table_x[k][k - 1], table_y[k][k] - table_y[k][k - 1],
+					x, y, table_x[k][k], table_y[k][k]);
+				optimal_step(k, step_h);
+				if (k < target - 1)
+					continue;
+
+				if (error[k] <= 1.0) {
+					accepted_column = k;
+					break;
+				}
+				//give up early when even the next columns cannot be expected to converge
+				double ratio = (double)substeps(k + 1) / substeps(0);
+				if (!std::isfinite(error[k]) || k == target + 1 || k == columns - 1
+					|| (k == target - 1 && error[k] > ratio * ratio * ratio * ratio)
+					|| (k == target && error[k] > ratio * ratio)) {
+					reject_column = k;
+					break;
+				}
+			}
+
+			if (accepted_column < 0) {
+				if (reject_column < 0)
+					reject_column = target + 1 < columns ? target + 1 : columns - 1;
+				int k = reject_column < target ? reject_column : target;
+				target = k < 2 ? 2 : k;
+				h = std::isfinite(error[reject_column]) ? optimal_h[k] : step_h * T(0.25);
+				if (!(h < step_h))
+					h = step_h * T(0.5);
+				rejected_last = true;
+				stats.rejected++;
+				continue;
+			}
+
+			int k = accepted_column;
+			T x1 = table_x[k][k];
+			T y1 = table_y[k][k];
+			px = x;
+			py = y;
+			pdx = dx0;
+			pdy = dy0;
+			previous_t = t;
+			t = last ? t_stop : t + step_h;
+			x = x1;
+			y = y1;
+			last_h = step_h;
+			eval(t, x, y, dx0, dy0);
+			dense_column = k;
+			dense_fitted = false;
+			stats.accepted++;
+			if (!last)
+				choose_next(k, step_h);
+			rejected_last = false;
+			return true;
+		}
+	}
+
+	//state anywhere inside the last accepted step [previous_t, t]
+	void dense(T time, T& out_x, T& out_y) const {
+		if (!(last_h > T(0))) {
+			out_x = x;
+			out_y = y;
+			return;
+		}
+		if (!dense_fitted)
+			fit_dense();
+		T theta = (time - previous_t) / last_h - T(0.5);
+		out_x = dense_x[dense_degree];
+		out_y = dense_y[dense_degree];
+		for (int i = dense_degree - 1; i >= 0; i--) {
+			out_x = out_x * theta + dense_x[i];
+			out_y = out_y * theta + dense_y[i];
+		}
+	}
+
+	T t = T(0);
+	T x = T(0);
+	T y = T(0);
+	T previous_t = T(0);
+	T h = T(0);                 //next step size to try
+	int target = 3;             //column convergence is expected at
+	StepStats stats;
+
+private:
+	static const int max_substeps = 4 * columns - 2;
+
+	static int substeps(int k) { return 4 * k + 2; }
+
+	void eval(T time, T ex, T ey, T& dx, T& dy) {
+		stats.evaluations++;
+		f(time, ex, ey, dx, dy);
+	}
+
+	//Gragg's modified midpoint with row k's substeps over H, smoothed at the end so the error expands in h^2.
+	//keeps the unsmoothed middle value and the derivative at every substep for the dense output
+	void midpoint(T H, int k, T& out_x, T& out_y) {
+		int n = substeps(k);
+		T s = H / T(n);
+		T x0 = x, y0 = y;
+		T x1 = x + s * dx0;
+		T y1 = y + s * dy0;
+		T dx, dy;
+		slope_x[k][0] = dx0;
+		slope_y[k][0] = dy0;
+		for (int m = 1; m < n; m++) {
+			if (m == n / 2) {
+				middle_x[k] = x1;
+				middle_y[k] = y1;
+			}
+			eval(t + s * T(m), x1, y1, dx, dy);
+			slope_x[k][m] = dx;
+			slope_y[k][m] = dy;
+			T x2 = x0 + T(2) * s * dx;
+			T y2 = y0 + T(2) * s * dy;
+			x0 = x1; y0 = y1;
+			x1 = x2; y1 = y2;
+		}
+		eval(t + H, x1, y1, dx, dy);
+		slope_x[k][n] = dx;
+		slope_y[k][n] = dy;
+		out_x = T(0.5) * (x0 + x1 + s * dx);
+		out_y = T(0.5) * (y0 + y1 + s * dy);
+	}
+
+	//fills row k of the Aitken-Neville table from its first entry
+	void extrapolate(int k) {
+		for (int j = 1; j <= k; j++) {
+			double ratio = (double)substeps(k) / substeps(k - j);
+			T factor = T(1) / T(ratio * ratio - 1.0);
+			table_x[k][j] = table_x[k][j - 1] + (table_x[k][j - 1] - table_x[k - 1][j - 1]) * factor;
+			table_y[k][j] = table_y[k][j - 1] + (table_y[k][j - 1] - table_y[k - 1][j - 1]) * factor;
+		}
+	}
+
+	//Aitken-Neville over rows first..last of per-row estimates, in place, the limit ends up in values[last]
+	static void extrapolate_rows(T* values, int first, int last) {
+		for (int j = 1; j <= last - first; j++) {
+			for (int i = last; i >= first + j; i--) {
+				double ratio = (double)substeps(i) / substeps(i - j);
+				values[i] = values[i] + (values[i] - values[i - 1]) * T(1.0 / (ratio * ratio - 1.0));
+			}
+		}
+	}
+
+	//for the step accepted on column k: the Taylor coefficients H^i u^(i) / i! at the middle of the step for
+	//i = 0..2k - 1, extrapolated from the rows that reach far enough for each, then the four terms of
+	//degree 2k..2k + 3 that match both ends' values and slopes. in theta = s - 1/2
+	void fit_dense() const {
+		int k = dense_column;
+		int mu = 2 * k - 1;
+		dense_degree = mu + 4;
+		T ex[columns], ey[columns];
+		for (int j = 0; j <= k; j++) {
+			ex[j] = middle_x[j];
+			ey[j] = middle_y[j];
+		}
+		extrapolate_rows(ex, 0, k);
+		extrapolate_rows(ey, 0, k);
+		dense_x[0] = ex[k];
+		dense_y[0] = ey[k];
+
+		//derivative i from the central difference of order d = i - 1 of the substep slopes, spaced two
+		//substeps apart so every point keeps the middle's parity
+		double factorial = 1.0;
+		for (int i = 1; i <= mu; i++) {
+			factorial *= i;
+			int d = i - 1;
+			int first = d / 2;
+			for (int j = first; j <= k; j++) {
+				int n = substeps(j);
+				T sx = T(0), sy = T(0);
+				double binomial = 1.0;
+				for (int l = 0; l <= d; l++) {
+					int at = n / 2 + d - 2 * l;
+					double w = (l & 1) ? -binomial : binomial;
+					sx = sx + slope_x[j][at] * T(w);
+					sy = sy + slope_y[j][at] * T(w);
+					binomial = binomial * (d - l) / (l + 1);
+				}
+				double scale = std::pow(n * 0.5, d) / factorial;
+				ex[j] = last_h * sx * T(scale);
+				ey[j] = last_h * sy * T(scale);
+			}
+			extrapolate_rows(ex, first, k);
+			extrapolate_rows(ey, first, k);
+			dense_x[i] = ex[k];
+			dense_y[i] = ey[k];
+		}
+
+		//what the middle's series misses at theta = -1/2 and 1/2, in value and in slope per unit theta
+		T rx[4], ry[4];
+		T ends_x[2] = { px, x }, ends_y[2] = { py, y };
+		T ends_dx[2] = { last_h * pdx, last_h * dx0 }, ends_dy[2] = { last_h * pdy, last_h * dy0 };
+		double matrix[4][4];
+		for (int e = 0; e < 2; e++) {
+			double theta = e ? 0.5 : -0.5;
+			T vx = T(0), vy = T(0), sx = T(0), sy = T(0);
+			for (int i = mu; i >= 0; i--) {
+				sx = sx * T(theta) + vx;
+				sy = sy * T(theta) + vy;
+				vx = vx * T(theta) + dense_x[i];
+				vy = vy * T(theta) + dense_y[i];
+			}
+			rx[e] = ends_x[e] - vx;
+			ry[e] = ends_y[e] - vy;
+			rx[2 + e] = ends_dx[e] - sx;
+			ry[2 + e] = ends_dy[e] - sy;
+			for (int c = 0; c < 4; c++) {
+				int p = mu + 1 + c;
+				matrix[e][c] = std::pow(theta, p);
+				matrix[2 + e][c] = p * std::pow(theta, p - 1);
+			}
+		}
+		solve4(matrix, rx, ry);
+		for (int c = 0; c < 4; c++) {
+			dense_x[mu + 1 + c] = rx[c];
+			dense_y[mu + 1 + c] = ry[c];
+		}
+	}
+
+	//Gaussian elimination with partial pivoting on both right hand sides, solutions replace them
+	static void solve4(double a[4][4], T* bx, T* by) {
+		for (int c = 0; c < 4; c++) {
+			int pivot = c;
+			for (int r = c + 1; r < 4; r++)
+				if (std::fabs(a[r][c]) > std::fabs(a[pivot][c]))
+					pivot = r;
+			for (int j = 0; j < 4; j++)
+				std::swap(a[c][j], a[pivot][j]);
+			std::swap(bx[c], bx[pivot]);
+			std::swap(by[c], by[pivot]);
+			for (int r = c + 1; r < 4; r++) {
+				double m = a[r][c] / a[c][c];
+				for (int j = c; j < 4; j++)
+					a[r][j] -= m * a[c][j];
+				bx[r] = bx[r] - bx[c] * T(m);
+				by[r] = by[r] - by[c] * T(m);
+			}
+		}
+		for (int c = 3; c >= 0; c--) {
+			for (int j = c + 1; j < 4; j++) {
+				bx[c] = bx[c] - bx[j] * T(a[c][j]);
+				by[c] = by[c] - by[j] * T(a[c][j]);
+			}
+			bx[c] = bx[c] / T(a[c][c]);
+			by[c] = by[c] / T(a[c][c]);
+		}
+	}
+
+	//step that would bring column k's error to the safety target, and the evaluations per unit time it implies
+	void optimal_step(int k, T H) {
+		double exponent = 1.0 / (2 * k + 1);
+		double fac = error[k] > 0.0 ? 0.94 * std::pow(0.65 / error[k], exponent) : 4.0;
+		fac = !std::isfinite(fac) ? 0.02 : (fac < 0.02 ? 0.02 : (fac > 4.0 ? 4.0 : fac));
+		optimal_h[k] = H * T(fac);
+		work[k] = cost[k] / (double)optimal_h[k];
+	}
+
+	//next column and step, moving the target one down or up when that column is cheaper per unit time
+	void choose_next(int k, T H) {
+		int next = k;
+		if (k >= 2 && work[k - 1] < 0.8 * work[k])
+			next = k - 1;
+		else if (k + 1 < columns - 1 && work[k] < 0.9 * work[k - 1] && !rejected_last)
+			next = k + 1;
+
+		if (next == k + 1)
+			h = optimal_h[k] * T((double)cost[k + 1] / cost[k]);
+		else
+			h = optimal_h[next];
+		if (rejected_last && h > H)
+			h = H;
+		target = next < 2 ? 2 : next;
+	}
+
+	F& f;
+	Tolerance tolerance;
+	T table_x[columns][columns], table_y[columns][columns];
+	double error[columns] = {};
+	T optimal_h[columns];
+	double work[columns] = {};
+	int cost[columns];
+	bool rejected_last = false;
+	T dx0 = T(0), dy0 = T(0);   //derivative at (t, x, y), shared by every midpoint sequence
+	T px = T(0), py = T(0), pdx = T(0), pdy = T(0);
+	T last_h = T(0);
+	T middle_x[columns], middle_y[columns];                     //each row's unsmoothed value halfway
+	T slope_x[columns][max_substeps + 1], slope_y[columns][max_substeps + 1];
+	int dense_column = 0;
+	mutable T dense_x[2 * columns + 4], dense_y[2 * columns + 4];        //last step's polynomial in theta
+	mutable int dense_degree = 0;
+	mutable bool dense_fitted = false;
+};
@@ -0,0 +1,307 @@
+#pragma once
+#include <cmath>
+#include <type_traits>
+
+#include "Adaptive.h"
+
+//explicit Runge-Kutta methods as compile-time Butcher tableaux. a tableau is a struct with
+//	enum { stages, order, embedded_order (0 without an error estimate), fsal };
+//	static constexpr double c(int i), a(int i, int j), b(int i), e(int i)
+//where e = b - embedded b. every coefficient is a constant expression, so tableau_step unrolls
+//the stage loops at compile time, folds the coefficients in and drops the zero ones.
+//coefficients are doubles: wider scalar types get them rounded to double
+
+struct EulerTableau {
+	enum { stages = 1, order = 1, embedded_order = 0, fsal = 0 };
+	static constexpr double c(int) { return 0.0; }
+	static constexpr double a(int, int) { return 0.0; }
+	static constexpr double b(int) { return 1.0; }
+	static constexpr double e(int) { return 0.0; }
+};
+
+struct HeunTableau {
+	enum { stages = 2, order = 2, embedded_order = 1, fsal = 0 };
+	static constexpr double c(int i) { return i == 1 ? 1.0 : 0.0; }
+	static constexpr double a(int i, int j) { return i == 1 && j == 0 ? 1.0 : 0.0; }
+	static constexpr double b(int) { return 0.5; }
+	//euler is the embedded first order method
+	static constexpr double e(int i) { return i == 0 ? -0.5 : 0.5; }
+};
+
+struct Rk4Tableau {
+	enum { stages = 4, order = 4, embedded_order = 0, fsal = 0 };
+	static constexpr double c(int i) {
+		const double table[4] = { 0.0, 0.5, 0.5, 1.0 };
+		return table[i];
+	}
+	static constexpr double a(int i, int j) {
+		return j == i - 1 ? (i == 3 ? 1.0 : 0.5) : 0.0;
+	}
+	static constexpr double b(int i) {
+		const double table[4] = { 1.0 / 6.0, 1.0 / 3.0, 1.0 / 3.0, 1.0 / 6.0 };
+		return table[i];
+	}
+	static constexpr double e(int) { return 0.0; }
+};
+
+//the same Dormand-Prince 5(4) pair as DormandPrince.h
+struct DormandPrinceTableau {
+	enum { stages = 7, order = 5, embedded_order = 4, fsal = 1 };
+	static constexpr double c(int i) {
+		const double table[7] = { 0.0, 1.0 / 5.0, 3.0 / 10.0, 4.0 / 5.0, 8.0 / 9.0, 1.0, 1.0 };
+		return table[i];
+	}
+	static constexpr double a(int i, int j) {
+		const double table[7][6] = {
+			{ 0.0 },
+			{ 1.0 / 5.0 },
+			{ 3.0 / 40.0, 9.0 / 40.0 },
+			{ 44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0 },
+			{ 19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0 },
+			{ 9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0 },
+			{ 35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0 },
+		};
+		return j < i ? table[i][j] : 0.0;
+	}
+	static constexpr double b(int i) { return i < 6 ? a(6, i) : 0.0; }
+	static constexpr double e(int i) {
+		const double table[7] = { 71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0, -17253.0 / 339200.0, 22.0 / 525.0, -1.0 / 40.0 };
+		return table[i];
+	}
+};
+
+//Tsitouras 5(4), 2011. tuned for a smaller fifth order error constant than dormand-prince at the same cost
+struct Tsit5Tableau {
+	enum { stages = 7, order = 5, embedded_order = 4, fsal = 1 };
+	static constexpr double c(int i) {
+		const double table[7] = { 0.0, 0.161, 0.327, 0.9, 0.9800255409045097, 1.0, 1.0 };
+		return table[i];
+	}
+	static constexpr double a(int i, int j) {
+		const double table[7][6] = {
+			{ 0.0 },
+			{ 0.161 },
+			{ -0.008480655492356989, 0.335480655492357 },
+			{ 2.897153057105493, -6.359448489975075, 4.3622954328695815 },
+			{ 5.325864828439257, -11.748883564062828, 7.4955393428898365, -0.09249506636175525 },
+			{ 5.86145544294642, -12.92096931784711, 8.159367898576159, -0.071584973281401, -0.028269050394068383 },
+			{ 0.09646076681806523, 0.01, 0.4798896504144996, 1.379008574103742, -3.290069515436081, 2.324710524099774 },
+		};
+		return j < i ? table[i][j] : 0.0;
+	}
+	static constexpr double b(int i) { return i < 6 ? a(6, i) : 0.0; }
+	static constexpr double e(int i) {
+		const double table[7] = { -0.00178001105222577714, -0.0008164344596567469, 0.007880878010261995,
+			-0.1447110071732629, 0.5823571654525552, -0.45808210592918697, 1.0 / 66.0 };
+		return table[i];
+	}
+};
+
+//Verner's 6(5) pair from 1978 (the one in DVERK), sixth order with a fifth order estimate
+struct Verner65Tableau {
+	enum { stages = 8, order = 6, embedded_order = 5, fsal = 0 };
+	static constexpr double c(int i) {
+		const double table[8] = { 0.0, 1.0 / 6.0, 4.0 / 15.0, 2.0 / 3.0, 5.0 / 6.0, 1.0, 1.0 / 15.0, 1.0 };
+		return table[i];
+	}
+	static constexpr double a(int i, int j) {
+		const double table[8][7] = {
+			{ 0.0 },
+			{ 1.0 / 6.0 },
+			{ 4.0 / 75.0, 16.0 / 75.0 },
+			{ 5.0 / 6.0, -8.0 / 3.0, 5.0 / 2.0 },
+			{ -165.0 / 64.0, 55.0 / 6.0, -425.0 / 64.0, 85.0 / 96.0 },
+			{ 12.0 / 5.0, -8.0, 4015.0 / 612.0, -11.0 / 36.0, 88.0 / 255.0 },
+			{ -8263.0 / 15000.0, 124.0 / 75.0, -643.0 / 680.0, -81.0 / 250.0, 2484.0 / 10625.0, 0.0 },
+			{ 3501.0 / 1720.0, -300.0 / 43.0, 297275.0 / 52632.0, -319.0 / 2322.0, 24068.0 / 84065.0, 0.0, 3850.0 / 26703.0 },
+		};
+		return j < i ? table[i][j] : 0.0;
+	}
+	static constexpr double b(int i) {
+		const double table[8] = { 3.0 / 40.0, 0.0, 875.0 / 2244.0, 23.0 / 72.0, 264.0 / 1955.0, 0.0, 125.0 / 11592.0, 43.0 / 616.0 };
+		return table[i];
+	}
+	static constexpr double e(int i) {
+		const double embedded[8] = { 13.0 / 160.0, 0.0, 2375.0 / 5984.0, 5.0 / 16.0, 12.0 / 85.0, 3.0 / 44.0, 0.0, 0.0 };
+		return b(i) - embedded[i];
+	}
+};
+
+//calls body(std::integral_constant<int, i>) for i in [Begin, End), expanded at compile time
+template <int Begin, int End>
+struct Unroll {
+	template <typename Body>
+	static void run(const Body& body) {
+		body(std::integral_constant<int, Begin>());
+		Unroll<Begin + 1, End>::run(body);
+	}
+};
+
+template <int End>
+struct Unroll<End, End> {
+	template <typename Body>
+	static void run(const Body&) {}
+};
+
+//stage derivatives of one step into kx, ky. First = 1 takes kx[0], ky[0] as already known (first same as last)
+template <typename Tableau, int First, typename T, typename F>
+inline void tableau_stages(F& f, T t, T x, T y, T h, T* kx, T* ky) {
+	Unroll<First, Tableau::stages>::run([&](auto stage) {
+		constexpr int i = decltype(stage)::value;
+		T sx = T(0);
+		T sy = T(0);
+		Unroll<0, i>::run([&](auto column) {
+			constexpr int j = decltype(column)::value;
+			constexpr double a = Tableau::a(i, j);
+			if (a != 0.0) {
+				sx += T(a) * kx[j];
+				sy += T(a) * ky[j];
+			}
+		});
+		constexpr double c = Tableau::c(i);
+		f(t + T(c) * h, x + h * sx, y + h * sy, kx[i], ky[i]);
+	});
+}
+
+//sum of h w(i) k[i] for a weight function of the tableau, zero weights skipped
+template <typename Tableau, bool Error, typename T>
+inline void tableau_combine(T h, const T* kx, const T* ky, T& out_x, T& out_y) {
+	T sx = T(0);
+	T sy = T(0);
+	Unroll<0, Tableau::stages>::run([&](auto stage) {
+		constexpr int i = decltype(stage)::value;
+		constexpr double w = Error ? Tableau::e(i) : Tableau::b(i);
+		if (w != 0.0) {
+			sx += T(w) * kx[i];
+			sy += T(w) * ky[i];
+		}
+	});
+	out_x = h * sx;
+	out_y = h * sy;
+}
+
+//one fixed step, same shape as the steppers in Integrators.h
+template <typename Tableau, typename T, typename F>
+inline void tableau_step(F& f, T t, T& x, T& y, T h) {
+	T kx[Tableau::stages], ky[Tableau::stages];
+	tableau_stages<Tableau, 0>(f, t, x, y, h, kx, ky);
+	T dx, dy;
+	tableau_combine<Tableau, false>(h, kx, ky, dx, dy);
+	x += dx;
+	y += dy;
+}
+
+//adaptive stepping on any tableau with an embedded pair, with the same interface as DormandPrince.
+//I controller on the embedded order, cubic Hermite dense output from the end point derivatives,
+//which fsal tableaux get for free and the others pay one evaluation for
+template <typename Tableau, typename T, typename F>
+class EmbeddedRk {
+	static_assert(Tableau::embedded_order > 0, "EmbeddedRk needs a tableau with an error estimate");
+
+public:
+	EmbeddedRk(F& f, Tolerance tolerance) : f(f), tolerance(tolerance) {}
+
+	//first_step 0 picks one from the local derivative scale
+	void start(T t0, T x0, T y0, T first_step = T(0)) {
+		t = previous_t = t0;
+		x = x0;
+		y = y0;
+		last_h = T(0);
+		stats = StepStats();
+		eval(t, x, y, kx[0], ky[0]);
+		h = first_step > T(0) ? first_step : initial_step(f, tolerance, Tableau::order, t, x, y, kx[0], ky[0], stats);
+	}
+
+	//one accepted step that never passes t_stop. false once t_stop is reached,
+	//or when the step size underflows or the solution stops being finite
+	bool step(T t_stop) {
+		if (!(t < t_stop))
+			return false;
+
+		const double exponent = 1.0 / (Tableau::embedded_order + 1);
+		while (true) {
+			T step_h = h;
+			bool last = false;
+			if (t + step_h >= t_stop) {
+				step_h = t_stop - t;
+				last = true;
+			}
+			if (!(step_h > T(0)) || (double)step_h <= std::fabs((double)t) * 1e-15)
+				return false;
+
+			stats.evaluations += Tableau::stages - 1;
+			tableau_stages<Tableau, 1>(f, t, x, y, step_h, kx, ky);
+			T dx, dy, ex, ey;
+			tableau_combine<Tableau, false>(step_h, kx, ky, dx, dy);
+			tableau_combine<Tableau, true>(step_h, kx, ky, ex, ey);
+			T x1 = x + dx;
+			T y1 = y + dy;
+
+			double error = error_norm(tolerance, ex, ey, x, y, x1, y1);
+			if (!std::isfinite(error) || error > 1.0) {
+				double shrink = std::isfinite(error) ? 0.9 * std::pow(error, -exponent) : 0.2;
+				h = step_h * T(shrink < 0.2 ? 0.2 : shrink);
+				stats.rejected++;
+				continue;
+			}
+
+			px = x;
+			py = y;
+			pdx = kx[0];
+			pdy = ky[0];
+			previous_t = t;
+			t = last ? t_stop : t + step_h;
+			x = x1;
+			y = y1;
+			if (Tableau::fsal) {
+				kx[0] = kx[Tableau::stages - 1];
+				ky[0] = ky[Tableau::stages - 1];
+			} else {
+				eval(t, x, y, kx[0], ky[0]);
+			}
+			last_h = step_h;
+
+			double grow = error > 1e-10 ? 0.9 * std::pow(error, -exponent) : 5.0;
+			h = step_h * T(grow > 5.0 ? 5.0 : grow);
+			stats.accepted++;
+			return true;
+		}
+	}
+
+	//state anywhere inside the last accepted step [previous_t, t]
+	void dense(T time, T& out_x, T& out_y) const {
+		if (!(last_h > T(0))) {
+			out_x = x;
+			out_y = y;
+			return;
+		}
+		T s = (time - previous_t) / last_h;
+		T s2 = s * s;
+		T s3 = s2 * s;
+		T h00 = T(2) * s3 - T(3) * s2 + T(1);
+		T h10 = s3 - T(2) * s2 + s;
+		T h01 = T(3) * s2 - T(2) * s3;
+		T h11 = s3 - s2;
+		out_x = h00 * px + h10 * last_h * pdx + h01 * x + h11 * last_h * kx[0];
+		out_y = h00 * py + h10 * last_h * pdy + h01 * y + h11 * last_h * ky[0];
+	}
+
+	T t = T(0);
+	T x = T(0);
+	T y = T(0);
+	T previous_t = T(0);
+	T h = T(0);                 //next step size to try
+	StepStats stats;
+
+private:
+	void eval(T time, T ex, T ey, T& dx, T& dy) {
+		stats.evaluations++;
+		f(time, ex, ey, dx, dy);
+	}
+
+	F& f;
+	Tolerance tolerance;
+	T kx[Tableau::stages], ky[Tableau::stages];     //kx[0] is the derivative at (t, x, y)
+	T px = T(0), py = T(0), pdx = T(0), pdy = T(0);   //start of the last step and its derivative
+	T last_h = T(0);
+};
@@ -0,0 +1,351 @@
+#include "Bytecode.h"
+
+#include <cmath>
+#include <map>
+
+#include "DoubleDouble.h"
+#include "ExprMath.h"
+
+static_assert((int)OpCode::Select == (int)ExprOp::Select - (int)ExprOp::Neg, "OpCode must mirror ExprOp");
+
+static OpCode to_opcode(ExprOp op) {
+	return (OpCode)((int)op - (int)ExprOp::Neg);
+}
+
+static double fold(ExprOp op, double a, double b, double c) {
+	switch (op) {
+	case ExprOp::Neg: return -a;
+	case ExprOp::Add: return a + b;
+	case ExprOp::Sub: return a - b;
+	case ExprOp::Mul: return a * b;
+	case ExprOp::Div: return a / b;
+	case ExprOp::Mod: return std::fmod(a, b);
+	case ExprOp::Pow: return std::pow(a, b);
+	case ExprOp::Abs: return std::fabs(a);
+	case ExprOp::Sqrt: return std::sqrt(a);
+	case ExprOp::Exp: return std::exp(a);
+	case ExprOp::Log: return std::log(a);
+	case ExprOp::Log2: return std::log2(a);
+	case ExprOp::Log10: return std::log10(a);
+	case ExprOp::Sin: return std::sin(a);
+	case ExprOp::Cos: return std::cos(a);
+	case ExprOp::Tan: return std::tan(a);
+	case ExprOp::Asin: return std::asin(a);
+	case ExprOp::Acos: return std::acos(a);
+	case ExprOp::Atan: return std::atan(a);
+	case ExprOp::Sinh: return std::sinh(a);
+	case ExprOp::Cosh: return std::cosh(a);
+	case ExprOp::Tanh: return std::tanh(a);
+	case ExprOp::Floor: return std::floor(a);
+	case ExprOp::Ceil: return std::ceil(a);
+	case ExprOp::Round: return round_half_away(a);
+	case ExprOp::Trunc: return std::trunc(a);
+	case ExprOp::Sgn: return sign_of(a);
+	case ExprOp::Min: return std::fmin(a, b);
+	case ExprOp::Max: return std::fmax(a, b);
+	case ExprOp::Atan2: return std::atan2(a, b);
+	case ExprOp::Hypot: return std::hypot(a, b);
+	case ExprOp::Lt: return a < b ? 1.0 : 0.0;
+	case ExprOp::Le: return a <= b ? 1.0 : 0.0;
+	case ExprOp::Gt: return a > b ? 1.0 : 0.0;
+	case ExprOp::Ge: return a >= b ? 1.0 : 0.0;
+	case ExprOp::Eq: return nearly_equal((float)a, (float)b) ? 1.0 : 0.0;
+	case ExprOp::Ne: return nearly_equal((float)a, (float)b) ? 0.0 : 1.0;
+	case ExprOp::And: return (a != 0.0 && b != 0.0) ? 1.0 : 0.0;
+	case ExprOp::Or: return (a != 0.0 || b != 0.0) ? 1.0 : 0.0;
+	case ExprOp::Not: return a == 0.0 ? 1.0 : 0.0;
+	case ExprOp::Select: return a != 0.0 ? b : c;
+	default: return 0.0;
+	}
+}
+
+//state for one lowering pass
+struct Lowering {
+	const ExprTree& tree;
+	Program& program;
+	std::vector<int> alias;             //node that actually computes each node after folding
+	std::vector<int> uses;              //readers not yet emitted
+	std::vector<int> reg;               //register holding the node's value, -1 until emitted
+	std::vector<char> folded;           //node reduced to a constant
+	std::vector<double> folded_values;
+	std::vector<unsigned short> free_temps;
+	int temp_base = 0;
+	int next_temp = 0;
+
+	Lowering(const ExprTree& tree, Program& program) : tree(tree), program(program) {}
+
+	const ExprNode& node(int id) const { return tree.nodes[alias[id]]; }
+
+	bool is_const(int id) const { return node(id).op == ExprOp::Const || folded[alias[id]]; }
+	double const_value(int id) const { return folded[alias[id]] ? folded_values[alias[id]] : node(id).value; }
+
+	unsigned short allocate() {
+		if (!free_temps.empty()) {
+			unsigned short r = free_temps.back();
+			free_temps.pop_back();
+			return r;
+		}
+		return (unsigned short)(temp_base + next_temp++);
+	}
+
+	void release(int id) {
+		id = alias[id];
+		if (--uses[id] == 0 && reg[id] >= temp_base)
+			free_temps.push_back((unsigned short)reg[id]);
+	}
+
+	void count_uses(int id) {
+		id = alias[id];
+		if (uses[id]++ > 0 || folded[id])
+			return;
+		const ExprNode& n = tree.nodes[id];
+		if (n.a >= 0) count_uses(n.a);
+		if (n.b >= 0) count_uses(n.b);
+		if (n.c >= 0) count_uses(n.c);
+	}
+
+	//a product only read here can be folded into the add/sub that consumes it
+	bool fusable_mul(int id) const {
+		int real = alias[id];
+		return tree.nodes[real].op == ExprOp::Mul && uses[real] == 1 && reg[real] < 0;
+	}
+
+	unsigned short emit(int id) {
+		id = alias[id];
+		if (reg[id] >= 0)
+			return (unsigned short)reg[id];
+
+		const ExprNode& n = tree.nodes[id];
+		Instr in = {};
+
+		if ((n.op == ExprOp::Add || n.op == ExprOp::Sub) && (fusable_mul(n.a) || (fusable_mul(n.b)))) {
+			bool left = fusable_mul(n.a);
+			const ExprNode& mul = node(left ? n.a : n.b);
+			int other = left ? n.b : n.a;
+			in.op = n.op == ExprOp::Add ? OpCode::MulAdd : (left ? OpCode::MulSub : OpCode::NMulAdd);
+			in.a = emit(mul.a);
+			in.b = emit(mul.b);
+			in.c = emit(other);
+			release(mul.a);
+			release(mul.b);
+			release(other);
+			program.fused++;
+		}
+		else if (n.op == ExprOp::Mul && alias[n.a] == alias[n.b]) {
+			in.op = OpCode::Sqr;
+			in.a = emit(n.a);
+			release(n.a);
+			release(n.b);
+		}
+		else if (n.op == ExprOp::Pow && is_const(n.b) && const_value(n.b) == 2.0) {
+			in.op = OpCode::Sqr;
+			in.a = emit(n.a);
+			release(n.a);
+			release(n.b);
+		}
+		else if (n.op == ExprOp::Pow && is_const(n.b) && const_value(n.b) == 0.5) {
+			in.op = OpCode::Sqrt;
+			in.a = emit(n.a);
+			release(n.a);
+			release(n.b);
+		}
+		else {
+			in.op = to_opcode(n.op);
+			int children[3] = { n.a, n.b, n.c };
+			unsigned short* operands[3] = { &in.a, &in.b, &in.c };
+			for (int i = 0; i < 3; i++) {
+				if (children[i] >= 0)
+					*operands[i] = emit(children[i]);
+			}
+			for (int i = 0; i < 3; i++) {
+				if (children[i] >= 0)
+					release(children[i]);
+			}
+		}
+
+		//sources are read before the destination is written, so a freed operand can be the target
+		in.dst = allocate();
+		program.code.push_back(in);
+		reg[id] = in.dst;
+		return in.dst;
+	}
+};
+
+bool Program::lower(const ExprTree& tree, const std::vector<int>& roots, int inputs) {
+	code.clear();
+	constants.clear();
+	outputs.clear();
+	folded = 0;
+	fused = 0;
+	num_inputs = inputs;
+
+	Lowering l(tree, *this);
+	size_t n = tree.nodes.size();
+	l.alias.resize(n);
+	l.uses.assign(n, 0);
+	l.reg.assign(n, -1);
+	l.folded.assign(n, 0);
+	l.folded_values.assign(n, 0.0);
+
+	//children precede parents, so one forward pass folds constants all the way up
+	for (size_t i = 0; i < n; i++) {
+		const ExprNode& node = tree.nodes[i];
+		l.alias[i] = (int)i;
+		if (node.op == ExprOp::Const || node.op == ExprOp::Var)
+			continue;
+
+		bool all_const = true;
+		double args[3] = { 0.0, 0.0, 0.0 };
+		int children[3] = { node.a, node.b, node.c };
+		for (int k = 0; k < 3; k++) {
+			if (children[k] < 0)
+				continue;
+			if (l.is_const(children[k]))
+				args[k] = l.const_value(children[k]);
+			else
+				all_const = false;
+		}
+
+		//a constant condition picks its branch outright
+		if (node.op == ExprOp::Select && !all_const) {
+			if (l.is_const(node.a)) {
+				l.alias[i] = l.alias[l.const_value(node.a) != 0.0 ? node.b : node.c];
+				folded++;
+			}
+			continue;
+		}
+
+		if (all_const) {
+			l.folded_values[i] = fold(node.op, args[0], args[1], args[2]);
+			l.folded[i] = 1;
+			folded++;
+		}
+	}
+
+	//the constant pool, one register per distinct value
+	for (int root : roots)
+		l.count_uses(root);
+
+	std::map<double, unsigned short> pool;
+	for (size_t i = 0; i < n; i++) {
+		if (l.uses[i] == 0)
+			continue;
+		if (!l.is_const((int)i) || l.alias[i] != (int)i)
+			continue;
+		double value = l.const_value((int)i);
+		auto found = pool.find(value);
+		if (found == pool.end() || std::isnan(value)) {
+			unsigned short r = (unsigned short)(num_inputs + constants.size());
+			constants.push_back(value);
+			if (!std::isnan(value))
+				pool[value] = r;
+			l.reg[i] = r;
+		}
+		else {
+			l.reg[i] = found->second;
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if (l.uses[i] > 0 && tree.nodes[i].op == ExprOp::Var) {
+			if (tree.nodes[i].slot >= num_inputs)
+				return false;
+			l.reg[i] = tree.nodes[i].slot;
+		}
+	}
+
+	l.temp_base = num_inputs + (int)constants.size();
+	for (int root : roots)
+		outputs.push_back(l.emit(root));
+
+	num_registers = l.temp_base + l.next_temp;
+	return num_registers < 65536;
+}
+
+template <typename T>
+void Program::init_registers(T* registers) const {
+	for (size_t i = 0; i < constants.size(); i++)
+		registers[num_inputs + i] = T(constants[i]);
+}
+
+//unqualified math calls so DoubleDouble picks up its own overloads.
+//one state at a time this is no faster than exprtk's value() on the small fields, whatever the loop looks
+//like: registers are already read through a raw pointer, decoding each Instr into locals first compiles to
+//the same loads, and inlining the whole switch into the caller gained nothing measurable. what is left is a
+//store and a reload through r for every instruction plus one indirect jump, the same as exprtk's virtual
+//call per node. the interpreter pays off over lanes (BatchEvaluator) and in precisions exprtk lacks
+//(SystemEval), not as a scalar replacement for exprtk
+template <typename T>
+void Program::run(T* r) const {
+	using namespace std;
+	const Instr* end = code.data() + code.size();
+	for (const Instr* ip = code.data(); ip != end; ++ip) {
+		const Instr& in = *ip;
+		switch (in.op) {
+		case OpCode::Neg: r[in.dst] = -r[in.a]; break;
+		case OpCode::Add: r[in.dst] = r[in.a] + r[in.b]; break;
+		case OpCode::Sub: r[in.dst] = r[in.a] - r[in.b]; break;
+		case OpCode::Mul: r[in.dst] = r[in.a] * r[in.b]; break;
+		case OpCode::Div: r[in.dst] = r[in.a] / r[in.b]; break;
+		case OpCode::Mod: r[in.dst] = fmod(r[in.a], r[in.b]); break;
+		case OpCode::Pow: r[in.dst] = pow(r[in.a], r[in.b]); break;
+		case OpCode::Abs: r[in.dst] = fabs(r[in.a]); break;
+		case OpCode::Sqrt: r[in.dst] = sqrt(r[in.a]); break;
+		case OpCode::Exp: r[in.dst] = exp(r[in.a]); break;
+		case OpCode::Log: r[in.dst] = log(r[in.a]); break;
+		case OpCode::Log2: r[in.dst] = log2(r[in.a]); break;
+		case OpCode::Log10: r[in.dst] = log10(r[in.a]); break;
+		case OpCode::Sin: r[in.dst] = sin(r[in.a]); break;
+		case OpCode::Cos: r[in.dst] = cos(r[in.a]); break;
+		case OpCode::Tan: r[in.dst] = tan(r[in.a]); break;
+		case OpCode::Asin: r[in.dst] = asin(r[in.a]); break;
+		case OpCode::Acos: r[in.dst] = acos(r[in.a]); break;
+		case OpCode::Atan: r[in.dst] = atan(r[in.a]); break;
+		case OpCode::Sinh: r[in.dst] = sinh(r[in.a]); break;
+		case OpCode::Cosh: r[in.dst] = cosh(r[in.a]); break;
+		case OpCode::Tanh: r[in.dst] = tanh(r[in.a]); break;
+		case OpCode::Floor: r[in.dst] = floor(r[in.a]); break;
+		case OpCode::Ceil: r[in.dst] = ceil(r[in.a]); break;
+		case OpCode::Round: r[in.dst] = round_half_away(r[in.a]); break;
+		case OpCode::Trunc: r[in.dst] = trunc(r[in.a]); break;
+		case OpCode::Sgn: r[in.dst] = sign_of(r[in.a]); break;
+		case OpCode::Min: r[in.dst] = fmin(r[in.a], r[in.b]); break;
+		case OpCode::Max: r[in.dst] = fmax(r[in.a], r[in.b]); break;
+		case OpCode::Atan2: r[in.dst] = atan2(r[in.a], r[in.b]); break;
+		case OpCode::Hypot: r[in.dst] = hypot(r[in.a], r[in.b]); break;
+		case OpCode::Lt: r[in.dst] = r[in.a] < r[in.b] ? T(1) : T(0); break;
+		case OpCode::Le: r[in.dst] = r[in.a] <= r[in.b] ? T(1) : T(0); break;
+		case OpCode::Gt: r[in.dst] = r[in.a] > r[in.b] ? T(1) : T(0); break;
+		case OpCode::Ge: r[in.dst] = r[in.a] >= r[in.b] ? T(1) : T(0); break;
+		case OpCode::Eq: r[in.dst] = nearly_equal(r[in.a], r[in.b]) ? T(1) : T(0); break;
+		case OpCode::Ne: r[in.dst] = nearly_equal(r[in.a], r[in.b]) ? T(0) : T(1); break;
+		case OpCode::And: r[in.dst] = (r[in.a] != T(0) && r[in.b] != T(0)) ? T(1) : T(0); break;
+		case OpCode::Or: r[in.dst] = (r[in.a] != T(0) || r[in.b] != T(0)) ? T(1) : T(0); break;
+		case OpCode::Not: r[in.dst] = r[in.a] == T(0) ? T(1) : T(0); break;
+		case OpCode::Select: r[in.dst] = r[in.a] != T(0) ? r[in.b] : r[in.c]; break;
+		case OpCode::MulAdd: r[in.dst] = r[in.a] * r[in.b] + r[in.c]; break;
+		case OpCode::MulSub: r[in.dst] = r[in.a] * r[in.b] - r[in.c]; break;
+		case OpCode::NMulAdd: r[in.dst] = r[in.c] - r[in.a] * r[in.b]; break;
+		case OpCode::Sqr: r[in.dst] = r[in.a] * r[in.a]; break;
+		}
+	}
+}
+
+template <typename T>
+void Program::eval(const T* inputs, T* out, T* registers) const {
+	for (int i = 0; i < num_inputs; i++)
+		registers[i] = inputs[i];
+	run(registers);
+	for (size_t i = 0; i < outputs.size(); i++)
+		out[i] = registers[outputs[i]];
+}
+
+template void Program::init_registers<float>(float*) const;
+template void Program::init_registers<double>(double*) const;
+template void Program::init_registers<DoubleDouble>(DoubleDouble*) const;
+template void Program::run<float>(float*) const;
+template void Program::run<double>(double*) const;
+template void Program::run<DoubleDouble>(DoubleDouble*) const;
+template void Program::eval<float>(const float*, float*, float*) const;
+template void Program::eval<double>(const double*, double*, double*) const;
+template void Program::eval<DoubleDouble>(const DoubleDouble*, DoubleDouble*, DoubleDouble*) const;
@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+
+#include "Expr.h"
+
+//same order as ExprOp from Neg onwards, fused ops go last
+enum class OpCode : unsigned char {
+	Neg, Add, Sub, Mul, Div, Mod, Pow,
+	Abs, Sqrt, Exp, Log, Log2, Log10, Sin, Cos, Tan, Asin, Acos, Atan, Sinh, Cosh, Tanh,
+	Floor, Ceil, Round, Trunc, Sgn,
+	Min, Max, Atan2, Hypot,
+	Lt, Le, Gt, Ge, Eq, Ne, And, Or, Not,
+	Select,
+	MulAdd,     //a * b + c
+	MulSub,     //a * b - c
+	NMulAdd,    //c - a * b
+	Sqr         //a * a
+};
+
+struct Instr {
+	OpCode op;
+	unsigned short dst;
+	unsigned short a;
+	unsigned short b;
+	unsigned short c;
+};
+
+//flat register bytecode lowered from an ExprTree.
+//registers [0, num_inputs) hold the symbols, then the constant pool, then temporaries
+//which are reused as soon as their last reader has run
+class Program {
+public:
+	bool lower(const ExprTree& tree, const std::vector<int>& roots, int num_inputs);
+
+	//writes the constant pool, only needed once per register file.
+	//instantiated for float, double and DoubleDouble
+	template <typename T>
+	void init_registers(T* registers) const;
+	template <typename T>
+	void run(T* registers) const;
+	template <typename T>
+	void eval(const T* inputs, T* out, T* registers) const;
+
+	bool empty() const { return outputs.empty(); }
+
+	int num_inputs = 0;
+	int num_registers = 0;
+	std::vector<Instr> code;
+	std::vector<double> constants;          //constants[i] lives in register num_inputs + i
+	std::vector<unsigned short> outputs;    //register holding each root
+	int folded = 0;                         //nodes removed by constant folding
+	int fused = 0;                          //instructions saved by fusion
+};
@@ -0,0 +1,82 @@
+#include "CompileWorker.h"
+
+#include "EquationCache.h"
+
+CompileWorker::CompileWorker(int debounce_ms) : debounce(debounce_ms) {}
+
+CompileWorker::~CompileWorker() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	if (thread.joinable())
+		thread.join();
+}
+
+void CompileWorker::submit(const std::string& equation_x, const std::string& equation_y, bool native) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending = true;
+		pending_x = equation_x;
+		pending_y = equation_y;
+		pending_native = native;
+		submitted = std::chrono::steady_clock::now();
+		//started on first use so --bench runs never spawn it
+		if (!thread.joinable())
+			thread = std::thread(&CompileWorker::run, this);
+	}
+	wake.notify_all();
+}
+
+bool CompileWorker::poll(CompileResult& result) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!finished)
+		return false;
+	result = std::move(done);
+	finished = false;
+	return true;
+}
+
+bool CompileWorker::busy() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending || compiling;
+}
+
+void CompileWorker::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [this] { return stopping || pending; });
+		if (stopping)
+			return;
+
+		//keep waiting until the text has been still for the whole debounce window
+		auto ready = submitted + debounce;
+		if (std::chrono::steady_clock::now() < ready) {
+			wake.wait_until(lock, ready, [this] { return stopping; });
+			continue;
+		}
+
+		CompileResult result;
+		result.equation_x = pending_x;
+		result.equation_y = pending_y;
+		bool native = pending_native;
+		pending = false;
+		compiling = true;
+
+		//the context is private to this thread until it is handed over in poll()
+		lock.unlock();
+		auto start = std::chrono::steady_clock::now();
+		result.context.reset(new EvalContext());
+		EquationCache::compile(*result.context, result.equation_x, result.equation_y, std::vector<std::string>());
+		if (native && result.context->ok())
+			result.context->compile_native();
+		result.compile_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		lock.lock();
+
+		compiling = false;
+		//an unclaimed older result is superseded
+		done = std::move(result);
+		finished = true;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "EvalContext.h"
+
+struct CompileResult {
+	std::string equation_x;
+	std::string equation_y;
+	std::unique_ptr<EvalContext> context;   //always set, check context->ok()
+	double compile_ms = 0.0;
+};
+
+//compiles equations on a background thread so the render loop never waits on the parser.
+//submissions are debounced: a request only starts once no newer one arrived for debounce_ms,
+//so typing compiles the final text instead of every keystroke. only the newest pending request is kept
+class CompileWorker {
+public:
+	explicit CompileWorker(int debounce_ms = 250);
+	~CompileWorker();
+	CompileWorker(const CompileWorker&) = delete;
+	CompileWorker& operator=(const CompileWorker&) = delete;
+
+	//replaces whatever is pending, native also builds the system with the C compiler
+	void submit(const std::string& equation_x, const std::string& equation_y, bool native);
+	//hands over a finished compile, false when none is ready. never blocks on a running compile
+	bool poll(CompileResult& result);
+	//a request is waiting or being compiled
+	bool busy();
+
+private:
+	void run();
+
+	std::chrono::milliseconds debounce;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	//guarded by mutex
+	bool pending = false;
+	bool compiling = false;
+	std::string pending_x;
+	std::string pending_y;
+	bool pending_native = false;
+	std::chrono::steady_clock::time_point submitted;
+	bool finished = false;
+	CompileResult done;
+};
@@ -0,0 +1,108 @@
+#include "Differentiate.h"
+
+#include <cmath>
+
+Differentiator::Differentiator(ExprBuilder& builder, int slot) : b(builder), slot(slot) {
+	zero = b.constant(0.0);
+	one = b.constant(1.0);
+}
+
+int Differentiator::derive(int node) {
+	if (memo.size() < b.tree.nodes.size())
+		memo.resize(b.tree.nodes.size(), -1);
+	if (memo[node] >= 0)
+		return memo[node];
+
+	//copy, rule() appends to the node vector
+	ExprNode n = b.tree.nodes[node];
+	int result = rule(n, node);
+
+	if (memo.size() < b.tree.nodes.size())
+		memo.resize(b.tree.nodes.size(), -1);
+	memo[node] = result;
+	return result;
+}
+
+int Differentiator::rule(const ExprNode& n, int id) {
+	const ExprOp Add = ExprOp::Add, Sub = ExprOp::Sub, Mul = ExprOp::Mul, Div = ExprOp::Div, Neg = ExprOp::Neg;
+
+	if (n.op == ExprOp::Const)
+		return zero;
+	if (n.op == ExprOp::Var)
+		return n.slot == slot ? one : zero;
+	//the condition only picks a branch
+	if (n.op == ExprOp::Select)
+		return b.make(ExprOp::Select, n.a, derive(n.b), derive(n.c));
+
+	int da = n.a >= 0 ? derive(n.a) : -1;
+	int db = n.b >= 0 ? derive(n.b) : -1;
+	int a = n.a;
+	int bb = n.b;
+
+	//nothing below depends on the variable, skip building chain rule products of zero
+	if (b.is_constant(da, 0.0) && (db < 0 || b.is_constant(db, 0.0)))
+		return zero;
+
+	switch (n.op) {
+	case ExprOp::Neg: return b.make(Neg, da);
+	case ExprOp::Add: return b.make(Add, da, db);
+	case ExprOp::Sub: return b.make(Sub, da, db);
+	case ExprOp::Mul: return b.make(Add, b.make(Mul, da, bb), b.make(Mul, a, db));
+	case ExprOp::Div:
+		//(a/b)' = (a' - (a/b) b') / b
+		return b.make(Div, b.make(Sub, da, b.make(Mul, id, db)), bb);
+	case ExprOp::Mod:
+		//a - trunc(a/b) b
+		return b.make(Sub, da, b.make(Mul, b.make(ExprOp::Trunc, b.make(Div, a, bb)), db));
+	case ExprOp::Pow: {
+		if (b.tree.nodes[bb].op == ExprOp::Const) {
+			double exponent = b.tree.nodes[bb].value;
+			int lowered = b.make(ExprOp::Pow, a, b.constant(exponent - 1.0));
+			return b.make(Mul, b.make(Mul, bb, lowered), da);
+		}
+		//a^b (b' ln a + b a' / a)
+		int log_a = b.make(ExprOp::Log, a);
+		return b.make(Mul, id, b.make(Add, b.make(Mul, db, log_a), b.make(Div, b.make(Mul, bb, da), a)));
+	}
+	case ExprOp::Abs: return b.make(Mul, b.make(ExprOp::Sgn, a), da);
+	case ExprOp::Sqrt: return b.make(Div, da, b.make(Mul, b.constant(2.0), id));
+	case ExprOp::Exp: return b.make(Mul, id, da);
+	case ExprOp::Log: return b.make(Div, da, a);
+	case ExprOp::Log2: return b.make(Div, da, b.make(Mul, b.constant(std::log(2.0)), a));
+	case ExprOp::Log10: return b.make(Div, da, b.make(Mul, b.constant(std::log(10.0)), a));
+	case ExprOp::Sin: return b.make(Mul, b.make(ExprOp::Cos, a), da);
+	case ExprOp::Cos: return b.make(Neg, b.make(Mul, b.make(ExprOp::Sin, a), da));
+	case ExprOp::Tan: return b.make(Mul, b.make(Add, one, b.make(Mul, id, id)), da);
+	case ExprOp::Asin:
+	case ExprOp::Acos: {
+		int root = b.make(ExprOp::Sqrt, b.make(Sub, one, b.make(Mul, a, a)));
+		int d = b.make(Div, da, root);
+		return n.op == ExprOp::Asin ? d : b.make(Neg, d);
+	}
+	case ExprOp::Atan: return b.make(Div, da, b.make(Add, one, b.make(Mul, a, a)));
+	case ExprOp::Sinh: return b.make(Mul, b.make(ExprOp::Cosh, a), da);
+	case ExprOp::Cosh: return b.make(Mul, b.make(ExprOp::Sinh, a), da);
+	case ExprOp::Tanh: return b.make(Mul, b.make(Sub, one, b.make(Mul, id, id)), da);
+	case ExprOp::Min: return b.make(ExprOp::Select, b.make(ExprOp::Le, a, bb), da, db);
+	case ExprOp::Max: return b.make(ExprOp::Select, b.make(ExprOp::Ge, a, bb), da, db);
+	case ExprOp::Atan2:
+		//atan2(a, b)' = (b a' - a b') / (a^2 + b^2)
+		return b.make(Div, b.make(Sub, b.make(Mul, bb, da), b.make(Mul, a, db)),
+			b.make(Add, b.make(Mul, a, a), b.make(Mul, bb, bb)));
+	case ExprOp::Hypot: return b.make(Div, b.make(Add, b.make(Mul, a, da), b.make(Mul, bb, db)), id);
+	default:
+		//floor, ceil, round, trunc, sgn, comparisons and logic are flat almost everywhere
+		return zero;
+	}
+}
+
+std::vector<int> build_jacobian(ExprBuilder& builder, int root_x, int root_y) {
+	Differentiator by_x(builder, 0);
+	Differentiator by_y(builder, 1);
+	std::vector<int> roots;
+	roots.push_back(by_x.derive(root_x));
+	roots.push_back(by_y.derive(root_x));
+	roots.push_back(by_x.derive(root_y));
+	roots.push_back(by_y.derive(root_y));
+	return roots;
+}
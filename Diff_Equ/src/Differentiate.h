@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+
+#include "ExprBuilder.h"
+
+//symbolic partial derivatives over an ExprTree. derivative nodes are appended to the builder's tree
+//and share every subexpression they can with the original equations (sin(x) -> cos(x) reuses x,
+//sqrt(u) -> u' / (2 sqrt(u)) reuses the sqrt node). piecewise-constant ops like floor differentiate to 0
+class Differentiator {
+public:
+	Differentiator(ExprBuilder& builder, int slot);
+
+	//d(node)/d(slot), memoized so shared subtrees are differentiated once
+	int derive(int node);
+
+private:
+	int rule(const ExprNode& node, int id);
+
+	ExprBuilder& b;
+	int slot;
+	int zero;
+	int one;
+	std::vector<int> memo;
+};
+
+//appends the 2x2 Jacobian of (root_x, root_y) with respect to slots 0 and 1 (x and y),
+//row major: d(dx)/dx, d(dx)/dy, d(dy)/dx, d(dy)/dy
+std::vector<int> build_jacobian(ExprBuilder& builder, int root_x, int root_y);
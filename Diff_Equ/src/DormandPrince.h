@@ -0,0 +1,164 @@
+#pragma once
+#include <cmath>
+
+#include "Adaptive.h"
+
+//Dormand-Prince 5(4) with first-same-as-last, Hairer's PI step size controller and the
+//4th order dense output from dopri5. resumable: every step() advances exactly one accepted step,
+//so callers can interleave stepping with sampling. coefficients are built as T(p) / T(q)
+//so wider scalar types get them to full precision
+template <typename T, typename F>
+class DormandPrince {
+public:
+	DormandPrince(F& f, Tolerance tolerance) : f(f), tolerance(tolerance) {
+		c2 = T(1) / T(5); c3 = T(3) / T(10); c4 = T(4) / T(5); c5 = T(8) / T(9);
+		a21 = T(1) / T(5);
+		a31 = T(3) / T(40); a32 = T(9) / T(40);
+		a41 = T(44) / T(45); a42 = T(-56) / T(15); a43 = T(32) / T(9);
+		a51 = T(19372) / T(6561); a52 = T(-25360) / T(2187); a53 = T(64448) / T(6561); a54 = T(-212) / T(729);
+		a61 = T(9017) / T(3168); a62 = T(-355) / T(33); a63 = T(46732) / T(5247); a64 = T(49) / T(176); a65 = T(-5103) / T(18656);
+		a71 = T(35) / T(384); a73 = T(500) / T(1113); a74 = T(125) / T(192); a75 = T(-2187) / T(6784); a76 = T(11) / T(84);
+		//fifth minus embedded fourth order weights
+		e1 = T(71) / T(57600); e3 = T(-71) / T(16695); e4 = T(71) / T(1920);
+		e5 = T(-17253) / T(339200); e6 = T(22) / T(525); e7 = T(-1) / T(40);
+		d1 = T(-12715105075.0) / T(11282082432.0); d3 = T(87487479700.0) / T(32700410799.0);
+		d4 = T(-10690763975.0) / T(1880347072.0); d5 = T(701980252875.0) / T(199316789632.0);
+		d6 = T(-1453857185.0) / T(822651844.0); d7 = T(69997945.0) / T(29380423.0);
+	}
+
+	//first_step 0 picks one from the local derivative scale
+	void start(T t0, T x0, T y0, T first_step = T(0)) {
+		t = previous_t = t0;
+		x = x0;
+		y = y0;
+		last_h = T(0);
+		previous_error = 1e-4;
+		stats = StepStats();
+		eval(t, x, y, kx[0], ky[0]);
+		h = first_step > T(0) ? first_step : initial_step(f, tolerance, 5, t, x, y, kx[0], ky[0], stats);
+	}
+
+	//one accepted step that never passes t_stop. false once t_stop is reached,
+	//or when the step size underflows or the solution stops being finite
+	bool step(T t_stop) {
+		if (!(t < t_stop))
+			return false;
+
+		while (true) {
+			T step_h = h;
+			bool last = false;
+			if (t + step_h >= t_stop) {
+				step_h = t_stop - t;
+				last = true;
+			}
+			if (!(step_h > T(0)) || (double)step_h <= std::fabs((double)t) * 1e-15)
+				return false;
+
+			T x1, y1;
+			stages(step_h, x1, y1);
+
+			double error = embedded_error(step_h, x1, y1);
+			if (!std::isfinite(error)) {
+				h = step_h * T(0.2);
+				stats.rejected++;
+				continue;
+			}
+
+			//PI control, alpha = 0.2 - 0.75 beta, beta = 0.04
+			double fac11 = std::pow(error, 0.17);
+			if (error <= 1.0) {
+				double fac = fac11 / std::pow(previous_error, 0.04) / 0.9;
+				fac = fac < 0.1 ? 0.1 : (fac > 5.0 ? 5.0 : fac);
+				previous_error = error > 1e-4 ? error : 1e-4;
+
+				prepare_dense(step_h, x1, y1);
+				previous_t = t;
+				t = last ? t_stop : t + step_h;
+				x = x1;
+				y = y1;
+				kx[0] = kx[6];
+				ky[0] = ky[6];
+				last_h = step_h;
+				h = step_h / T(fac);
+				stats.accepted++;
+				return true;
+			}
+
+			double shrink = fac11 / 0.9;
+			h = step_h / T(shrink > 5.0 ? 5.0 : shrink);
+			stats.rejected++;
+		}
+	}
+
+	//state anywhere inside the last accepted step [previous_t, t]
+	void dense(T time, T& out_x, T& out_y) const {
+		if (!(last_h > T(0))) {
+			out_x = x;
+			out_y = y;
+			return;
+		}
+		T theta = (time - previous_t) / last_h;
+		T theta1 = T(1) - theta;
+		out_x = cx[0] + theta * (cx[1] + theta1 * (cx[2] + theta * (cx[3] + theta1 * cx[4])));
+		out_y = cy[0] + theta * (cy[1] + theta1 * (cy[2] + theta * (cy[3] + theta1 * cy[4])));
+	}
+
+	T t = T(0);
+	T x = T(0);
+	T y = T(0);
+	T previous_t = T(0);
+	T h = T(0);                 //next step size to try
+	StepStats stats;
+
+private:
+	void eval(T time, T px, T py, T& dx, T& dy) {
+		stats.evaluations++;
+		f(time, px, py, dx, dy);
+	}
+
+	//the six new stages, kx[6] is the derivative at the new point and becomes next step's k1
+	void stages(T s, T& x1, T& y1) {
+		eval(t + c2 * s, x + s * (a21 * kx[0]), y + s * (a21 * ky[0]), kx[1], ky[1]);
+		eval(t + c3 * s, x + s * (a31 * kx[0] + a32 * kx[1]), y + s * (a31 * ky[0] + a32 * ky[1]), kx[2], ky[2]);
+		eval(t + c4 * s, x + s * (a41 * kx[0] + a42 * kx[1] + a43 * kx[2]),
+			y + s * (a41 * ky[0] + a42 * ky[1] + a43 * ky[2]), kx[3], ky[3]);
+		eval(t + c5 * s, x + s * (a51 * kx[0] + a52 * kx[1] + a53 * kx[2] + a54 * kx[3]),
+			y + s * (a51 * ky[0] + a52 * ky[1] + a53 * ky[2] + a54 * ky[3]), kx[4], ky[4]);
+		eval(t + s, x + s * (a61 * kx[0] + a62 * kx[1] + a63 * kx[2] + a64 * kx[3] + a65 * kx[4]),
+			y + s * (a61 * ky[0] + a62 * ky[1] + a63 * ky[2] + a64 * ky[3] + a65 * ky[4]), kx[5], ky[5]);
+		x1 = x + s * (a71 * kx[0] + a73 * kx[2] + a74 * kx[3] + a75 * kx[4] + a76 * kx[5]);
+		y1 = y + s * (a71 * ky[0] + a73 * ky[2] + a74 * ky[3] + a75 * ky[4] + a76 * ky[5]);
+		eval(t + s, x1, y1, kx[6], ky[6]);
+	}
+
+	//rms of the embedded error over both components, <= 1 passes
+	double embedded_error(T s, T x1, T y1) const {
+		T ex = s * (e1 * kx[0] + e3 * kx[2] + e4 * kx[3] + e5 * kx[4] + e6 * kx[5] + e7 * kx[6]);
+		T ey = s * (e1 * ky[0] + e3 * ky[2] + e4 * ky[3] + e5 * ky[4] + e6 * ky[5] + e7 * ky[6]);
+		return error_norm(tolerance, ex, ey, x, y, x1, y1);
+	}
+
+	void prepare_dense(T s, T x1, T y1) {
+		T dx = x1 - x;
+		T dy = y1 - y;
+		T bx = s * kx[0] - dx;
+		T by = s * ky[0] - dy;
+		cx[0] = x; cx[1] = dx; cx[2] = bx; cx[3] = dx - s * kx[6] - bx;
+		cy[0] = y; cy[1] = dy; cy[2] = by; cy[3] = dy - s * ky[6] - by;
+		cx[4] = s * (d1 * kx[0] + d3 * kx[2] + d4 * kx[3] + d5 * kx[4] + d6 * kx[5] + d7 * kx[6]);
+		cy[4] = s * (d1 * ky[0] + d3 * ky[2] + d4 * ky[3] + d5 * ky[4] + d6 * ky[5] + d7 * ky[6]);
+	}
+
+	F& f;
+	Tolerance tolerance;
+	T kx[7], ky[7];
+	T cx[5], cy[5];
+	T last_h = T(0);
+	double previous_error = 1e-4;
+
+	T c2, c3, c4, c5;
+	T a21, a31, a32, a41, a42, a43, a51, a52, a53, a54, a61, a62, a63, a64, a65;
+	T a71, a73, a74, a75, a76;
+	T e1, e3, e4, e5, e6, e7;
+	T d1, d3, d4, d5, d6, d7;
+};
@@ -0,0 +1,309 @@
+#pragma once
+#include <cmath>
+
+//unevaluated sum hi + lo of two doubles, about 32 significant digits.
+//arithmetic is branch free error-free transforms on fma, so loops over arrays of these vectorize like plain doubles.
+//needs strict IEEE evaluation, never build this with -ffast-math or /fp:fast
+struct DoubleDouble {
+	double hi = 0.0;
+	double lo = 0.0;
+
+	DoubleDouble() {}
+	DoubleDouble(double value) : hi(value) {}
+	DoubleDouble(double high, double low) : hi(high), lo(low) {}
+
+	explicit operator double() const { return hi; }
+	explicit operator float() const { return (float)hi; }
+};
+
+inline DoubleDouble dd_two_sum(double a, double b) {
+	double s = a + b;
+	double v = s - a;
+	return DoubleDouble(s, (a - (s - v)) + (b - v));
+}
+
+//only exact when |a| >= |b|
+inline DoubleDouble dd_quick_two_sum(double a, double b) {
+	double s = a + b;
+	return DoubleDouble(s, b - (s - a));
+}
+
+inline DoubleDouble dd_two_prod(double a, double b) {
+	double p = a * b;
+	return DoubleDouble(p, std::fma(a, b, -p));
+}
+
+inline DoubleDouble operator-(DoubleDouble a) {
+	return DoubleDouble(-a.hi, -a.lo);
+}
+
+inline DoubleDouble operator+(DoubleDouble a, DoubleDouble b) {
+	DoubleDouble s = dd_two_sum(a.hi, b.hi);
+	DoubleDouble e = dd_two_sum(a.lo, b.lo);
+	s = dd_quick_two_sum(s.hi, s.lo + e.hi);
+	return dd_quick_two_sum(s.hi, s.lo + e.lo);
+}
+
+inline DoubleDouble operator-(DoubleDouble a, DoubleDouble b) {
+	return a + (-b);
+}
+
+inline DoubleDouble operator*(DoubleDouble a, DoubleDouble b) {
+	DoubleDouble p = dd_two_prod(a.hi, b.hi);
+	return dd_quick_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+//long division, three partial quotients
+inline DoubleDouble operator/(DoubleDouble a, DoubleDouble b) {
+	double q1 = a.hi / b.hi;
+	DoubleDouble r = a - b * DoubleDouble(q1);
+	double q2 = r.hi / b.hi;
+	r = r - b * DoubleDouble(q2);
+	double q3 = r.hi / b.hi;
+	return dd_quick_two_sum(q1, q2) + DoubleDouble(q3);
+}
+
+inline DoubleDouble& operator+=(DoubleDouble& a, DoubleDouble b) { return a = a + b; }
+inline DoubleDouble& operator-=(DoubleDouble& a, DoubleDouble b) { return a = a - b; }
+inline DoubleDouble& operator*=(DoubleDouble& a, DoubleDouble b) { return a = a * b; }
+inline DoubleDouble& operator/=(DoubleDouble& a, DoubleDouble b) { return a = a / b; }
+
+inline bool operator==(DoubleDouble a, DoubleDouble b) { return a.hi == b.hi && a.lo == b.lo; }
+inline bool operator!=(DoubleDouble a, DoubleDouble b) { return !(a == b); }
+inline bool operator<(DoubleDouble a, DoubleDouble b) { return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo); }
+inline bool operator>(DoubleDouble a, DoubleDouble b) { return b < a; }
+inline bool operator<=(DoubleDouble a, DoubleDouble b) { return a.hi < b.hi || (a.hi == b.hi && a.lo <= b.lo); }
+inline bool operator>=(DoubleDouble a, DoubleDouble b) { return b <= a; }
+
+//constants from the QD library
+const DoubleDouble dd_pi(3.141592653589793116e+00, 1.224646799147353207e-16);
+const DoubleDouble dd_half_pi(1.570796326794896558e+00, 6.123233995736766036e-17);
+const DoubleDouble dd_ln2(6.931471805599452862e-01, 2.319046813846299558e-17);
+const DoubleDouble dd_ln10(2.302585092994045901e+00, -2.170756223382249351e-16);
+
+//overloads of the <cmath> names, found by argument dependent lookup from templated code
+inline bool isnan(DoubleDouble a) { return std::isnan(a.hi); }
+inline bool isinf(DoubleDouble a) { return std::isinf(a.hi); }
+inline bool isfinite(DoubleDouble a) { return std::isfinite(a.hi); }
+
+inline DoubleDouble fabs(DoubleDouble a) { return a.hi < 0.0 ? -a : a; }
+inline DoubleDouble abs(DoubleDouble a) { return fabs(a); }
+
+inline DoubleDouble floor(DoubleDouble a) {
+	double h = std::floor(a.hi);
+	return h == a.hi ? dd_quick_two_sum(h, std::floor(a.lo)) : DoubleDouble(h);
+}
+
+inline DoubleDouble ceil(DoubleDouble a) {
+	double h = std::ceil(a.hi);
+	return h == a.hi ? dd_quick_two_sum(h, std::ceil(a.lo)) : DoubleDouble(h);
+}
+
+inline DoubleDouble trunc(DoubleDouble a) {
+	return a.hi < 0.0 ? ceil(a) : floor(a);
+}
+
+inline DoubleDouble fmin(DoubleDouble a, DoubleDouble b) {
+	if (isnan(a))
+		return b;
+	return (isnan(b) || a < b) ? a : b;
+}
+
+inline DoubleDouble fmax(DoubleDouble a, DoubleDouble b) {
+	if (isnan(a))
+		return b;
+	return (isnan(b) || a > b) ? a : b;
+}
+
+inline DoubleDouble fmod(DoubleDouble a, DoubleDouble b) {
+	return a - trunc(a / b) * b;
+}
+
+//one Newton step on the double square root doubles its precision
+inline DoubleDouble sqrt(DoubleDouble a) {
+	if (a.hi <= 0.0)
+		return DoubleDouble(a.hi == 0.0 ? 0.0 : std::nan(""));
+	if (std::isinf(a.hi))
+		return a;
+	double x = 1.0 / std::sqrt(a.hi);
+	double ax = a.hi * x;
+	return dd_two_sum(ax, (a - dd_two_prod(ax, ax)).hi * (x * 0.5));
+}
+
+inline DoubleDouble hypot(DoubleDouble a, DoubleDouble b) {
+	return sqrt(a * a + b * b);
+}
+
+//e^a = 2^m * e^r, the reduced argument's series is squared back up 9 times
+inline DoubleDouble exp(DoubleDouble a) {
+	if (a.hi > 709.0)
+		return DoubleDouble(INFINITY);
+	if (a.hi < -745.0)
+		return DoubleDouble(0.0);
+	if (std::isnan(a.hi))
+		return a;
+
+	double m = std::floor(a.hi / dd_ln2.hi + 0.5);
+	DoubleDouble r = (a - dd_ln2 * DoubleDouble(m)) * DoubleDouble(1.0 / 512.0);
+
+	//s = e^r - 1
+	DoubleDouble term = r;
+	DoubleDouble s = r;
+	for (int i = 2; i < 20; i++) {
+		term = term * r / DoubleDouble((double)i);
+		s += term;
+		if (std::fabs(term.hi) < 1e-34)
+			break;
+	}
+	for (int i = 0; i < 9; i++)
+		s = s * DoubleDouble(2.0) + s * s;
+	s += DoubleDouble(1.0);
+	return DoubleDouble(std::ldexp(s.hi, (int)m), std::ldexp(s.lo, (int)m));
+}
+
+//Newton on exp from the double logarithm
+inline DoubleDouble log(DoubleDouble a) {
+	if (a.hi <= 0.0)
+		return DoubleDouble(a.hi == 0.0 ? -INFINITY : std::nan(""));
+	if (std::isinf(a.hi) || std::isnan(a.hi))
+		return a;
+	DoubleDouble x(std::log(a.hi));
+	return x + a * exp(-x) - DoubleDouble(1.0);
+}
+
+inline DoubleDouble log2(DoubleDouble a) { return log(a) / dd_ln2; }
+inline DoubleDouble log10(DoubleDouble a) { return log(a) / dd_ln10; }
+
+inline DoubleDouble pow(DoubleDouble a, DoubleDouble b) {
+	//integer powers by squaring keep full precision and allow negative bases
+	if (floor(b) == b && std::fabs(b.hi) < 2147483648.0) {
+		long long n = (long long)b.hi + (long long)b.lo;
+		bool invert = n < 0;
+		if (invert)
+			n = -n;
+		DoubleDouble result(1.0);
+		DoubleDouble base = a;
+		while (n > 0) {
+			if (n & 1)
+				result *= base;
+			base *= base;
+			n >>= 1;
+		}
+		return invert ? DoubleDouble(1.0) / result : result;
+	}
+	if (a.hi < 0.0)
+		return DoubleDouble(std::nan(""));
+	return exp(b * log(a));
+}
+
+//both series for |r| <= pi/4
+inline void dd_sin_cos_reduced(DoubleDouble r, DoubleDouble& s, DoubleDouble& c) {
+	DoubleDouble r2 = r * r;
+	DoubleDouble term = r;
+	s = r;
+	for (int i = 3; i < 40; i += 2) {
+		term = -term * r2 / DoubleDouble((double)(i * (i - 1)));
+		s += term;
+		if (std::fabs(term.hi) < 1e-34)
+			break;
+	}
+	term = DoubleDouble(1.0);
+	c = term;
+	for (int i = 2; i < 40; i += 2) {
+		term = -term * r2 / DoubleDouble((double)(i * (i - 1)));
+		c += term;
+		if (std::fabs(term.hi) < 1e-34)
+			break;
+	}
+}
+
+//reduces by the nearest multiple of pi/2 and rotates the quadrant
+inline void dd_sin_cos(DoubleDouble a, DoubleDouble& s, DoubleDouble& c) {
+	if (!std::isfinite(a.hi)) {
+		s = c = DoubleDouble(std::nan(""));
+		return;
+	}
+	double k = std::floor(a.hi / dd_half_pi.hi + 0.5);
+	DoubleDouble r = a - dd_half_pi * DoubleDouble(k);
+	DoubleDouble rs, rc;
+	dd_sin_cos_reduced(r, rs, rc);
+	switch (((long long)k % 4 + 4) % 4) {
+	case 0: s = rs; c = rc; break;
+	case 1: s = rc; c = -rs; break;
+	case 2: s = -rs; c = -rc; break;
+	default: s = -rc; c = rs; break;
+	}
+}
+
+inline DoubleDouble sin(DoubleDouble a) {
+	DoubleDouble s, c;
+	dd_sin_cos(a, s, c);
+	return s;
+}
+
+inline DoubleDouble cos(DoubleDouble a) {
+	DoubleDouble s, c;
+	dd_sin_cos(a, s, c);
+	return c;
+}
+
+inline DoubleDouble tan(DoubleDouble a) {
+	DoubleDouble s, c;
+	dd_sin_cos(a, s, c);
+	return s / c;
+}
+
+//Newton on y cos z - x sin z from the double angle, correct in every quadrant
+inline DoubleDouble atan2(DoubleDouble y, DoubleDouble x) {
+	DoubleDouble z(std::atan2(y.hi, x.hi));
+	if ((x.hi == 0.0 && y.hi == 0.0) || !std::isfinite(x.hi) || !std::isfinite(y.hi))
+		return z;
+	DoubleDouble s, c;
+	dd_sin_cos(z, s, c);
+	return z + (y * c - x * s) / (x * c + y * s);
+}
+
+inline DoubleDouble atan(DoubleDouble a) {
+	return atan2(a, DoubleDouble(1.0));
+}
+
+inline DoubleDouble asin(DoubleDouble a) {
+	if (fabs(a) > DoubleDouble(1.0))
+		return DoubleDouble(std::nan(""));
+	return atan2(a, sqrt(DoubleDouble(1.0) - a * a));
+}
+
+inline DoubleDouble acos(DoubleDouble a) {
+	if (fabs(a) > DoubleDouble(1.0))
+		return DoubleDouble(std::nan(""));
+	return atan2(sqrt(DoubleDouble(1.0) - a * a), a);
+}
+
+//the exp form cancels near zero, so small arguments take the series
+inline DoubleDouble sinh(DoubleDouble a) {
+	if (std::fabs(a.hi) < 0.1) {
+		DoubleDouble a2 = a * a;
+		DoubleDouble term = a;
+		DoubleDouble s = a;
+		for (int i = 3; i < 40; i += 2) {
+			term = term * a2 / DoubleDouble((double)(i * (i - 1)));
+			s += term;
+			if (std::fabs(term.hi) < 1e-34)
+				break;
+		}
+		return s;
+	}
+	DoubleDouble e = exp(a);
+	return (e - DoubleDouble(1.0) / e) * DoubleDouble(0.5);
+}
+
+inline DoubleDouble cosh(DoubleDouble a) {
+	DoubleDouble e = exp(a);
+	return (e + DoubleDouble(1.0) / e) * DoubleDouble(0.5);
+}
+
+inline DoubleDouble tanh(DoubleDouble a) {
+	if (std::fabs(a.hi) > 40.0)
+		return DoubleDouble(a.hi > 0.0 ? 1.0 : -1.0);
+	return sinh(a) / cosh(a);
+}
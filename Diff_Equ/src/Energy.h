@@ -0,0 +1,51 @@
+#pragma once
+#include <cmath>
+
+//energy of a separable system (EvalContext::separable()), H = T(y) + V(x) with T' = dx and V' = -dy,
+//both integrals taken from 0 by composite 5 point Gauss-Legendre. equations only give H up to a
+//constant, which drops out of the drift. F is a double system, e.g. SystemEval<double>
+template <typename F>
+inline double separable_energy(F& f, double t, double x, double y) {
+	static const double nodes[5] = { -0.9061798459386640, -0.5384693101056831, 0.0, 0.5384693101056831, 0.9061798459386640 };
+	static const double weights[5] = { 0.2369268850561891, 0.4786286704993665, 0.5688888888888889, 0.4786286704993665, 0.2369268850561891 };
+	const int panels = 4;
+
+	double kinetic = 0.0;
+	double potential = 0.0;
+	for (int p = 0; p < panels; p++) {
+		for (int i = 0; i < 5; i++) {
+			double s = (p + 0.5 * (nodes[i] + 1.0)) / panels;
+			double dx, dy;
+			//dx ignores x and dy ignores y here, so the other coordinate can be anything
+			f(t, 0.0, s * y, dx, dy);
+			kinetic += weights[i] * dx;
+			f(t, s * x, 0.0, dx, dy);
+			potential -= weights[i] * dy;
+		}
+	}
+	return 0.5 / panels * (kinetic * y + potential * x);
+}
+
+//worst energy error seen along a trajectory, relative to the starting energy when that is not ~0
+struct EnergyMonitor {
+	template <typename F>
+	void start(F& f, double t, double x, double y) {
+		initial = separable_energy(f, t, x, y);
+		max_drift = 0.0;
+	}
+
+	template <typename F>
+	void sample(F& f, double t, double x, double y) {
+		//a blown up trajectory stays NaN instead of being skipped by fmax
+		double drift = std::fabs(separable_energy(f, t, x, y) - initial);
+		if (max_drift == max_drift && !(drift <= max_drift))
+			max_drift = drift;
+	}
+
+	double relative() const {
+		return std::fabs(initial) > 1e-12 ? max_drift / std::fabs(initial) : max_drift;
+	}
+
+	double initial = 0.0;
+	double max_drift = 0.0;
+};
@@ -0,0 +1,367 @@
+#include "Ensemble.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "Simd.h"
+
+//slots are padded to whole vectors. past n a tile only holds dead slots (retired, or beyond the last
+//trajectory), so sweeping them along is harmless and no loop needs a scalar tail
+static size_t lanes_for(size_t n) {
+	return (n + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+}
+
+//out = base + a d over whole vectors, out may be base
+static void combine(float* out, const float* base, float a, const float* d, size_t lanes) {
+	const simd_float va = simd_set(a);
+	for (size_t i = 0; i < lanes; i += SIMD_WIDTH)
+		simd_storeu(out + i, simd_add(simd_loadu(base + i), simd_mul(va, simd_loadu(d + i))));
+}
+
+void Ensemble::clear() {
+	results.clear();
+	first_steps.clear();
+	xs.clear();
+	ys.clear();
+	ids.clear();
+	end_steps.clear();
+	active = 0;
+	time = 0.0;
+	steps_done = 0;
+	evaluations = 0;
+	retired = 0;
+	event_evaluations = 0;
+}
+
+void Ensemble::set_events(EventSet* set) {
+	events = set && set->any_terminal() ? set : nullptr;
+	event_copies.clear();
+}
+
+size_t Ensemble::add(float x, float y, long long steps) {
+	size_t id = results.size();
+	TrajectoryResult result = { x, y, 0, TrajectoryState::Running, -1 };
+	results.push_back(result);
+	first_steps.push_back(steps_done);
+	if (steps <= 0) {
+		results[id].state = TrajectoryState::Finished;
+		retired++;
+		return id;
+	}
+
+	//running trajectories are always the slot prefix, retired ones give their slot up
+	resize_slots(active + 1);
+	xs[active] = x;
+	ys[active] = y;
+	ids[active] = (int)id;
+	end_steps[active] = steps_done + steps;
+	active++;
+	return id;
+}
+
+void Ensemble::resize_slots(size_t n) {
+	size_t lanes = lanes_for(n);
+	xs.resize(lanes);
+	ys.resize(lanes);
+	ids.resize(lanes);
+	end_steps.resize(lanes);
+}
+
+void Ensemble::resize_scratch(size_t participants) {
+	if (scratch.size() < participants)
+		scratch.resize(participants);
+	for (Scratch& s : scratch) {
+		s.sx.resize(tile);
+		s.sy.resize(tile);
+		s.kx.resize(tile);
+		s.ky.resize(tile);
+		s.ax.resize(tile);
+		s.ay.resize(tile);
+		s.evaluations = 0;
+		s.retired = 0;
+		s.event_evaluations = 0;
+		if (!events)
+			continue;
+		s.ex.resize(tile);
+		s.ey.resize(tile);
+		s.g.resize(events->size());
+		for (std::vector<float>& g : s.g)
+			g.resize(tile);
+		s.next_g.resize(tile);
+		s.hit.resize(tile);
+		s.hit_at.resize(tile);
+	}
+}
+
+//one step of the method for slots [begin, begin + n), the same formulas as Integrators.h over arrays
+void Ensemble::step_tile(EvalContext& context, Scratch& scratch, Method method, float t, float h, size_t begin, size_t n) {
+	float* x = xs.data() + begin;
+	float* y = ys.data() + begin;
+	float* px = scratch.sx.data();
+	float* py = scratch.sy.data();
+	float* dx = scratch.kx.data();
+	float* dy = scratch.ky.data();
+	float* sum_x = scratch.ax.data();
+	float* sum_y = scratch.ay.data();
+	const size_t lanes = lanes_for(n);
+	auto eval = [&](float time, const float* ex, const float* ey, float* edx, float* edy, size_t count) {
+		scratch.evaluations += count;
+		context.eval_batch(time, ex, ey, edx, edy, count);
+	};
+
+	switch (method) {
+	case Method::Euler:
+		eval(t, x, y, dx, dy, n);
+		combine(x, x, h, dx, lanes);
+		combine(y, y, h, dy, lanes);
+		break;
+	case Method::Heun:
+		eval(t, x, y, dx, dy, n);
+		combine(px, x, h, dx, lanes);
+		combine(py, y, h, dy, lanes);
+		eval(t + h, px, py, sum_x, sum_y, n);
+		combine(dx, dx, 1.0f, sum_x, lanes);
+		combine(dy, dy, 1.0f, sum_y, lanes);
+		combine(x, x, h * 0.5f, dx, lanes);
+		combine(y, y, h * 0.5f, dy, lanes);
+		break;
+	case Method::Rk4: {
+		//k1 + 2 k2 + 2 k3 + k4 accumulates in sum
+		const float half = h * 0.5f;
+		eval(t, x, y, dx, dy, n);
+		std::memcpy(sum_x, dx, lanes * sizeof(float));
+		std::memcpy(sum_y, dy, lanes * sizeof(float));
+		combine(px, x, half, dx, lanes);
+		combine(py, y, half, dy, lanes);
+		eval(t + half, px, py, dx, dy, n);
+		combine(sum_x, sum_x, 2.0f, dx, lanes);
+		combine(sum_y, sum_y, 2.0f, dy, lanes);
+		combine(px, x, half, dx, lanes);
+		combine(py, y, half, dy, lanes);
+		eval(t + half, px, py, dx, dy, n);
+		combine(sum_x, sum_x, 2.0f, dx, lanes);
+		combine(sum_y, sum_y, 2.0f, dy, lanes);
+		combine(px, x, h, dx, lanes);
+		combine(py, y, h, dy, lanes);
+		eval(t + h, px, py, dx, dy, n);
+		combine(sum_x, sum_x, 1.0f, dx, lanes);
+		combine(sum_y, sum_y, 1.0f, dy, lanes);
+		combine(x, x, h / 6.0f, sum_x, lanes);
+		combine(y, y, h / 6.0f, sum_y, lanes);
+		break;
+	}
+	case Method::Leapfrog:
+	case Method::Yoshida4: {
+		//kick y, drift x, ..., kick y; leapfrog is the one-drift case of Yoshida's composition
+		static const float w1 = (float)(1.0 / (2.0 - std::pow(2.0, 1.0 / 3.0)));
+		static const float w0 = 1.0f - 2.0f * w1;
+		static const float leapfrog_kicks[2] = { 0.5f, 0.5f };
+		static const float leapfrog_drifts[1] = { 1.0f };
+		static const float yoshida_kicks[4] = { w1 * 0.5f, (w1 + w0) * 0.5f, (w0 + w1) * 0.5f, w1 * 0.5f };
+		static const float yoshida_drifts[3] = { w1, w0, w1 };
+		bool leapfrog = method == Method::Leapfrog;
+		const float* kicks = leapfrog ? leapfrog_kicks : yoshida_kicks;
+		const float* drifts = leapfrog ? leapfrog_drifts : yoshida_drifts;
+		int count = leapfrog ? 1 : 3;
+
+		float now = t;
+		for (int s = 0; s <= count; s++) {
+			eval(now, x, y, dx, dy, n);
+			combine(y, y, h * kicks[s], dy, lanes);
+			if (s == count)
+				break;
+			now += h * drifts[s] * 0.5f;
+			eval(now, x, y, dx, dy, n);
+			combine(x, x, h * drifts[s], dx, lanes);
+			now += h * drifts[s] * 0.5f;
+		}
+		break;
+	}
+	}
+}
+
+void Ensemble::retire(Scratch& scratch, size_t slot, long long step, TrajectoryState state) {
+	TrajectoryResult& result = results[ids[slot]];
+	result.x = xs[slot];
+	result.y = ys[slot];
+	result.steps = step - first_steps[ids[slot]];
+	result.state = state;
+	scratch.retired++;
+}
+
+//retires the tile's slots whose budget ends at step (and, with check_escape, the ones outside the box,
+//with check_events the ones detect_events() flagged), moving the survivors and their event values down
+//so the tile stays a dense run. returns the survivors
+size_t Ensemble::compact_tile(Scratch& scratch, size_t begin, size_t n, long long step, bool check_escape, bool check_events) {
+	const float radius = escape_radius;
+	size_t kept = begin;
+	for (size_t i = begin; i < begin + n; i++) {
+		float x = xs[i];
+		float y = ys[i];
+		bool inside = std::fabs(x) <= radius && std::fabs(y) <= radius;
+		bool finite = std::isfinite(x) && std::isfinite(y);
+		if (check_events && scratch.hit[i - begin] >= 0) {
+			//the crossing sits where g does on the line between the step's ends
+			size_t k = i - begin;
+			float at = scratch.hit_at[k];
+			xs[i] = scratch.ex[k] + at * (x - scratch.ex[k]);
+			ys[i] = scratch.ey[k] + at * (y - scratch.ey[k]);
+			results[ids[i]].event = scratch.hit[k];
+			retire(scratch, i, step, TrajectoryState::Stopped);
+		}
+		else if (end_steps[i] <= step)
+			retire(scratch, i, step, finite ? TrajectoryState::Finished : TrajectoryState::Diverged);
+		else if (check_escape && !inside)
+			retire(scratch, i, step, finite ? TrajectoryState::Escaped : TrajectoryState::Diverged);
+		else {
+			if (kept != i) {
+				xs[kept] = x;
+				ys[kept] = y;
+				ids[kept] = ids[i];
+				end_steps[kept] = end_steps[i];
+				for (std::vector<float>& g : scratch.g)
+					g[kept - begin] = g[i - begin];
+			}
+			kept++;
+		}
+	}
+	return kept - begin;
+}
+
+//terminal events at the tile's new states against their values before the step. flags each slot with the
+//event whose crossing came first, placed by interpolating g linearly over the step, true when any fired
+bool Ensemble::detect_events(EventSet& set, Scratch& scratch, float t, size_t begin, size_t n) {
+	bool fired = false;
+	for (size_t i = 0; i < n; i++)
+		scratch.hit[i] = -1;
+	for (size_t e = 0; e < set.size(); e++) {
+		if (!set.spec(e).terminal)
+			continue;
+		float* before = scratch.g[e].data();
+		float* after = scratch.next_g.data();
+		//dy of an event function is a constant 0, it lands in stage scratch the step is done with
+		set.function(e).eval_batch(t, xs.data() + begin, ys.data() + begin, after, scratch.kx.data(), n);
+		scratch.event_evaluations += n;
+		for (size_t i = 0; i < n; i++) {
+			if (!set.crosses(e, before[i], after[i]))
+				continue;
+			float at = before[i] / (before[i] - after[i]);
+			if (scratch.hit[i] < 0 || at < scratch.hit_at[i]) {
+				scratch.hit[i] = (int)e;
+				scratch.hit_at[i] = at;
+				fired = true;
+			}
+		}
+		scratch.g[e].swap(scratch.next_g);
+	}
+	return fired;
+}
+
+//every step of one tile, returns its survivors, which are left at the front of the tile
+size_t Ensemble::advance_tile(EvalContext& context, Scratch& scratch, EventSet* set, Method method, float h, long long max_steps,
+	size_t begin, size_t n) {
+	//budget checks only when the earliest one in the tile is due
+	long long first_end = end_steps[begin];
+	for (size_t i = begin; i < begin + n; i++)
+		first_end = end_steps[i] < first_end ? end_steps[i] : first_end;
+
+	if (set) {
+		for (size_t e = 0; e < set->size(); e++) {
+			if (!set->spec(e).terminal)
+				continue;
+			set->function(e).eval_batch((float)time, xs.data() + begin, ys.data() + begin, scratch.g[e].data(), scratch.kx.data(), n);
+			scratch.event_evaluations += n;
+		}
+	}
+
+	for (long long s = 0; s < max_steps && n > 0; s++) {
+		long long step = steps_done + s + 1;
+		if (set) {
+			std::memcpy(scratch.ex.data(), xs.data() + begin, n * sizeof(float));
+			std::memcpy(scratch.ey.data(), ys.data() + begin, n * sizeof(float));
+		}
+		step_tile(context, scratch, method, (float)(time + (double)h * (double)s), h, begin, n);
+		bool fired = set && detect_events(*set, scratch, (float)(time + (double)h * (double)(s + 1)), begin, n);
+		bool escape = step % check_interval == 0 || s + 1 == max_steps;
+		if (!escape && step < first_end && !fired)
+			continue;
+		n = compact_tile(scratch, begin, n, step, escape, set != nullptr);
+		for (size_t i = begin; i < begin + n; i++)
+			first_end = i == begin || end_steps[i] < first_end ? end_steps[i] : first_end;
+	}
+	return n;
+}
+
+size_t Ensemble::advance(Method method, float h, long long max_steps) {
+	resize_scratch(1);
+	survivors.clear();
+	for (size_t begin = 0; begin < active; begin += tile) {
+		size_t n = active - begin < (size_t)tile ? active - begin : (size_t)tile;
+		survivors.push_back(advance_tile(*context, scratch[0], events, method, h, max_steps, begin, n));
+	}
+	return finish(max_steps, h);
+}
+
+size_t Ensemble::advance(Method method, float h, long long max_steps, TaskScheduler& scheduler, WorkerContexts& contexts) {
+	const int participants = scheduler.participants();
+	resize_scratch(participants);
+	if (events) {
+		size_t copies = (size_t)participants - 1;
+		if (event_copies.size() != copies || (copies > 0 && event_copies[0]->generation() != events->generation())) {
+			event_copies.clear();
+			for (size_t i = 0; i < copies; i++) {
+				event_copies.emplace_back(new EventSet());
+				event_copies.back()->clone_from(*events);
+			}
+		}
+		for (std::unique_ptr<EventSet>& copy : event_copies)
+			copy->copy_parameters(*events);
+	}
+
+	size_t tiles = (active + tile - 1) / tile;
+	survivors.assign(tiles, 0);
+	//one tile per chunk, a tile is already thousands of evaluations per step
+	scheduler.parallel_for(tiles, 1, [&](size_t first, size_t last, int participant) {
+		for (size_t k = first; k < last; k++) {
+			size_t begin = k * tile;
+			size_t n = active - begin < (size_t)tile ? active - begin : (size_t)tile;
+			EventSet* set = events && participant < (int)event_copies.size() ? event_copies[participant].get() : events;
+			survivors[k] = advance_tile(contexts[participant], scratch[participant], set, method, h, max_steps, begin, n);
+		}
+	});
+	return finish(max_steps, h);
+}
+
+//survivors of every tile move together so the next advance starts on full tiles
+size_t Ensemble::finish(long long max_steps, float h) {
+	size_t packed = 0;
+	for (size_t k = 0; k < survivors.size(); k++) {
+		size_t begin = k * tile;
+		size_t n = survivors[k];
+		for (size_t i = 0; i < n; i++) {
+			xs[packed + i] = xs[begin + i];
+			ys[packed + i] = ys[begin + i];
+			ids[packed + i] = ids[begin + i];
+			end_steps[packed + i] = end_steps[begin + i];
+		}
+		packed += n;
+	}
+	for (const Scratch& s : scratch) {
+		evaluations += s.evaluations;
+		retired += s.retired;
+		event_evaluations += s.event_evaluations;
+	}
+
+	active = packed;
+	resize_slots(active);
+	steps_done += max_steps;
+	time += (double)h * (double)max_steps;
+
+	for (size_t i = 0; i < active; i++) {
+		TrajectoryResult& result = results[ids[i]];
+		result.x = xs[i];
+		result.y = ys[i];
+		result.steps = steps_done - first_steps[ids[i]];
+	}
+	return active;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "EvalContext.h"
+#include "Events.h"
+#include "Integrators.h"
+#include "TaskScheduler.h"
+#include "WorkerContexts.h"
+
+enum class TrajectoryState : unsigned char {
+	Running,
+	Finished,   //used up its step budget
+	Escaped,    //left the escape box
+	Diverged,   //stopped being finite
+	Stopped     //hit a terminal event
+};
+
+struct TrajectoryResult {
+	float x;
+	float y;
+	long long steps;
+	TrajectoryState state;
+	int event;      //the terminal event that stopped it, -1 otherwise
+};
+
+//many trajectories of one system on fixed steps, the state kept in structure-of-arrays form so every
+//stage evaluates a whole run of trajectories through EvalContext::eval_batch (native code or SIMD lanes).
+//trajectories are advanced tile by tile, each tile taking all its steps while it sits in cache, and the
+//ones that finish, escape or blow up are compacted out so the lanes stay full. all share one clock, so
+//time dependent systems see the same t in every lane. results are indexed by the order of add().
+//tiles are independent, so they also spread over a TaskScheduler with the same results on any thread count.
+//terminal events end trajectories early, checked after every step
+class Ensemble {
+public:
+	static const int tile = 1024;
+	static const int check_interval = 16;   //steps between escape checks
+
+	explicit Ensemble(EvalContext& context) : context(&context) {}
+
+	void clear();
+	//one more trajectory from (x, y) at the current time with a budget of steps, returns its index
+	size_t add(float x, float y, long long steps);
+
+	//up to max_steps steps of size h for every running trajectory, returns how many are still running.
+	//afterwards results hold the current state of running trajectories and the final one of retired ones
+	size_t advance(Method method, float h, long long max_steps);
+	//the same with the tiles shared out between the scheduler's participants, each evaluating through its
+	//own context. contexts must already be bound to this ensemble's system
+	size_t advance(Method method, float h, long long max_steps, TaskScheduler& scheduler, WorkerContexts& contexts);
+
+	//terminal events end trajectories at their first crossing, the others are not looked at. events stay
+	//owned by the caller, who binds their parameters; nullptr turns them off
+	void set_events(EventSet* events);
+
+	size_t size() const { return results.size(); }
+	size_t running() const { return active; }
+
+	std::vector<TrajectoryResult> results;
+	float escape_radius = 1e4f;
+	double time = 0.0;
+	long long steps_done = 0;               //steps of the shared clock since clear()
+	unsigned long long evaluations = 0;     //state evaluations, lanes times stages
+	unsigned long long retired = 0;
+	unsigned long long event_evaluations = 0;
+
+private:
+	//stage buffers and counters of one thread, tile sized. padded so neighbours' counters never share a line
+	struct Scratch {
+		std::vector<float> sx, sy, kx, ky, ax, ay;
+		unsigned long long evaluations = 0;
+		unsigned long long retired = 0;
+		//with terminal events: the states before the step, g there per event, the new g, and per slot the
+		//event that fired first (-1 none) at what fraction of the step
+		std::vector<float> ex, ey;
+		std::vector<std::vector<float>> g;
+		std::vector<float> next_g;
+		std::vector<int> hit;
+		std::vector<float> hit_at;
+		unsigned long long event_evaluations = 0;
+		char padding[64];
+	};
+
+	size_t advance_tile(EvalContext& context, Scratch& scratch, EventSet* set, Method method, float h, long long max_steps,
+		size_t begin, size_t n);
+	void step_tile(EvalContext& context, Scratch& scratch, Method method, float t, float h, size_t begin, size_t n);
+	bool detect_events(EventSet& set, Scratch& scratch, float t, size_t begin, size_t n);
+	size_t compact_tile(Scratch& scratch, size_t begin, size_t n, long long step, bool check_escape, bool check_events);
+	void retire(Scratch& scratch, size_t slot, long long step, TrajectoryState state);
+	size_t finish(long long max_steps, float h);
+	void resize_slots(size_t n);
+	void resize_scratch(size_t participants);
+
+	EvalContext* context;
+	size_t active = 0;      //running trajectories occupy slots [0, active)
+	std::vector<long long> first_steps;     //by index, clock step the trajectory was added at
+
+	//per slot, padded to whole SIMD vectors
+	std::vector<float> xs, ys;
+	std::vector<int> ids;
+	std::vector<long long> end_steps;
+
+	std::vector<Scratch> scratch;           //by participant
+
+	EventSet* events = nullptr;             //terminal ones only, or nullptr
+	std::vector<std::unique_ptr<EventSet>> event_copies;    //for the other participants of a parallel advance
+	std::vector<size_t> survivors;          //by tile, during advance
+};
@@ -0,0 +1,154 @@
+#include "EquationCache.h"
+
+#include <cctype>
+#include <chrono>
+
+//symbols every context registers, part of the key along with the parameter names
+static const char* symbol_set = "x,y,t";
+
+EquationCache::EquationCache(size_t capacity) : capacity(capacity < 2 ? 2 : capacity) {}
+
+//part of an identifier or a number, whitespace between two of these separates tokens
+static bool word_char(char c) {
+	return std::isalnum((unsigned char)c) || c == '_' || c == '.';
+}
+
+std::string EquationCache::normalize(const std::string& equation) {
+	std::string out;
+	out.reserve(equation.size());
+	bool space = false;
+	for (char c : equation) {
+		if (std::isspace((unsigned char)c)) {
+			space = true;
+			continue;
+		}
+		//"k x" and "kx" are different expressions, "k * x" and "k*x" are not
+		if (space && !out.empty() && word_char(out.back()) && word_char(c))
+			out.push_back(' ');
+		space = false;
+		out.push_back((char)std::tolower((unsigned char)c));
+	}
+	return out;
+}
+
+std::string EquationCache::make_key(const std::string& equation_x, const std::string& equation_y,
+	const std::vector<std::string>& parameters) {
+	std::string key = normalize(equation_x);
+	key += '\n';
+	key += normalize(equation_y);
+	key += '\n';
+	key += symbol_set;
+	for (const std::string& name : parameters) {
+		key += ',';
+		key += normalize(name);
+	}
+	return key;
+}
+
+void EquationCache::touch(Entry* entry, const std::string& equation_x, const std::string& equation_y,
+	const std::vector<std::string>& parameters) {
+	entry->last_used = tick;
+	last_x = equation_x;
+	last_y = equation_y;
+	last_parameters = parameters;
+	last_entry = entry;
+}
+
+EvalContext* EquationCache::find(const std::string& equation_x, const std::string& equation_y,
+	const std::vector<std::string>& parameters) {
+	tick++;
+
+	if (last_entry && equation_x == last_x && equation_y == last_y && parameters == last_parameters) {
+		counters.hits++;
+		last_entry->last_used = tick;
+		return last_entry->context.get();
+	}
+
+	auto found = entries.find(make_key(equation_x, equation_y, parameters));
+	if (found == entries.end())
+		return nullptr;
+
+	counters.hits++;
+	touch(&found->second, equation_x, equation_y, parameters);
+	return found->second.context.get();
+}
+
+EvalContext& EquationCache::get(const std::string& equation_x, const std::string& equation_y,
+	const std::vector<std::string>& parameters) {
+	EvalContext* cached = find(equation_x, equation_y, parameters);
+	if (cached)
+		return *cached;
+
+	std::unique_ptr<EvalContext> context(new EvalContext());
+	auto start = std::chrono::steady_clock::now();
+	compile(*context, equation_x, equation_y, parameters);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	return adopt(equation_x, equation_y, parameters, std::move(context), elapsed.count());
+}
+
+EvalContext& EquationCache::adopt(const std::string& equation_x, const std::string& equation_y,
+	const std::vector<std::string>& parameters, std::unique_ptr<EvalContext> context, double compile_ms) {
+	counters.misses++;
+	counters.last_compile_ms = compile_ms;
+	counters.compile_ms += compile_ms;
+
+	std::string key = make_key(equation_x, equation_y, parameters);
+	if (entries.find(key) == entries.end() && entries.size() >= capacity)
+		evict();
+
+	//the old context may still be drawn with, the active system or a path or worker bound to it
+	Entry* entry = &entries[key];
+	if (entry->context)
+		retired.push_back(std::move(entry->context));
+	entry->context = std::move(context);
+	tick++;
+	touch(entry, equation_x, equation_y, parameters);
+	return *entry->context;
+}
+
+//static so a worker thread can build contexts without touching the cache
+void EquationCache::compile(EvalContext& context, const std::string& equation_x, const std::string& equation_y,
+	const std::vector<std::string>& parameters) {
+	for (const std::string& name : parameters)
+		context.add_parameter(name);
+	context.compile(equation_x, equation_y);
+}
+
+void EquationCache::set_active(const EvalContext* context) {
+	active = context;
+	for (size_t i = 0; i < retired.size();) {
+		if (retired[i].get() == active) {
+			i++;
+			continue;
+		}
+		retired[i] = std::move(retired.back());
+		retired.pop_back();
+	}
+}
+
+//drops the least recently used entry, never the one handed out last frame or the active one
+void EquationCache::evict() {
+	auto oldest = entries.end();
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		if (&it->second == last_entry || it->second.context.get() == active)
+			continue;
+		if (oldest == entries.end() || it->second.last_used < oldest->second.last_used)
+			oldest = it;
+	}
+	if (oldest == entries.end())
+		return;
+	entries.erase(oldest);
+	counters.evictions++;
+}
+
+void EquationCache::clear() {
+	for (auto& entry : entries) {
+		if (entry.second.context.get() == active)
+			retired.push_back(std::move(entry.second.context));
+	}
+	entries.clear();
+	last_entry = nullptr;
+	last_x.clear();
+	last_y.clear();
+	last_parameters.clear();
+}
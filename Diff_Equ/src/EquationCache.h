@@ -0,0 +1,75 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "EvalContext.h"
+
+struct EquationCacheStats {
+	unsigned long long hits = 0;
+	unsigned long long misses = 0;
+	unsigned long long evictions = 0;
+	double compile_ms = 0.0;        //total time spent inside the parser
+	double last_compile_ms = 0.0;
+};
+
+//maps normalized equation text to compiled contexts so the parser only runs when an input changes
+class EquationCache {
+public:
+	explicit EquationCache(size_t capacity = 64);
+
+	//parameters are registered on the context before compiling and are part of the key
+	EvalContext& get(const std::string& equation_x, const std::string& equation_y,
+		const std::vector<std::string>& parameters = std::vector<std::string>());
+
+	//lookup only, nullptr on a miss so the caller can compile somewhere else
+	EvalContext* find(const std::string& equation_x, const std::string& equation_y,
+		const std::vector<std::string>& parameters = std::vector<std::string>());
+	//takes ownership of a context compiled elsewhere (counted as a miss), replacing any entry with the same key.
+	//a replaced context is retired rather than destroyed, see set_active()
+	EvalContext& adopt(const std::string& equation_x, const std::string& equation_y,
+		const std::vector<std::string>& parameters, std::unique_ptr<EvalContext> context, double compile_ms);
+
+	//what get() does on a miss, safe to call from any thread
+	static void compile(EvalContext& context, const std::string& equation_x, const std::string& equation_y,
+		const std::vector<std::string>& parameters);
+
+	//the context the caller evaluates through. it is never evicted, and contexts retired by adopt() are
+	//destroyed here once they are not the active one, so call it before anything that can swap the
+	//active context and after everything bound to the previous one has let go
+	void set_active(const EvalContext* context);
+
+	const EquationCacheStats& stats() const { return counters; }
+	size_t size() const { return entries.size(); }
+	void clear();
+
+	//lowercases, exprtk symbols are case insensitive, and drops whitespace except a single space between
+	//two identifier or number characters
+	static std::string normalize(const std::string& equation);
+
+private:
+	struct Entry {
+		std::unique_ptr<EvalContext> context;
+		unsigned long long last_used = 0;
+	};
+
+	static std::string make_key(const std::string& equation_x, const std::string& equation_y,
+		const std::vector<std::string>& parameters);
+	void touch(Entry* entry, const std::string& equation_x, const std::string& equation_y,
+		const std::vector<std::string>& parameters);
+	void evict();
+
+	size_t capacity;
+	unsigned long long tick = 0;
+	const EvalContext* active = nullptr;
+	std::vector<std::unique_ptr<EvalContext>> retired;
+	std::unordered_map<std::string, Entry> entries;
+	EquationCacheStats counters;
+
+	//raw text of the previous lookup, lets steady-state frames skip normalizing
+	std::string last_x;
+	std::string last_y;
+	std::vector<std::string> last_parameters;
+	Entry* last_entry = nullptr;
+};
@@ -0,0 +1,392 @@
+#include "EvalContext.h"
+
+#include <atomic>
+#include <cctype>
+#include <cmath>
+
+#include "Differentiate.h"
+#include "ExprBuilder.h"
+
+//scalar register files and uniforms are small heap blocks, a cache line of slack after them keeps two
+//contexts' blocks from ever sharing a line
+static const size_t line_floats = 64 / sizeof(float);
+
+//contexts compile and clone on several threads
+static unsigned long long next_generation() {
+	static std::atomic<unsigned long long> generations(0);
+	return ++generations;
+}
+
+EvalContext::EvalContext() : native(std::make_shared<NativeModule>()) {
+	symbol_table.add_variable("x", x);
+	symbol_table.add_variable("y", y);
+	symbol_table.add_variable("t", t);
+	symbol_table.add_constants();
+
+	expression_x.register_symbol_table(symbol_table);
+	expression_y.register_symbol_table(symbol_table);
+}
+
+float& EvalContext::add_parameter(const std::string& name, float value) {
+	float* existing = parameter(name);
+	if (existing) {
+		*existing = value;
+		return *existing;
+	}
+
+	values.push_back(value);
+	names.push_back(name);
+	symbol_table.add_variable(name, values.back());
+	return values.back();
+}
+
+float* EvalContext::parameter(const std::string& name) {
+	for (size_t i = 0; i < names.size(); i++) {
+		if (names[i] == name)
+			return &values[i];
+	}
+	return nullptr;
+}
+
+//free symbols other than x, y, t, the built-in constants and parameters already added,
+//registered as parameters starting at 1 so a fresh system is not degenerate
+void EvalContext::detect_parameters(const std::string& equation) {
+	std::vector<std::string> found;
+	if (!exprtk::collect_variables(equation, symbol_table, found))
+		return;
+
+	for (const std::string& symbol : found) {
+		std::string name;
+		for (char c : symbol)
+			name.push_back((char)std::tolower((unsigned char)c));
+		if (symbol_table.symbol_exists(name))
+			continue;
+		add_parameter(name, 1.0f);
+	}
+}
+
+bool EvalContext::compile(const std::string& equation_x, const std::string& equation_y) {
+	detect_parameters(equation_x);
+	detect_parameters(equation_y);
+
+	compile_generation = next_generation();
+	source_x = equation_x;
+	source_y = equation_y;
+
+	exprtk::parser<float> parser;
+
+	compiled = parser.compile(equation_x, expression_x);
+	if (compiled)
+		compiled = parser.compile(equation_y, expression_y);
+	has_expressions = compiled;
+
+	error_message = compiled ? std::string() : parser.error();
+
+	use_program = false;
+	shared_nodes = 0;
+	jacobian_program = Program();
+	taylor_program = TaylorProgram();
+	separable_system = false;
+	//clones may still run the old code
+	native = std::make_shared<NativeModule>();
+	native_tried = false;
+	if (compiled)
+		lower(equation_x, equation_y);
+	return compiled;
+}
+
+bool EvalContext::compile_copy(const EvalContext& source) {
+	for (size_t i = 0; i < source.names.size(); i++)
+		add_parameter(source.names[i], source.values[i]);
+	if (!compile(source.source_x, source.source_y))
+		return false;
+	if (source.has_native())
+		compile_native();
+	native_enabled = source.native_enabled;
+	return true;
+}
+
+bool EvalContext::clone_from(const EvalContext& source) {
+	if (!source.use_program)
+		return compile_copy(source);
+
+	for (size_t i = 0; i < source.names.size(); i++)
+		add_parameter(source.names[i], source.values[i]);
+	compile_generation = next_generation();
+	source_x = source.source_x;
+	source_y = source.source_y;
+	compiled = true;
+	has_expressions = false;
+	error_message.clear();
+
+	program = source.program;
+	jacobian_program = source.jacobian_program;
+	taylor_program = source.taylor_program;
+	registers = source.registers;
+	registers.reserve(registers.size() + line_floats);
+	uniforms.reserve(1 + values.size() + line_floats);
+	batch.bind(program);
+	use_program = true;
+	shared_nodes = source.shared_nodes;
+	separable_system = source.separable_system;
+	lowering_message = source.lowering_message;
+
+	native = source.native;
+	native_tried = source.native_tried;
+	native_enabled = source.native_enabled;
+	return true;
+}
+
+void EvalContext::copy_parameters(const EvalContext& source) {
+	size_t count = values.size() < source.values.size() ? values.size() : source.values.size();
+	for (size_t i = 0; i < count; i++)
+		values[i] = source.values[i];
+}
+
+//parses the same text into our own tree and lowers it to bytecode,
+//anything outside the supported subset just keeps evaluating through exprtk
+void EvalContext::lower(const std::string& equation_x, const std::string& equation_y) {
+	std::vector<std::string> symbols = { "x", "y", "t" };
+	for (const std::string& name : names) {
+		std::string lowered;
+		for (char c : name)
+			lowered.push_back((char)std::tolower((unsigned char)c));
+		symbols.push_back(lowered);
+	}
+
+	ExprTree parsed;
+	int parsed_x = parse_expression(equation_x, symbols, parsed, lowering_message);
+	int parsed_y = parsed_x < 0 ? -1 : parse_expression(equation_y, symbols, parsed, lowering_message);
+	if (parsed_x < 0 || parsed_y < 0)
+		return;
+
+	//hash-conses both equations into one pool, a term shared by dx and dy is evaluated once per state.
+	//only exact rewrites here, the result has to match exprtk for inf and NaN too
+	ExprTree tree;
+	ExprBuilder pool(tree, false);
+	std::vector<int> roots = pool.import(parsed, { parsed_x, parsed_y });
+	int root_x = roots[0];
+	int root_y = roots[1];
+
+	//the pooled program is only kept when sharing removed instructions. when nothing repeats (only
+	//leaves and constants, which cost no instruction) it is the same work and the equations lower as written
+	if (!program.lower(tree, roots, (int)symbols.size())) {
+		lowering_message = "expression too large for bytecode";
+		return;
+	}
+	shared_nodes = pool.imported - (int)tree.nodes.size();
+	Program unshared;
+	if (unshared.lower(parsed, { parsed_x, parsed_y }, (int)symbols.size()) && unshared.code.size() <= program.code.size()) {
+		program = unshared;
+		shared_nodes = 0;
+	}
+
+	registers.assign(program.num_registers, 0.0f);
+	registers.reserve(program.num_registers + line_floats);
+	uniforms.reserve(1 + values.size() + line_floats);
+	program.init_registers(registers.data());
+	batch.bind(program);
+
+	use_program = verify_program();
+	if (!use_program) {
+		lowering_message = "bytecode disagrees with exprtk";
+		return;
+	}
+
+	//derivative nodes go into the same tree and reuse the equations' subexpressions
+	ExprBuilder builder(tree);
+	std::vector<int> jacobian_roots = build_jacobian(builder, root_x, root_y);
+	separable_system = builder.is_constant(jacobian_roots[0], 0.0) && builder.is_constant(jacobian_roots[3], 0.0);
+	if (!jacobian_program.lower(tree, jacobian_roots, (int)symbols.size()))
+		jacobian_program = Program();
+	if (!taylor_program.build(tree, roots, (int)symbols.size()))
+		taylor_program = TaylorProgram();
+}
+
+void EvalContext::eval_batch(float time, const float* xs, const float* ys, float* dxs, float* dys, size_t count) {
+	if (native_active()) {
+		eval_native_batch(time, xs, ys, dxs, dys, count);
+		return;
+	}
+
+	if (!use_program) {
+		for (size_t i = 0; i < count; i++)
+			eval(time, xs[i], ys[i], dxs[i], dys[i]);
+		return;
+	}
+
+	eval_lanes(time, xs, ys, dxs, dys, count);
+}
+
+void EvalContext::eval_native_batch(float time, const float* xs, const float* ys, float* dxs, float* dys, size_t count) {
+	uniforms.resize(1 + values.size());
+	uniforms[0] = time;
+	for (size_t i = 0; i < values.size(); i++)
+		uniforms[1 + i] = values[i];
+	native->eval_batch(xs, ys, uniforms.data(), dxs, dys, count);
+}
+
+void EvalContext::eval_lanes(float time, const float* xs, const float* ys, float* dxs, float* dys, size_t count) {
+	batch.set_uniform(2, time);
+	for (size_t i = 0; i < values.size(); i++)
+		batch.set_uniform(3 + (int)i, values[i]);
+	batch.eval(xs, ys, dxs, dys, count);
+}
+
+bool EvalContext::compile_native() {
+	if (native_tried)
+		return native->loaded();
+	native_tried = true;
+
+	if (!use_program || !native->load(program))
+		return false;
+	if (!verify_native()) {
+		native->unload();
+		return false;
+	}
+	return true;
+}
+
+static bool same_value(float a, float b) {
+	if (std::isnan(a) || std::isnan(b))
+		return std::isnan(a) && std::isnan(b);
+	if (std::isinf(a) || std::isinf(b))
+		return a == b;
+	return std::fabs(a - b) <= 1e-4f * std::fmax(1.0f, std::fmax(std::fabs(a), std::fabs(b)));
+}
+
+static const float verify_samples[][3] = {
+	{ 0.5f, -1.25f, 0.3f }, { 2.0f, 3.0f, 1.0f }, { -1.7f, 0.4f, 2.5f }, { 0.0f, 0.0f, 0.0f }, { -3.1f, -2.2f, 7.0f }
+};
+
+//the vector field's grid in Application.cpp, which is sampled at t = 0 through eval_batch()
+static const int verify_grid = 24;
+static const int verify_points = verify_grid * verify_grid;
+
+static void fill_verify_grid(float* xs, float* ys) {
+	const float spacing = 2.0f / verify_grid;
+	for (int i = 0; i < verify_points; i++) {
+		xs[i] = -1.0f + spacing * (0.5f + i % verify_grid);
+		ys[i] = -1.0f + spacing * (0.5f + i / verify_grid);
+	}
+}
+
+//how far float rounding alone can move each output at (x, y, t = 0): the program in double with x and y
+//nudged by a few float ulps. terms that cancel, like robertson's 1e4 y (1 - x - y) along x + y = 1, leave
+//exprtk and the fused bytecode legitimately apart there, by far more than a relative 1e-4
+static void rounding_slack(const Program& program, std::vector<double>& inputs, std::vector<double>& registers,
+	float& slack_x, float& slack_y) {
+	const double nudge = 4.0 * 1.1920929e-7;
+	double base[2], moved[2];
+	program.eval(inputs.data(), base, registers.data());
+	double most_x = 0.0, most_y = 0.0;
+	for (int k = 0; k < 4; k++) {
+		double saved = inputs[k / 2];
+		inputs[k / 2] = saved * ((k & 1) ? 1.0 + nudge : 1.0 - nudge);
+		program.eval(inputs.data(), moved, registers.data());
+		inputs[k / 2] = saved;
+		most_x = std::fmax(most_x, std::fabs(moved[0] - base[0]));
+		most_y = std::fmax(most_y, std::fabs(moved[1] - base[1]));
+	}
+	slack_x = (float)(2.0 * most_x);
+	slack_y = (float)(2.0 * most_y);
+}
+
+//whether a batch result over the verify grid matches exprtk at every point, up to the rounding each point
+//allows. leaves x, y, t as they were
+bool EvalContext::grid_matches(const float* xs, const float* ys, const float* dxs, const float* dys) {
+	std::vector<double> inputs(program.num_inputs, 0.0);
+	std::vector<double> reference(program.num_registers, 0.0);
+	program.init_registers(reference.data());
+	for (size_t i = 0; i < values.size(); i++)
+		inputs[3 + i] = values[i];
+
+	float saved_x = x, saved_y = y, saved_t = t;
+	bool agree = true;
+	for (int i = 0; i < verify_points && agree; i++) {
+		float tree_x, tree_y;
+		eval(0.0f, xs[i], ys[i], tree_x, tree_y);
+		if (same_value(tree_x, dxs[i]) && same_value(tree_y, dys[i]))
+			continue;
+		inputs[0] = xs[i];
+		inputs[1] = ys[i];
+		float slack_x, slack_y;
+		rounding_slack(program, inputs, reference, slack_x, slack_y);
+		agree = (same_value(tree_x, dxs[i]) || std::fabs(tree_x - dxs[i]) <= slack_x) &&
+			(same_value(tree_y, dys[i]) || std::fabs(tree_y - dys[i]) <= slack_y);
+	}
+	set_state(saved_t, saved_x, saved_y);
+	return agree;
+}
+
+//checks the bytecode against exprtk so a grammar mismatch can never change results: the spot samples
+//through the scalar interpreter, then the field's whole grid through both the interpreter and the lanes,
+//whose math can round differently from the scalar calls
+bool EvalContext::verify_program() {
+	float saved_x = x, saved_y = y, saved_t = t;
+	bool agree = true;
+	for (const float* s : verify_samples) {
+		float tree_x, tree_y, vm_x, vm_y;
+		eval(s[2], s[0], s[1], tree_x, tree_y);
+		eval_bytecode(s[2], s[0], s[1], vm_x, vm_y);
+		if (!same_value(tree_x, vm_x) || !same_value(tree_y, vm_y))
+			agree = false;
+	}
+	set_state(saved_t, saved_x, saved_y);
+	if (!agree)
+		return false;
+
+	float xs[verify_points], ys[verify_points], dxs[verify_points], dys[verify_points];
+	fill_verify_grid(xs, ys);
+	for (int i = 0; i < verify_points; i++)
+		eval_bytecode(0.0f, xs[i], ys[i], dxs[i], dys[i]);
+	if (!grid_matches(xs, ys, dxs, dys))
+		return false;
+	eval_lanes(0.0f, xs, ys, dxs, dys, verify_points);
+	return grid_matches(xs, ys, dxs, dys);
+}
+
+//the generated C goes through a different compiler and libm, so it gets the same checks, the grid going
+//through the batch entry point the field calls
+bool EvalContext::verify_native() {
+	float saved_x = x, saved_y = y, saved_t = t;
+	bool agree = true;
+	for (const float* s : verify_samples) {
+		float tree_x, tree_y, native_x, native_y;
+		eval(s[2], s[0], s[1], tree_x, tree_y);
+		eval_native(s[2], s[0], s[1], native_x, native_y);
+		if (!same_value(tree_x, native_x) || !same_value(tree_y, native_y))
+			agree = false;
+	}
+	set_state(saved_t, saved_x, saved_y);
+	if (agree) {
+		float xs[verify_points], ys[verify_points], dxs[verify_points], dys[verify_points];
+		fill_verify_grid(xs, ys);
+		eval_native_batch(0.0f, xs, ys, dxs, dys, verify_points);
+		agree = grid_matches(xs, ys, dxs, dys);
+	}
+	if (!agree)
+		lowering_message = "native code disagrees with exprtk";
+	return agree;
+}
+
+static void add_lines(std::vector<uintptr_t>& lines, const void* begin, size_t bytes) {
+	if (bytes == 0)
+		return;
+	uintptr_t first = (uintptr_t)begin / 64;
+	uintptr_t last = ((uintptr_t)begin + bytes - 1) / 64;
+	for (uintptr_t line = first; line <= last; line++)
+		lines.push_back(line);
+}
+
+void EvalContext::written_lines(std::vector<uintptr_t>& lines) const {
+	add_lines(lines, &x, sizeof(float));
+	add_lines(lines, &y, sizeof(float));
+	add_lines(lines, &t, sizeof(float));
+	add_lines(lines, registers.data(), registers.size() * sizeof(float));
+	add_lines(lines, uniforms.data(), (1 + values.size()) * sizeof(float));
+	float* lanes = nullptr;
+	size_t count = 0;
+	batch.register_lanes(lanes, count);
+	add_lines(lines, lanes, count * sizeof(float));
+}
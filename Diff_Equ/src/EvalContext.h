@@ -0,0 +1,176 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "exprtk.hpp"
+#include "BatchEval.h"
+#include "Bytecode.h"
+#include "NativeModule.h"
+#include "TaylorSeries.h"
+
+//owns the state variables and the compiled dx/dy expressions bound to them,
+//integrators write into x, y, t (and parameters) then call dx()/dy() with no re-registration
+class EvalContext {
+public:
+	EvalContext();
+	EvalContext(const EvalContext&) = delete;
+	EvalContext& operator=(const EvalContext&) = delete;
+
+	//parameters have to be added before compile, the returned slot stays valid for the context's lifetime
+	float& add_parameter(const std::string& name, float value = 0.0f);
+	float* parameter(const std::string& name);
+	const std::vector<std::string>& parameter_names() const { return names; }
+
+	//symbols other than x, y, t that were never added become parameters, so sliders can drive them
+	bool compile(const std::string& equation_x, const std::string& equation_y);
+	bool ok() const { return compiled; }
+	const std::string& error() const { return error_message; }
+
+	//another instance of a compiled system for a different thread: the same parameters at their current
+	//values, the same text, native code again when source has it (a hit in the library cache)
+	bool compile_copy(const EvalContext& source);
+	//the same thing without the parser, into a fresh context. a system that lowered has its programs copied
+	//and its native code shared, and the clone has no exprtk expressions: eval() runs the bytecode, dx()
+	//and dy() are unavailable. one that did not lower falls back to compile_copy()
+	bool clone_from(const EvalContext& source);
+	bool parsed() const { return has_expressions; }
+	//parameter values from the context this one was copied from, slot for slot
+	void copy_parameters(const EvalContext& source);
+	//changes on every compile(), tells copies apart from a recompiled or replaced source
+	unsigned long long generation() const { return compile_generation; }
+
+	void set_state(float time, float pos_x, float pos_y) {
+		t = time;
+		x = pos_x;
+		y = pos_y;
+	}
+
+	//tree-walking exprtk evaluation at the bound state, only when parsed()
+	float dx() const { return expression_x.value(); }
+	float dy() const { return expression_y.value(); }
+
+	void eval(float time, float pos_x, float pos_y, float& out_x, float& out_y) {
+		if (!has_expressions) {
+			eval_bytecode(time, pos_x, pos_y, out_x, out_y);
+			return;
+		}
+		set_state(time, pos_x, pos_y);
+		out_x = expression_x.value();
+		out_y = expression_y.value();
+	}
+
+	//same result through the register bytecode, only valid when has_program()
+	void eval_bytecode(float time, float pos_x, float pos_y, float& out_x, float& out_y) {
+		float* r = registers.data();
+		r[0] = pos_x;
+		r[1] = pos_y;
+		r[2] = time;
+		for (size_t i = 0; i < values.size(); i++)
+			r[3 + i] = values[i];
+		program.run(r);
+		out_x = r[program.outputs[0]];
+		out_y = r[program.outputs[1]];
+	}
+
+	//same result through the natively compiled program, only valid when has_native()
+	void eval_native(float time, float pos_x, float pos_y, float& out_x, float& out_y) {
+		float* r = registers.data();
+		r[0] = pos_x;
+		r[1] = pos_y;
+		r[2] = time;
+		for (size_t i = 0; i < values.size(); i++)
+			r[3 + i] = values[i];
+		float out[2];
+		native->eval(r, out);
+		out_x = out[0];
+		out_y = out[1];
+	}
+
+	//evaluates count states at time t, structure-of-arrays in and out,
+	//native code when loaded and enabled, otherwise SIMD lanes when the equations lowered
+	void eval_batch(float time, const float* xs, const float* ys, float* dxs, float* dys, size_t count);
+
+	bool has_program() const { return use_program; }
+	//one program computing both equations, outputs[0] is dx and outputs[1] is dy
+	const Program& bytecode() const { return program; }
+	const std::string& lowering_error() const { return lowering_message; }
+	//parsed nodes that collapsed into an identical subtree of either equation, 0 when that saved no
+	//instruction and the program was lowered without sharing
+	int eliminated_nodes() const { return shared_nodes; }
+
+	//symbolic Jacobian of the lowered equations, four outputs row major:
+	//d(dx)/dx, d(dx)/dy, d(dy)/dx, d(dy)/dy. only built when has_program()
+	bool has_jacobian() const { return use_program && !jacobian_program.empty(); }
+	const Program& jacobian_bytecode() const { return jacobian_program; }
+	//dx depends only on y and t and dy only on x and t, so the system is H = T(y) + V(x)
+	//and the symplectic methods apply. known once the Jacobian is built
+	bool separable() const { return separable_system; }
+
+	//Taylor coefficient recurrences of the lowered equations for the series integrator, only when has_program()
+	bool has_taylor() const { return use_program && !taylor_program.empty(); }
+	const TaylorProgram& taylor_series() const { return taylor_program; }
+
+	//builds the lowered program with the system C compiler, blocking. only tried once per compile(),
+	//false leaves evaluation on the interpreter with the reason in native_module().error()
+	bool compile_native();
+	bool has_native() const { return native->loaded(); }
+	//whether eval_batch() dispatches to loaded native code, the library stays loaded either way so turning
+	//it back on is free. clones start with their source's setting
+	void enable_native(bool enabled) { native_enabled = enabled; }
+	bool native_allowed() const { return native_enabled; }
+	bool native_active() const { return native_enabled && native->loaded(); }
+	bool native_attempted() const { return native_tried; }
+	const NativeModule& native_module() const { return *native; }
+
+	//cache lines that evaluating through this context writes, so copies on different threads can be
+	//checked for false sharing
+	void written_lines(std::vector<uintptr_t>& lines) const;
+
+	//bound state slots
+	float x = 0.0f;
+	float y = 0.0f;
+	float t = 0.0f;
+
+private:
+	void detect_parameters(const std::string& equation);
+	void lower(const std::string& equation_x, const std::string& equation_y);
+	bool verify_program();
+	bool verify_native();
+	bool grid_matches(const float* xs, const float* ys, const float* dxs, const float* dys);
+	void eval_native_batch(float time, const float* xs, const float* ys, float* dxs, float* dys, size_t count);
+	void eval_lanes(float time, const float* xs, const float* ys, float* dxs, float* dys, size_t count);
+
+	exprtk::symbol_table<float> symbol_table;
+	exprtk::expression<float> expression_x;
+	exprtk::expression<float> expression_y;
+
+	//deque so slot addresses survive later add_parameter calls
+	std::deque<float> values;
+	std::vector<std::string> names;
+
+	bool compiled = false;
+	bool has_expressions = false;
+	std::string error_message;
+	std::string source_x;
+	std::string source_y;
+	unsigned long long compile_generation = 0;
+
+	Program program;
+	Program jacobian_program;
+	TaylorProgram taylor_program;
+	std::vector<float> registers;
+	BatchEvaluator batch;
+	bool use_program = false;
+	int shared_nodes = 0;
+	bool separable_system = false;
+	std::string lowering_message;
+
+	//shared with clones, the generated code holds no state
+	std::shared_ptr<NativeModule> native;
+	bool native_tried = false;
+	bool native_enabled = true;
+	std::vector<float> uniforms;    //t then the parameters, for the native batch entry point
+};
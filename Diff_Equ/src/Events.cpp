@@ -0,0 +1,55 @@
+#include "Events.h"
+
+bool EventSet::compile(const std::vector<EventSpec>& events) {
+	specs.clear();
+	functions.clear();
+	error_message.clear();
+	compile_generation++;
+
+	for (size_t i = 0; i < events.size(); i++) {
+		std::unique_ptr<EvalContext> function(new EvalContext());
+		if (!function->compile(events[i].expression, "0")) {
+			error_message = "event " + std::to_string(i + 1) + ": " + function->error();
+			specs.clear();
+			functions.clear();
+			return false;
+		}
+		specs.push_back(events[i]);
+		functions.push_back(std::move(function));
+	}
+	return true;
+}
+
+void EventSet::clone_from(const EventSet& source) {
+	specs = source.specs;
+	functions.clear();
+	for (const std::unique_ptr<EvalContext>& function : source.functions) {
+		functions.emplace_back(new EvalContext());
+		functions.back()->clone_from(*function);
+	}
+	error_message = source.error_message;
+	compile_generation = source.compile_generation;
+}
+
+void EventSet::bind_parameters(EvalContext& system) {
+	for (std::unique_ptr<EvalContext>& function : functions) {
+		for (const std::string& name : function->parameter_names()) {
+			const float* value = system.parameter(name);
+			if (value)
+				*function->parameter(name) = *value;
+		}
+	}
+}
+
+void EventSet::copy_parameters(const EventSet& source) {
+	for (size_t i = 0; i < functions.size() && i < source.functions.size(); i++)
+		functions[i]->copy_parameters(*source.functions[i]);
+}
+
+bool EventSet::any_terminal() const {
+	for (const EventSpec& spec : specs) {
+		if (spec.terminal)
+			return true;
+	}
+	return false;
+}
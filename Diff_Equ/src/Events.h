@@ -0,0 +1,171 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EvalContext.h"
+#include "SystemEval.h"
+
+//a user event, fires where g(t, x, y) changes sign
+struct EventSpec {
+	std::string expression;
+	int direction = 0;          //+1 only rising crossings (g going up through 0), -1 only falling, 0 both
+	bool terminal = false;      //the trajectory stops at the crossing
+};
+
+template <typename T>
+struct EventHit {
+	int event;
+	T t;
+	T x;
+	T y;
+};
+
+//compiled event functions. each is an EvalContext of its own with g in the dx slot, so it lowers, batches
+//and clones like any system. symbols other than x, y, t become parameters, and bind_parameters() gives
+//the ones named like a system parameter that parameter's value
+class EventSet {
+public:
+	EventSet() {}
+	EventSet(const EventSet&) = delete;
+	EventSet& operator=(const EventSet&) = delete;
+
+	//false with error() naming the event that failed, the set is then empty
+	bool compile(const std::vector<EventSpec>& events);
+	//cheap copy for another thread, see EvalContext::clone_from
+	void clone_from(const EventSet& source);
+	//values of the system's parameters, before every run since sliders move them
+	void bind_parameters(EvalContext& system);
+	//parameter values of the set this one was cloned from
+	void copy_parameters(const EventSet& source);
+
+	size_t size() const { return specs.size(); }
+	bool empty() const { return specs.empty(); }
+	bool any_terminal() const;
+	const EventSpec& spec(size_t i) const { return specs[i]; }
+	EvalContext& function(size_t i) { return *functions[i]; }
+	const std::string& error() const { return error_message; }
+	//changes with every compile(), copies compare it to their source's
+	unsigned long long generation() const { return compile_generation; }
+
+	//going from before to after is a crossing in the event's direction. a g that is exactly 0 at the start
+	//of a step was already reported by the step that ended there
+	bool crosses(size_t i, double before, double after) const {
+		int direction = specs[i].direction;
+		bool rising = before < 0.0 && after >= 0.0;
+		bool falling = before > 0.0 && after <= 0.0;
+		return (direction >= 0 && rising) || (direction <= 0 && falling);
+	}
+
+private:
+	std::vector<EventSpec> specs;
+	std::vector<std::unique_ptr<EvalContext>> functions;
+	std::string error_message;
+	unsigned long long compile_generation = 0;
+};
+
+//checks every event after each accepted step of an adaptive solver and locates crossings on the solver's
+//dense output with the Illinois variant of regula falsi, so a crossing costs a few interpolations and event
+//evaluations but no extra steps. g is evaluated in T through the bytecode. a sign change is only seen
+//between the ends of a step, two crossings inside one step cancel
+template <typename T, typename Solver>
+class EventTracker {
+public:
+	static const int max_iterations = 60;
+
+	explicit EventTracker(EventSet& events) : events(events) {
+		for (size_t i = 0; i < events.size(); i++)
+			functions.push_back(SystemEval<T>(events.function(i)));
+		values.resize(events.size());
+	}
+
+	void start(T t0, T x0, T y0) {
+		hits.clear();
+		stopped = false;
+		for (size_t i = 0; i < values.size(); i++)
+			values[i] = g(i, t0, x0, y0);
+	}
+
+	//after an accepted step, appends the step's crossings in time order. true when a terminal one fired,
+	//stop then holds it and the trajectory should end there; later crossings of the step are dropped
+	bool check(const Solver& solver) {
+		size_t first = hits.size();
+		for (size_t i = 0; i < values.size(); i++) {
+			T after = g(i, solver.t, solver.x, solver.y);
+			if (events.crosses(i, (double)values[i], (double)after)) {
+				EventHit<T> hit;
+				hit.event = (int)i;
+				hit.t = locate(i, solver, solver.previous_t, values[i], solver.t, after);
+				solver.dense(hit.t, hit.x, hit.y);
+				hits.push_back(hit);
+			}
+			values[i] = after;
+		}
+		std::sort(hits.begin() + first, hits.end(), [](const EventHit<T>& a, const EventHit<T>& b) { return a.t < b.t; });
+
+		for (size_t k = first; k < hits.size(); k++) {
+			if (!events.spec(hits[k].event).terminal)
+				continue;
+			stop = hits[k];
+			stopped = true;
+			hits.resize(k + 1);
+			return true;
+		}
+		return false;
+	}
+
+	std::vector<EventHit<T>> hits;
+	bool stopped = false;
+	EventHit<T> stop = EventHit<T>();
+	unsigned long long evaluations = 0;     //event function evaluations, root finding included
+
+private:
+	T g(size_t i, T time, T pos_x, T pos_y) {
+		evaluations++;
+		T value, unused;
+		functions[i](time, pos_x, pos_y, value, unused);
+		return value;
+	}
+
+	//root of g along the dense output in [a, b] where g(a) = ga and g(b) = gb differ in sign. returns the end
+	//of the final bracket on b's side, so g has already crossed and the same event cannot fire again at once
+	T locate(size_t i, const Solver& solver, T a, T ga, T b, T gb) {
+		using std::fabs;
+		const double epsilon = sizeof(T) == sizeof(float) ? 1.2e-7 : (sizeof(T) == sizeof(double) ? 2.2e-16 : 1e-30);
+		int kept = 0;   //which end stayed put last time, a repeat halves its value (Illinois)
+		for (int k = 0; k < max_iterations; k++) {
+			double scale = std::fmax(std::fabs((double)a), std::fabs((double)b));
+			if ((double)(b - a) <= 4.0 * epsilon * (scale > 1.0 ? scale : 1.0))
+				break;
+			T c = a + (b - a) * (ga / (ga - gb));
+			if (!(c > a && c < b))
+				c = a + (b - a) * T(0.5);
+			T cx, cy;
+			solver.dense(c, cx, cy);
+			T gc = g(i, c, cx, cy);
+			if (gc == T(0))
+				return c;
+			if ((gc > T(0)) == (gb > T(0))) {
+				b = c;
+				gb = gc;
+				if (kept == -1)
+					ga = ga * T(0.5);
+				kept = -1;
+			}
+			else {
+				a = c;
+				ga = gc;
+				if (kept == 1)
+					gb = gb * T(0.5);
+				kept = 1;
+			}
+		}
+		return b;
+	}
+
+	EventSet& events;
+	std::vector<SystemEval<T>> functions;
+	std::vector<T> values;      //g of every event at the end of the last step
+};
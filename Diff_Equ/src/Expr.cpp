@@ -0,0 +1,379 @@
+#include "Expr.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <limits>
+
+int ExprTree::add(ExprOp op, int a, int b, int c) {
+	ExprNode node;
+	node.op = op;
+	node.a = a;
+	node.b = b;
+	node.c = c;
+	node.value = 0.0;
+	node.slot = -1;
+	nodes.push_back(node);
+	return (int)nodes.size() - 1;
+}
+
+int ExprTree::constant(double value) {
+	int id = add(ExprOp::Const);
+	nodes[id].value = value;
+	return id;
+}
+
+int ExprTree::variable(int slot) {
+	int id = add(ExprOp::Var);
+	nodes[id].slot = slot;
+	return id;
+}
+
+int expr_arity(ExprOp op) {
+	switch (op) {
+	case ExprOp::Const:
+	case ExprOp::Var:
+		return 0;
+	case ExprOp::Add: case ExprOp::Sub: case ExprOp::Mul: case ExprOp::Div: case ExprOp::Mod: case ExprOp::Pow:
+	case ExprOp::Min: case ExprOp::Max: case ExprOp::Atan2: case ExprOp::Hypot:
+	case ExprOp::Lt: case ExprOp::Le: case ExprOp::Gt: case ExprOp::Ge: case ExprOp::Eq: case ExprOp::Ne:
+	case ExprOp::And: case ExprOp::Or:
+		return 2;
+	case ExprOp::Select:
+		return 3;
+	default:
+		return 1;
+	}
+}
+
+const char* expr_op_name(ExprOp op) {
+	static const char* names[] = {
+		"const", "var",
+		"neg", "add", "sub", "mul", "div", "mod", "pow",
+		"abs", "sqrt", "exp", "log", "log2", "log10", "sin", "cos", "tan", "asin", "acos", "atan", "sinh", "cosh", "tanh",
+		"floor", "ceil", "round", "trunc", "sgn",
+		"min", "max", "atan2", "hypot",
+		"lt", "le", "gt", "ge", "eq", "ne", "and", "or", "not",
+		"select"
+	};
+	return names[(int)op];
+}
+
+struct FunctionName {
+	const char* name;
+	ExprOp op;
+};
+
+static const FunctionName functions[] = {
+	{ "abs", ExprOp::Abs }, { "sqrt", ExprOp::Sqrt }, { "exp", ExprOp::Exp }, { "log", ExprOp::Log },
+	{ "log2", ExprOp::Log2 }, { "log10", ExprOp::Log10 }, { "sin", ExprOp::Sin }, { "cos", ExprOp::Cos },
+	{ "tan", ExprOp::Tan }, { "asin", ExprOp::Asin }, { "acos", ExprOp::Acos }, { "atan", ExprOp::Atan },
+	{ "sinh", ExprOp::Sinh }, { "cosh", ExprOp::Cosh }, { "tanh", ExprOp::Tanh }, { "floor", ExprOp::Floor },
+	{ "ceil", ExprOp::Ceil }, { "round", ExprOp::Round }, { "trunc", ExprOp::Trunc }, { "sgn", ExprOp::Sgn },
+	{ "min", ExprOp::Min }, { "max", ExprOp::Max }, { "atan2", ExprOp::Atan2 }, { "hypot", ExprOp::Hypot },
+	{ "pow", ExprOp::Pow }
+};
+
+//recursive descent over the exprtk grammar, lowest precedence first
+class ExprParser {
+public:
+	ExprParser(const std::string& text, const std::vector<std::string>& symbols, ExprTree& tree)
+		: text(text), symbols(symbols), tree(tree) {}
+
+	int parse(std::string& error) {
+		int root = ternary();
+		skip_space();
+		if (root >= 0 && pos < text.size())
+			fail("unexpected '" + std::string(1, text[pos]) + "'");
+		if (!message.empty()) {
+			error = message;
+			return -1;
+		}
+		return root;
+	}
+
+private:
+	const std::string& text;
+	const std::vector<std::string>& symbols;
+	ExprTree& tree;
+	size_t pos = 0;
+	std::string message;
+
+	int fail(const std::string& what) {
+		if (message.empty())
+			message = what + " at position " + std::to_string(pos);
+		return -1;
+	}
+
+	void skip_space() {
+		while (pos < text.size() && std::isspace((unsigned char)text[pos]))
+			pos++;
+	}
+
+	bool accept(const char* token) {
+		skip_space();
+		size_t i = 0;
+		while (token[i] && pos + i < text.size() && text[pos + i] == token[i])
+			i++;
+		if (token[i])
+			return false;
+		pos += i;
+		return true;
+	}
+
+	//keyword operators like "and" must not swallow the start of an identifier
+	bool accept_word(const char* word) {
+		skip_space();
+		size_t i = 0;
+		while (word[i] && pos + i < text.size() && std::tolower((unsigned char)text[pos + i]) == word[i])
+			i++;
+		if (word[i])
+			return false;
+		if (pos + i < text.size() && (std::isalnum((unsigned char)text[pos + i]) || text[pos + i] == '_'))
+			return false;
+		pos += i;
+		return true;
+	}
+
+	bool accept_open() { return accept("(") || accept("[") || accept("{"); }
+	bool accept_close() { return accept(")") || accept("]") || accept("}"); }
+
+	int ternary() {
+		int cond = logical_or();
+		if (cond < 0 || !accept("?"))
+			return cond;
+		int yes = ternary();
+		if (yes < 0)
+			return -1;
+		if (!accept(":"))
+			return fail("expected ':'");
+		int no = ternary();
+		if (no < 0)
+			return -1;
+		return tree.add(ExprOp::Select, cond, yes, no);
+	}
+
+	int logical_or() {
+		int left = logical_and();
+		while (left >= 0) {
+			if (!(accept_word("or") || accept("||") || accept("|")))
+				break;
+			int right = logical_and();
+			if (right < 0)
+				return -1;
+			left = tree.add(ExprOp::Or, left, right);
+		}
+		return left;
+	}
+
+	int logical_and() {
+		int left = comparison();
+		while (left >= 0) {
+			if (!(accept_word("and") || accept("&&") || accept("&")))
+				break;
+			int right = comparison();
+			if (right < 0)
+				return -1;
+			left = tree.add(ExprOp::And, left, right);
+		}
+		return left;
+	}
+
+	int comparison() {
+		int left = additive();
+		while (left >= 0) {
+			ExprOp op;
+			if (accept("<=")) op = ExprOp::Le;
+			else if (accept(">=")) op = ExprOp::Ge;
+			else if (accept("==")) op = ExprOp::Eq;
+			else if (accept("!=") || accept("<>")) op = ExprOp::Ne;
+			else if (accept("<")) op = ExprOp::Lt;
+			else if (accept(">")) op = ExprOp::Gt;
+			else if (accept("=")) op = ExprOp::Eq;
+			else break;
+			int right = additive();
+			if (right < 0)
+				return -1;
+			left = tree.add(op, left, right);
+		}
+		return left;
+	}
+
+	int additive() {
+		int left = term();
+		while (left >= 0) {
+			ExprOp op;
+			if (accept("+")) op = ExprOp::Add;
+			else if (accept("-")) op = ExprOp::Sub;
+			else break;
+			int right = term();
+			if (right < 0)
+				return -1;
+			left = tree.add(op, left, right);
+		}
+		return left;
+	}
+
+	int term() {
+		int left = unary();
+		while (left >= 0) {
+			ExprOp op;
+			if (accept("*")) op = ExprOp::Mul;
+			else if (accept("/")) op = ExprOp::Div;
+			else if (accept("%")) op = ExprOp::Mod;
+			else break;
+			int right = unary();
+			if (right < 0)
+				return -1;
+			left = tree.add(op, left, right);
+		}
+		return left;
+	}
+
+	int unary() {
+		if (accept("-")) {
+			int operand = unary();
+			return operand < 0 ? -1 : tree.add(ExprOp::Neg, operand);
+		}
+		if (accept("+"))
+			return unary();
+		if (accept_word("not")) {
+			int operand = unary();
+			return operand < 0 ? -1 : tree.add(ExprOp::Not, operand);
+		}
+		return power();
+	}
+
+	bool peek_open() {
+		skip_space();
+		return pos < text.size() && (text[pos] == '(' || text[pos] == '[' || text[pos] == '{');
+	}
+
+	//x^-2 is allowed, -x^2 is -(x^2)
+	int power() {
+		int base = primary();
+		if (base < 0 || !accept("^"))
+			return base;
+		int exponent = unary();
+		return exponent < 0 ? -1 : tree.add(ExprOp::Pow, base, exponent);
+	}
+
+	int primary() {
+		skip_space();
+		if (pos >= text.size())
+			return fail("unexpected end of expression");
+
+		char c = text[pos];
+		if (std::isdigit((unsigned char)c) || c == '.')
+			return number();
+
+		if (accept_open()) {
+			int inner = ternary();
+			if (inner < 0)
+				return -1;
+			if (!accept_close())
+				return fail("expected ')'");
+			return inner;
+		}
+
+		if (std::isalpha((unsigned char)c) || c == '_')
+			return identifier();
+
+		return fail("unexpected '" + std::string(1, c) + "'");
+	}
+
+	bool peek_keyword() {
+		size_t saved = pos;
+		bool keyword = accept_word("and") || accept_word("or");
+		pos = saved;
+		return keyword;
+	}
+
+	int number() {
+		const char* start = text.c_str() + pos;
+		char* end = nullptr;
+		double value = std::strtod(start, &end);
+		if (end == start)
+			return fail("bad number");
+		pos += end - start;
+		int id = tree.constant(value);
+
+		//implicit multiplication, 2x and 3(x + 1)
+		skip_space();
+		if (peek_open() || (pos < text.size() && (std::isalpha((unsigned char)text[pos]) || text[pos] == '_') && !peek_keyword())) {
+			int right = power();
+			return right < 0 ? -1 : tree.add(ExprOp::Mul, id, right);
+		}
+		return id;
+	}
+
+	int identifier() {
+		size_t start = pos;
+		while (pos < text.size() && (std::isalnum((unsigned char)text[pos]) || text[pos] == '_'))
+			pos++;
+		std::string name;
+		for (size_t i = start; i < pos; i++)
+			name.push_back((char)std::tolower((unsigned char)text[i]));
+
+		if (peek_open()) {
+			if (name == "if")
+				return conditional();
+			return call(name);
+		}
+
+		for (size_t i = 0; i < symbols.size(); i++) {
+			if (symbols[i] == name)
+				return tree.variable((int)i);
+		}
+		if (name == "pi")
+			return tree.constant(3.141592653589793238462643383279502);
+		if (name == "epsilon")
+			return tree.constant(std::numeric_limits<float>::epsilon());
+		if (name == "inf")
+			return tree.constant(std::numeric_limits<double>::infinity());
+
+		return fail("unknown symbol '" + name + "'");
+	}
+
+	int conditional() {
+		accept_open();
+		int cond = ternary();
+		if (cond < 0 || !accept(","))
+			return cond < 0 ? -1 : fail("expected ','");
+		int yes = ternary();
+		if (yes < 0 || !accept(","))
+			return yes < 0 ? -1 : fail("expected ','");
+		int no = ternary();
+		if (no < 0 || !accept_close())
+			return no < 0 ? -1 : fail("expected ')'");
+		return tree.add(ExprOp::Select, cond, yes, no);
+	}
+
+	int call(const std::string& name) {
+		const FunctionName* function = nullptr;
+		for (const FunctionName& f : functions) {
+			if (name == f.name)
+				function = &f;
+		}
+		if (!function)
+			return fail("unknown function '" + name + "'");
+
+		accept_open();
+		int args[2] = { -1, -1 };
+		int arity = expr_arity(function->op);
+		for (int i = 0; i < arity; i++) {
+			if (i > 0 && !accept(","))
+				return fail("expected ','");
+			args[i] = ternary();
+			if (args[i] < 0)
+				return -1;
+		}
+		if (!accept_close())
+			return fail("expected ')'");
+		return tree.add(function->op, args[0], args[1]);
+	}
+};
+
+int parse_expression(const std::string& text, const std::vector<std::string>& symbols, ExprTree& tree, std::string& error) {
+	ExprParser parser(text, symbols, tree);
+	return parser.parse(error);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <vector>
+
+//operations understood by the lowering passes, a subset of what exprtk accepts
+enum class ExprOp : unsigned char {
+	Const, Var,
+	Neg, Add, Sub, Mul, Div, Mod, Pow,
+	Abs, Sqrt, Exp, Log, Log2, Log10, Sin, Cos, Tan, Asin, Acos, Atan, Sinh, Cosh, Tanh,
+	Floor, Ceil, Round, Trunc, Sgn,
+	Min, Max, Atan2, Hypot,
+	Lt, Le, Gt, Ge, Eq, Ne, And, Or, Not,
+	Select
+};
+
+struct ExprNode {
+	ExprOp op;
+	int a;          //child node indices, -1 when unused
+	int b;
+	int c;
+	double value;   //Const
+	int slot;       //Var, index into the symbol list given to the parser
+};
+
+//flat expression tree, children are always stored before their parents
+struct ExprTree {
+	std::vector<ExprNode> nodes;
+
+	int add(ExprOp op, int a = -1, int b = -1, int c = -1);
+	int constant(double value);
+	int variable(int slot);
+};
+
+int expr_arity(ExprOp op);
+const char* expr_op_name(ExprOp op);
+
+//parses the exprtk syntax used for vector fields (arithmetic, functions, comparisons, if/?:),
+//returns the root node or -1 with error set when the text uses something outside that subset
+int parse_expression(const std::string& text, const std::vector<std::string>& symbols, ExprTree& tree, std::string& error);
@@ -0,0 +1,194 @@
+#include "ExprBuilder.h"
+
+static std::tuple<int, int, int, int, int, double> key_of(const ExprNode& node) {
+	//constants compare by value, everything else by structure
+	double value = node.op == ExprOp::Const ? node.value : 0.0;
+	int slot = node.op == ExprOp::Var ? node.slot : -1;
+	return std::make_tuple((int)node.op, node.a, node.b, node.c, slot, value);
+}
+
+ExprBuilder::ExprBuilder(ExprTree& tree, bool algebra) : tree(tree), algebra(algebra) {
+	for (size_t i = 0; i < tree.nodes.size(); i++) {
+		const ExprNode& node = tree.nodes[i];
+		if (node.op == ExprOp::Const && node.value != node.value)
+			continue;
+		index.insert(std::make_pair(key_of(node), (int)i));
+	}
+}
+
+bool ExprBuilder::is_constant(int node, double value) const {
+	return node >= 0 && tree.nodes[node].op == ExprOp::Const && tree.nodes[node].value == value;
+}
+
+int ExprBuilder::intern(const ExprNode& node) {
+	//NaN never equals itself, so it is never shared
+	if (node.op == ExprOp::Const && node.value != node.value) {
+		tree.nodes.push_back(node);
+		return (int)tree.nodes.size() - 1;
+	}
+
+	Key key = key_of(node);
+	auto found = index.find(key);
+	if (found != index.end()) {
+		reused++;
+		return found->second;
+	}
+	tree.nodes.push_back(node);
+	int id = (int)tree.nodes.size() - 1;
+	index[key] = id;
+	return id;
+}
+
+int ExprBuilder::constant(double value) {
+	requested++;
+	ExprNode node = { ExprOp::Const, -1, -1, -1, value, -1 };
+	return intern(node);
+}
+
+int ExprBuilder::variable(int slot) {
+	requested++;
+	ExprNode node = { ExprOp::Var, -1, -1, -1, 0.0, slot };
+	return intern(node);
+}
+
+static bool commutative(ExprOp op) {
+	switch (op) {
+	case ExprOp::Add: case ExprOp::Mul: case ExprOp::Min: case ExprOp::Max: case ExprOp::Hypot:
+	case ExprOp::Eq: case ExprOp::Ne: case ExprOp::And: case ExprOp::Or:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//rules that hold for every finite input, returns -1 when none applies
+int ExprBuilder::simplify(ExprOp op, int a, int b, int c) {
+	const ExprNode* na = a >= 0 ? &tree.nodes[a] : nullptr;
+	const ExprNode* nb = b >= 0 ? &tree.nodes[b] : nullptr;
+	bool const_a = na && na->op == ExprOp::Const;
+	bool const_b = nb && nb->op == ExprOp::Const;
+
+	//one operand order for commutative ops so y*x finds x*y: constants first, then by node index
+	if (commutative(op) && ((const_b && !const_a) || (const_a == const_b && b < a)))
+		return make(op, b, a);
+
+	if (!algebra) {
+		if (op == ExprOp::Neg && na->op == ExprOp::Neg)
+			return na->a;
+		if (op == ExprOp::Mul && is_constant(a, 1.0))
+			return b;
+		return -1;
+	}
+
+	switch (op) {
+	case ExprOp::Neg:
+		if (const_a)
+			return constant(-na->value);
+		if (na->op == ExprOp::Neg)
+			return na->a;
+		break;
+	case ExprOp::Add:
+		if (const_a && const_b)
+			return constant(na->value + nb->value);
+		if (is_constant(a, 0.0))
+			return b;
+		if (nb->op == ExprOp::Neg)
+			return make(ExprOp::Sub, a, nb->a);
+		break;
+	case ExprOp::Sub:
+		if (const_a && const_b)
+			return constant(na->value - nb->value);
+		if (is_constant(b, 0.0))
+			return a;
+		if (is_constant(a, 0.0))
+			return make(ExprOp::Neg, b);
+		if (a == b)
+			return constant(0.0);
+		if (nb->op == ExprOp::Neg)
+			return make(ExprOp::Add, a, nb->a);
+		break;
+	case ExprOp::Mul:
+		if (const_a && const_b)
+			return constant(na->value * nb->value);
+		if (is_constant(a, 0.0))
+			return constant(0.0);
+		if (is_constant(a, 1.0))
+			return b;
+		if (is_constant(a, -1.0))
+			return make(ExprOp::Neg, b);
+		break;
+	case ExprOp::Div:
+		if (const_a && const_b && nb->value != 0.0)
+			return constant(na->value / nb->value);
+		if (is_constant(a, 0.0))
+			return constant(0.0);
+		if (is_constant(b, 1.0))
+			return a;
+		break;
+	case ExprOp::Pow:
+		if (is_constant(b, 1.0))
+			return a;
+		if (is_constant(b, 0.0))
+			return constant(1.0);
+		break;
+	case ExprOp::Select:
+		if (b == c)
+			return b;
+		if (const_a)
+			return na->value != 0.0 ? b : c;
+		break;
+	default:
+		break;
+	}
+	return -1;
+}
+
+int ExprBuilder::make(ExprOp op, int a, int b, int c) {
+	if (op == ExprOp::Const || op == ExprOp::Var)
+		return -1;
+	requested++;
+
+	int simple = simplify(op, a, b, c);
+	if (simple >= 0) {
+		simplified++;
+		return simple;
+	}
+
+	ExprNode node = { op, a, b, c, 0.0, -1 };
+	return intern(node);
+}
+
+std::vector<int> ExprBuilder::import(const ExprTree& source, const std::vector<int>& roots) {
+	//children precede parents, so one forward pass maps every node
+	std::vector<int> mapped(source.nodes.size(), -1);
+	std::vector<char> live(source.nodes.size(), 0);
+	for (int root : roots)
+		live[root] = 1;
+	for (size_t i = source.nodes.size(); i-- > 0;) {
+		if (!live[i])
+			continue;
+		const ExprNode& node = source.nodes[i];
+		if (node.a >= 0) live[node.a] = 1;
+		if (node.b >= 0) live[node.b] = 1;
+		if (node.c >= 0) live[node.c] = 1;
+	}
+
+	for (size_t i = 0; i < source.nodes.size(); i++) {
+		if (!live[i])
+			continue;
+		imported++;
+		const ExprNode& node = source.nodes[i];
+		if (node.op == ExprOp::Const)
+			mapped[i] = constant(node.value);
+		else if (node.op == ExprOp::Var)
+			mapped[i] = variable(node.slot);
+		else
+			mapped[i] = make(node.op, node.a >= 0 ? mapped[node.a] : -1, node.b >= 0 ? mapped[node.b] : -1,
+				node.c >= 0 ? mapped[node.c] : -1);
+	}
+
+	std::vector<int> result;
+	for (int root : roots)
+		result.push_back(mapped[root]);
+	return result;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "Expr.h"
+
+//appends nodes to an ExprTree with hash-consing and local algebraic simplification,
+//so structurally equal subexpressions are one node and x*1, x+0, -(-x) never get built
+class ExprBuilder {
+public:
+	//indexes the nodes already in the tree, the first copy of a duplicate wins.
+	//algebra = false keeps only rewrites that are exact for inf and NaN too (no x*0 -> 0, x-x -> 0)
+	explicit ExprBuilder(ExprTree& tree, bool algebra = true);
+
+	int make(ExprOp op, int a = -1, int b = -1, int c = -1);
+	//rebuilds the given roots of another tree into this one, so identical subtrees
+	//across all of them collapse into one node. returns the new roots
+	std::vector<int> import(const ExprTree& source, const std::vector<int>& roots);
+	int constant(double value);
+	int variable(int slot);
+
+	bool is_constant(int node, double value) const;
+
+	ExprTree& tree;
+	bool algebra;
+	int requested = 0;      //nodes asked for
+	int reused = 0;         //answered by an existing node
+	int simplified = 0;     //answered by a simplification rule
+	int imported = 0;       //live source nodes seen by import()
+
+private:
+	typedef std::tuple<int, int, int, int, int, double> Key;
+	int intern(const ExprNode& node);
+	int simplify(ExprOp op, int a, int b, int c);
+
+	std::map<Key, int> index;
+};
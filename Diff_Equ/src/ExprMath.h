@@ -0,0 +1,27 @@
+#pragma once
+#include <cmath>
+
+//scalar semantics exprtk gives the ops that have no direct <cmath> counterpart, shared by every
+//evaluator of the lowered tree. unqualified math calls so DoubleDouble picks up its own overloads
+
+//exprtk compares floats with a relative epsilon rather than exactly, 1e-10 for anything wider than float
+template <typename T>
+inline bool nearly_equal(T a, T b) {
+	using std::fabs;
+	using std::fmax;
+	const T epsilon = sizeof(T) > sizeof(float) ? T(0.0000000001) : T(0.000001);
+	T scale = fmax(T(1), fmax(fabs(a), fabs(b)));
+	return fabs(a - b) <= scale * epsilon;
+}
+
+template <typename T>
+inline T round_half_away(T v) {
+	using std::ceil;
+	using std::floor;
+	return v < T(0) ? ceil(v - T(0.5)) : floor(v + T(0.5));
+}
+
+template <typename T>
+inline T sign_of(T v) {
+	return v > T(0) ? T(1) : (v < T(0) ? T(-1) : T(0));
+}
@@ -0,0 +1,73 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+
+FrameScheduler::FrameScheduler(double refresh_hz) {
+	set_refresh(refresh_hz);
+}
+
+void FrameScheduler::set_refresh(double hz) {
+	frame_interval = 1.0 / (hz > 1.0 ? hz : 60.0);
+}
+
+void FrameScheduler::begin_frame() {
+	clock::time_point now = clock::now();
+	if (started) {
+		current.frame = (float)(std::chrono::duration<double>(now - frame_start).count() * 1e3);
+		latest = (latest + 1) % history;
+		records[latest] = current;
+		count = count < history ? count + 1 : history;
+	}
+	started = true;
+	frame_start = now;
+	current = FrameRecord();
+}
+
+void FrameScheduler::end_render() {
+	current.render = (float)(since(frame_start) * 1e3);
+}
+
+void FrameScheduler::run(const std::vector<FrameTask*>& tasks) {
+	clock::time_point start = clock::now();
+	double elapsed = since(frame_start);
+	double budget = frame_interval * deadline_share - elapsed;
+	current.budget = (float)(std::max(budget, 0.0) * 1e3);
+
+	//stable, so equal priorities keep the caller's order
+	std::vector<int> order;
+	for (int i = 0; i < (int)tasks.size(); i++) {
+		if (tasks[i]->pending())
+			order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return tasks[a]->priority() < tasks[b]->priority(); });
+	if (overshoot.size() < tasks.size())
+		overshoot.resize(tasks.size(), 0.0);
+
+	for (size_t k = 0; k < order.size(); k++) {
+		int i = order[k];
+		//none starts when its last chunk is expected to end past the budget, and each is told to stop
+		//that much early
+		double left = budget - since(start);
+		if (left < min_chunk)
+			break;
+		if (left <= overshoot[i]) {
+			//fades so a task held back by one slow chunk gets another try
+			overshoot[i] *= overshoot_decay;
+			continue;
+		}
+		double given = left - overshoot[i];
+		clock::time_point task_start = clock::now();
+		bool more = tasks[i]->run(given);
+		double taken = since(task_start);
+		if (i < FrameRecord::max_tasks)
+			current.tasks[i] = (float)(taken * 1e3);
+		//a task that stopped for the budget ran past it by about its last chunk
+		if (more)
+			overshoot[i] = std::max(taken - given, overshoot[i] * overshoot_decay);
+	}
+
+	current.compute = (float)(since(start) * 1e3);
+	//only frames that compute pushed over, a render past the interval is not compute's doing
+	if (elapsed <= frame_interval && since(frame_start) > frame_interval)
+		overruns++;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <vector>
+
+//compute the frame loop runs in pieces. run() is handed the seconds left in this frame, does chunks of work
+//within them and returns false once nothing is left. whatever it did not get to stays in the task for the
+//next frame
+class FrameTask {
+public:
+	virtual ~FrameTask() {}
+	virtual const char* name() const = 0;
+	//lower runs first, asked every frame so a task can drop back once its output leaves the view
+	virtual int priority() const = 0;
+	virtual bool pending() const = 0;
+	virtual bool run(double seconds) = 0;
+};
+
+//one frame of the timeline, in milliseconds
+struct FrameRecord {
+	static const int max_tasks = 4;
+	float frame = 0.0f;         //start to start, vsync waits included
+	float render = 0.0f;        //draw calls and UI up to the compute phase
+	float budget = 0.0f;        //what compute was given
+	float compute = 0.0f;       //what it took
+	float tasks[max_tasks] = {};    //compute per task, in the order they were passed to run()
+};
+
+//keeps compute inside the frame's deadline. the deadline is a share of the display's refresh interval
+//after the frame started; render is measured each frame before compute runs, and compute gets the rest.
+//pending tasks run in priority order, each stopping at its own chunk boundaries once its seconds are
+//gone, and the ones that did not fit wait for the next frame. a task's last chunk runs past its seconds,
+//so how far it went past is kept per task and taken off what it is given, and a task whose overshoot alone
+//would not fit is not started. when render leaves less than min_chunk before the deadline no task
+//starts at all, so a heavy scene pauses compute until a lighter frame rather than risk the refresh
+class FrameScheduler {
+public:
+	static const int history = 240;
+
+	explicit FrameScheduler(double refresh_hz = 60.0);
+
+	void set_refresh(double hz);
+	double interval() const { return frame_interval; }
+
+	//marks the frame boundaries: right after the swap, then when drawing and UI are done
+	void begin_frame();
+	void end_render();
+	//runs tasks until the budget is gone, at most FrameRecord::max_tasks are timed separately
+	void run(const std::vector<FrameTask*>& tasks);
+
+	//age 0 is the last complete frame
+	const FrameRecord& in_progress() const { return current; }
+	const FrameRecord& record(int age) const { return records[(latest - age + history) % history]; }
+	int recorded() const { return count; }
+	unsigned long long overruns = 0;    //frames whose compute ended past the refresh interval
+
+	double deadline_share = 0.85;       //of the interval, the rest covers the swap and timing noise
+	double min_chunk = 0.0002;          //seconds, less than this left and no task starts
+	double overshoot_decay = 0.8;       //per frame a task runs or is held back, so one slow chunk is soon forgotten
+
+private:
+	typedef std::chrono::steady_clock clock;
+	static double since(clock::time_point start) { return std::chrono::duration<double>(clock::now() - start).count(); }
+
+	double frame_interval;
+	clock::time_point frame_start;
+	bool started = false;
+	FrameRecord current;
+	FrameRecord records[history];
+	int latest = history - 1;
+	int count = 0;
+	std::vector<double> overshoot;      //seconds each task last ran past what it was given, by index in run()'s tasks
+};
@@ -0,0 +1,202 @@
+#pragma once
+#include <chrono>
+#include <vector>
+
+#include "Adaptive.h"
+#include "AutoSwitch.h"
+#include "Energy.h"
+#include "EvalContext.h"
+#include "Events.h"
+#include "Integrators.h"
+#include "SystemEval.h"
+
+//what one extend() may spend, it stops at the first limit reached. 0 leaves a limit off
+struct PathBudget {
+	double seconds = 0.0;
+	unsigned long long evaluations = 0;
+};
+
+//a trajectory that lives across frames. extend() integrates until its budget or the path runs out and
+//appends the new samples, spacing apart in time, to points as x, y pairs, so a long path costs a bounded
+//slice of every frame and grows on screen instead of stalling a frame or being cut short. the budget is
+//checked between steps, a single step is never split. samples are the same whatever the budgets were
+class IncrementalPath {
+public:
+	//every sample is reserved up front, growing the array later copies megabytes inside one slice
+	IncrementalPath(double spacing, double end) : spacing(spacing), last((long long)(end / spacing + 1e-9)) {
+		points.reserve(2 * (size_t)(last + 1));
+	}
+	virtual ~IncrementalPath() {}
+
+	//false once the path is complete: it reached its end, hit a terminal event or a step failed
+	virtual bool extend(const PathBudget& budget) = 0;
+
+	bool complete() const { return done; }
+	size_t samples() const { return points.size() / 2; }
+	double time() const { return spacing * (double)(samples() > 0 ? samples() - 1 : 0); }
+
+	std::vector<float> points;
+	std::vector<EventHit<double>> hits;
+	std::vector<MethodSwitch> switches;     //the automatic stepper's, empty for the others
+	StepStats stats;
+	EnergyMonitor energy;
+	bool energy_tracked = false;            //separable systems only
+	int slices = 0;                         //extend() calls that added something
+	double seconds = 0.0;                   //spent in extend() in total
+	double longest_slice = 0.0;
+
+protected:
+	//true when the slice that began at start with evaluations used so far has to end. the clock is only
+	//read every clock_interval calls, reading it on every sample added about half to the integration time
+	bool spent(const PathBudget& budget, std::chrono::steady_clock::time_point start, unsigned long long used) {
+		if (budget.evaluations > 0 && used >= budget.evaluations)
+			return true;
+		if (budget.seconds <= 0.0 || ++checks % clock_interval != 0)
+			return false;
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= budget.seconds;
+	}
+
+	template <typename F>
+	void append(F& energy_f, double t, double x, double y) {
+		if (energy_tracked) {
+			if (points.empty())
+				energy.start(energy_f, t, x, y);
+			else
+				energy.sample(energy_f, t, x, y);
+		}
+		points.push_back((float)x);
+		points.push_back((float)y);
+	}
+
+	void finish_slice(std::chrono::steady_clock::time_point start, size_t before) {
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		seconds += elapsed;
+		if (samples() > before) {
+			slices++;
+			longest_slice = elapsed > longest_slice ? elapsed : longest_slice;
+		}
+	}
+
+	static const int clock_interval = 32;
+
+	double spacing;
+	long long last;         //index of the final sample
+	bool done = false;
+	unsigned checks = 0;
+};
+
+template <typename Solver>
+inline void copy_switches(const Solver&, std::vector<MethodSwitch>&) {}
+
+template <typename T, typename F>
+inline void copy_switches(const AutoSwitch<T, F>& solver, std::vector<MethodSwitch>& out) {
+	out = solver.switches;
+}
+
+//an adaptive solver's path, samples from its dense output and events checked after every step
+template <typename T, template <typename, typename> class Solver>
+class AdaptivePath : public IncrementalPath {
+public:
+	AdaptivePath(EvalContext& context, EventSet& events, Tolerance tolerance, T x0, T y0, double spacing, double end)
+		: IncrementalPath(spacing, end), f(context), energy_f(context), solver(f, tolerance), tracker(events), x(x0), y(y0) {
+		energy_tracked = context.separable();
+		solver.start(T(0), x0, y0);
+		tracker.start(T(0), x0, y0);
+	}
+
+	bool extend(const PathBudget& budget) override {
+		if (done)
+			return false;
+		auto start = std::chrono::steady_clock::now();
+		size_t before = samples();
+		const unsigned long long first = used();
+		const T end = T(spacing * (double)last);
+
+		while (next <= last) {
+			T sample_t = T(spacing * (double)next);
+			while (running && solver.t < sample_t && !spent(budget, start, used() - first)) {
+				running = solver.step(end);
+				if (running && tracker.check(solver))
+					running = false;
+			}
+			//a terminal event ends the path on the crossing, a failed step (blow-up or underflow) on the last good point
+			if (tracker.stopped && sample_t >= tracker.stop.t) {
+				append(energy_f, (double)tracker.stop.t, (double)tracker.stop.x, (double)tracker.stop.y);
+				done = true;
+				break;
+			}
+			if (solver.t < sample_t) {
+				if (!running)
+					done = true;
+				break;
+			}
+			solver.dense(sample_t, x, y);
+			append(energy_f, (double)sample_t, (double)x, (double)y);
+			next++;
+			if (spent(budget, start, used() - first))
+				break;
+		}
+		done = done || next > last;
+
+		stats = solver.stats;
+		copy_switches(solver, switches);
+		hits.clear();
+		for (const EventHit<T>& hit : tracker.hits) {
+			EventHit<double> entry = { hit.event, (double)hit.t, (double)hit.x, (double)hit.y };
+			hits.push_back(entry);
+		}
+		finish_slice(start, before);
+		return !done;
+	}
+
+private:
+	unsigned long long used() const { return solver.stats.evaluations + tracker.evaluations; }
+
+	SystemEval<T> f;
+	SystemEval<double> energy_f;
+	Solver<T, SystemEval<T>> solver;
+	EventTracker<T, Solver<T, SystemEval<T>>> tracker;
+	T x, y;
+	long long next = 0;
+	bool running = true;
+};
+
+//a fixed step path, one step per sample, state kept in T
+template <typename T>
+class FixedPath : public IncrementalPath {
+public:
+	FixedPath(EvalContext& context, Method method, T x0, T y0, double spacing, double end)
+		: IncrementalPath(spacing, end), f(context), energy_f(context), method(method), x(x0), y(y0) {
+		energy_tracked = context.separable();
+	}
+
+	bool extend(const PathBudget& budget) override {
+		if (done)
+			return false;
+		auto start = std::chrono::steady_clock::now();
+		size_t before = samples();
+		const unsigned long long first = f.evaluations;
+		const T h = T(spacing);
+
+		while (next <= last && !spent(budget, start, f.evaluations - first)) {
+			append(energy_f, (double)t, (double)x, (double)y);
+			step(method, f, t, x, y, h);
+			t += h;
+			next++;
+		}
+		done = next > last;
+
+		stats.accepted = (unsigned long long)next;
+		stats.evaluations = f.evaluations;
+		finish_slice(start, before);
+		return !done;
+	}
+
+private:
+	SystemEval<T> f;
+	SystemEval<double> energy_f;
+	Method method;
+	T x, y;
+	T t = T(0);
+	long long next = 0;
+};
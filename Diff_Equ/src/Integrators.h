@@ -0,0 +1,118 @@
+#pragma once
+#include <cmath>
+
+//explicit fixed step methods, generic over the scalar type T and the system f.
+//f(t, x, y, dx, dy) writes the derivative at (t, x, y), SystemEval<T> is the usual one
+
+enum class Method {
+	Euler,
+	Heun,
+	Rk4,
+	Leapfrog,       //symplectic, separable systems only (EvalContext::separable())
+	Yoshida4
+};
+
+inline bool is_symplectic(Method method) {
+	return method == Method::Leapfrog || method == Method::Yoshida4;
+}
+
+//derivative evaluations each step costs
+inline int method_stages(Method method) {
+	switch (method) {
+	case Method::Euler: return 1;
+	case Method::Heun: return 2;
+	case Method::Rk4: return 4;
+	case Method::Leapfrog: return 3;
+	case Method::Yoshida4: return 7;
+	}
+	return 1;
+}
+
+template <typename T, typename F>
+inline void euler_step(F& f, T t, T& x, T& y, T h) {
+	T dx, dy;
+	f(t, x, y, dx, dy);
+	x += h * dx;
+	y += h * dy;
+}
+
+//improved Euler, second order
+template <typename T, typename F>
+inline void heun_step(F& f, T t, T& x, T& y, T h) {
+	T k1x, k1y, k2x, k2y;
+	f(t, x, y, k1x, k1y);
+	f(t + h, x + h * k1x, y + h * k1y, k2x, k2y);
+	x += h * T(0.5) * (k1x + k2x);
+	y += h * T(0.5) * (k1y + k2y);
+}
+
+//classic fourth order Runge-Kutta
+template <typename T, typename F>
+inline void rk4_step(F& f, T t, T& x, T& y, T h) {
+	const T half = h * T(0.5);
+	T k1x, k1y, k2x, k2y, k3x, k3y, k4x, k4y;
+	f(t, x, y, k1x, k1y);
+	f(t + half, x + half * k1x, y + half * k1y, k2x, k2y);
+	f(t + half, x + half * k2x, y + half * k2y, k3x, k3y);
+	f(t + h, x + h * k3x, y + h * k3y, k4x, k4y);
+	const T sixth = h / T(6);
+	x += sixth * (k1x + T(2) * (k2x + k3x) + k4x);
+	y += sixth * (k1y + T(2) * (k2y + k3y) + k4y);
+}
+
+//velocity verlet, kick y by dy(x), drift x by dx(y), kick again. second order and symplectic when
+//dx depends only on y and dy only on x, so the energy error stays bounded instead of drifting.
+//the last kick's dy(x') equals the next step's first, a stateless step pays for it twice
+template <typename T, typename F>
+inline void leapfrog_step(F& f, T t, T& x, T& y, T h) {
+	const T half = h * T(0.5);
+	T dx, dy;
+	f(t, x, y, dx, dy);
+	y += half * dy;
+	f(t + half, x, y, dx, dy);
+	x += h * dx;
+	f(t + h, x, y, dx, dy);
+	y += half * dy;
+}
+
+//Yoshida's fourth order composition of three leapfrog steps h w1, h w0, h w1, where
+//w1 = 1 / (2 - 2^(1/3)) and w0 = 1 - 2 w1 is negative. the kicks between substeps are merged
+template <typename T, typename F>
+inline void yoshida4_step(F& f, T t, T& x, T& y, T h) {
+	using std::pow;
+	static const T w1 = T(1) / (T(2) - pow(T(2), T(1) / T(3)));
+	static const T w0 = T(1) - T(2) * w1;
+	const T drifts[3] = { w1, w0, w1 };
+	const T kicks[4] = { w1 * T(0.5), (w1 + w0) * T(0.5), (w0 + w1) * T(0.5), w1 * T(0.5) };
+
+	T dx, dy;
+	T time = t;
+	for (int i = 0; i < 3; i++) {
+		f(time, x, y, dx, dy);
+		y += h * kicks[i] * dy;
+		time += h * drifts[i] * T(0.5);
+		f(time, x, y, dx, dy);
+		x += h * drifts[i] * dx;
+		time += h * drifts[i] * T(0.5);
+	}
+	f(time, x, y, dx, dy);
+	y += h * kicks[3] * dy;
+}
+
+template <typename T, typename F>
+inline void step(Method method, F& f, T t, T& x, T& y, T h) {
+	switch (method) {
+	case Method::Euler: euler_step(f, t, x, y, h); break;
+	case Method::Heun: heun_step(f, t, x, y, h); break;
+	case Method::Rk4: rk4_step(f, t, x, y, h); break;
+	case Method::Leapfrog: leapfrog_step(f, t, x, y, h); break;
+	case Method::Yoshida4: yoshida4_step(f, t, x, y, h); break;
+	}
+}
+
+//time is recomputed from the step index so it does not drift over long runs
+template <typename T, typename F>
+inline void integrate_fixed(Method method, F& f, T t0, T& x, T& y, T h, long long steps) {
+	for (long long i = 0; i < steps; i++)
+		step(method, f, t0 + h * T((double)i), x, y, h);
+}
@@ -0,0 +1,368 @@
+#include "NativeModule.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static double milliseconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static unsigned long long fnv1a(const std::string& text) {
+	unsigned long long hash = 1469598103934665603ull;
+	for (char c : text) {
+		hash ^= (unsigned char)c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+#ifdef _WIN32
+//%LOCALAPPDATA% is the user's own, its ACL keeps other accounts out
+static bool private_directory(const std::string& path, std::string& error) {
+	if (!CreateDirectoryA(path.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+		error = "could not create " + path;
+		return false;
+	}
+	return true;
+}
+
+static std::string cache_directory(std::string& error) {
+	const char* dir = std::getenv("LOCALAPPDATA");
+	if (!dir) {
+		error = "LOCALAPPDATA is not set";
+		return std::string();
+	}
+	std::string path = std::string(dir) + "\\diff_equ";
+	return private_directory(path, error) ? path + "\\" : std::string();
+}
+
+static bool trusted_file(const std::string&) {
+	return true;
+}
+#else
+//a directory only this user can write to: created 0700, and an existing one has to be a real directory
+//owned by us with no group or other access. anything else could have been planted by another user
+static bool private_directory(const std::string& path, std::string& error) {
+	if (mkdir(path.c_str(), 0700) != 0 && errno != EEXIST) {
+		error = "could not create " + path;
+		return false;
+	}
+	struct stat info;
+	if (lstat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != geteuid() || (info.st_mode & 077) != 0) {
+		error = path + " is not a private directory of this user";
+		return false;
+	}
+	return true;
+}
+
+//$XDG_CACHE_HOME/diff_equ or ~/.cache/diff_equ, and a per-user directory under $TMPDIR or /tmp without a home
+static std::string cache_directory(std::string& error) {
+	std::string path;
+	const char* xdg = std::getenv("XDG_CACHE_HOME");
+	const char* home = std::getenv("HOME");
+	if (xdg && *xdg) {
+		path = std::string(xdg) + "/diff_equ";
+	}
+	else if (home && *home) {
+		std::string parent = std::string(home) + "/.cache";
+		mkdir(parent.c_str(), 0700);
+		path = parent + "/diff_equ";
+	}
+	else {
+		const char* tmp = std::getenv("TMPDIR");
+		path = std::string(tmp && *tmp ? tmp : "/tmp") + "/diff_equ-" + std::to_string((unsigned long long)geteuid());
+	}
+	return private_directory(path, error) ? path + "/" : std::string();
+}
+
+//a cached library is only loaded when it is a regular file of ours that nobody else can write
+static bool trusted_file(const std::string& path) {
+	struct stat info;
+	return lstat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode) && info.st_uid == geteuid() && (info.st_mode & 022) == 0;
+}
+#endif
+
+static bool file_exists(const std::string& path) {
+	std::ifstream file(path);
+	return file.good();
+}
+
+//replaces target in one step, a concurrent load sees the old library or the new one, never half of it
+static bool replace_file(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static unsigned long long process_id() {
+#ifdef _WIN32
+	return (unsigned long long)_getpid();
+#else
+	return (unsigned long long)getpid();
+#endif
+}
+
+static std::string constant_literal(float value) {
+	if (std::isnan(value))
+		return "NAN";
+	if (std::isinf(value))
+		return value > 0 ? "INFINITY" : "(-INFINITY)";
+	char text[32];
+	std::snprintf(text, sizeof(text), "%#.9gf", value);
+	return text;
+}
+
+static std::string reg(unsigned short r) {
+	return "r" + std::to_string(r);
+}
+
+//one C statement per instruction, registers become locals
+static std::string statement(const Instr& in) {
+	std::string d = reg(in.dst), a = reg(in.a), b = reg(in.b), c = reg(in.c);
+	switch (in.op) {
+	case OpCode::Neg: return d + " = -" + a;
+	case OpCode::Add: return d + " = " + a + " + " + b;
+	case OpCode::Sub: return d + " = " + a + " - " + b;
+	case OpCode::Mul: return d + " = " + a + " * " + b;
+	case OpCode::Div: return d + " = " + a + " / " + b;
+	case OpCode::Mod: return d + " = fmodf(" + a + ", " + b + ")";
+	case OpCode::Pow: return d + " = powf(" + a + ", " + b + ")";
+	case OpCode::Abs: return d + " = fabsf(" + a + ")";
+	case OpCode::Sqrt: return d + " = sqrtf(" + a + ")";
+	case OpCode::Exp: return d + " = expf(" + a + ")";
+	case OpCode::Log: return d + " = logf(" + a + ")";
+	case OpCode::Log2: return d + " = log2f(" + a + ")";
+	case OpCode::Log10: return d + " = log10f(" + a + ")";
+	case OpCode::Sin: return d + " = sinf(" + a + ")";
+	case OpCode::Cos: return d + " = cosf(" + a + ")";
+	case OpCode::Tan: return d + " = tanf(" + a + ")";
+	case OpCode::Asin: return d + " = asinf(" + a + ")";
+	case OpCode::Acos: return d + " = acosf(" + a + ")";
+	case OpCode::Atan: return d + " = atanf(" + a + ")";
+	case OpCode::Sinh: return d + " = sinhf(" + a + ")";
+	case OpCode::Cosh: return d + " = coshf(" + a + ")";
+	case OpCode::Tanh: return d + " = tanhf(" + a + ")";
+	case OpCode::Floor: return d + " = floorf(" + a + ")";
+	case OpCode::Ceil: return d + " = ceilf(" + a + ")";
+	case OpCode::Round: return d + " = round_half_away(" + a + ")";
+	case OpCode::Trunc: return d + " = truncf(" + a + ")";
+	case OpCode::Sgn: return d + " = (float)(" + a + " > 0.0f) - (float)(" + a + " < 0.0f)";
+	case OpCode::Min: return d + " = fminf(" + a + ", " + b + ")";
+	case OpCode::Max: return d + " = fmaxf(" + a + ", " + b + ")";
+	case OpCode::Atan2: return d + " = atan2f(" + a + ", " + b + ")";
+	case OpCode::Hypot: return d + " = hypotf(" + a + ", " + b + ")";
+	case OpCode::Lt: return d + " = (float)(" + a + " < " + b + ")";
+	case OpCode::Le: return d + " = (float)(" + a + " <= " + b + ")";
+	case OpCode::Gt: return d + " = (float)(" + a + " > " + b + ")";
+	case OpCode::Ge: return d + " = (float)(" + a + " >= " + b + ")";
+	case OpCode::Eq: return d + " = nearly_equal(" + a + ", " + b + ")";
+	case OpCode::Ne: return d + " = 1.0f - nearly_equal(" + a + ", " + b + ")";
+	case OpCode::And: return d + " = (float)(" + a + " != 0.0f && " + b + " != 0.0f)";
+	case OpCode::Or: return d + " = (float)(" + a + " != 0.0f || " + b + " != 0.0f)";
+	case OpCode::Not: return d + " = (float)(" + a + " == 0.0f)";
+	case OpCode::Select: return d + " = " + a + " != 0.0f ? " + b + " : " + c;
+	case OpCode::MulAdd: return d + " = " + a + " * " + b + " + " + c;
+	case OpCode::MulSub: return d + " = " + a + " * " + b + " - " + c;
+	case OpCode::NMulAdd: return d + " = " + c + " - " + a + " * " + b;
+	case OpCode::Sqr: return d + " = " + a + " * " + a;
+	}
+	return d + " = 0.0f";
+}
+
+std::string NativeModule::source(const Program& program) {
+	std::ostringstream out;
+	out << "#include <math.h>\n#include <stddef.h>\n";
+	out << "#ifdef _WIN32\n#define EXPORT __declspec(dllexport)\n#else\n#define EXPORT\n#endif\n\n";
+	out << "static float nearly_equal(float a, float b) {\n"
+		"\tfloat scale = fmaxf(1.0f, fmaxf(fabsf(a), fabsf(b)));\n"
+		"\treturn fabsf(a - b) <= scale * 0.000001f ? 1.0f : 0.0f;\n}\n";
+	out << "static float round_half_away(float v) { return v < 0.0f ? ceilf(v - 0.5f) : floorf(v + 0.5f); }\n\n";
+
+	//the body reads inputs r0..r(n-1) and leaves the results in the output registers
+	std::ostringstream body;
+	int temp_base = program.num_inputs + (int)program.constants.size();
+	for (size_t i = 0; i < program.constants.size(); i++)
+		body << "\tconst float " << reg((unsigned short)(program.num_inputs + i)) << " = " << constant_literal((float)program.constants[i]) << ";\n";
+	if (program.num_registers > temp_base) {
+		body << "\tfloat";
+		for (int r = temp_base; r < program.num_registers; r++)
+			body << (r == temp_base ? " " : ", ") << reg((unsigned short)r);
+		body << ";\n";
+	}
+	for (const Instr& in : program.code)
+		body << "\t" << statement(in) << ";\n";
+
+	out << "EXPORT void diff_equ_eval(const float* in, float* out) {\n";
+	for (int i = 0; i < program.num_inputs; i++)
+		out << "\tconst float " << reg((unsigned short)i) << " = in[" << i << "];\n";
+	out << body.str();
+	for (size_t i = 0; i < program.outputs.size(); i++)
+		out << "\tout[" << i << "] = " << reg(program.outputs[i]) << ";\n";
+	out << "}\n\n";
+
+	//same body in a loop the compiler can vectorize
+	out << "EXPORT void diff_equ_eval_batch(const float* xs, const float* ys, const float* uniforms, float* dxs, float* dys, size_t count) {\n";
+	for (int i = 2; i < program.num_inputs; i++)
+		out << "\tconst float " << reg((unsigned short)i) << " = uniforms[" << i - 2 << "];\n";
+	out << "\tfor (size_t i = 0; i < count; i++) {\n";
+	out << "\t\tconst float r0 = xs[i];\n\t\tconst float r1 = ys[i];\n";
+	std::string indented = body.str();
+	size_t at = 0;
+	while ((at = indented.find('\n', at)) != std::string::npos && at + 1 < indented.size()) {
+		indented.insert(at + 1, "\t");
+		at += 2;
+	}
+	out << "\t" << indented;
+	out << "\t\tdxs[i] = " << reg(program.outputs[0]) << ";\n";
+	out << "\t\tdys[i] = " << reg(program.outputs[1]) << ";\n";
+	out << "\t}\n}\n";
+	return out.str();
+}
+
+bool NativeModule::load(const Program& program, bool reuse_cached) {
+	unload();
+	compile_ms = 0.0;
+	load_ms = 0.0;
+	from_cache = false;
+	error_message.clear();
+
+	if (program.outputs.size() != 2) {
+		error_message = "native mode needs a two-output program";
+		return false;
+	}
+
+	std::string directory = cache_directory(error_message);
+	if (directory.empty())
+		return false;
+
+	//DIFF_EQU_CC overrides the compiler, e.g. clang or gcc-13
+	const char* compiler_override = std::getenv("DIFF_EQU_CC");
+#ifdef _WIN32
+	std::string compiler = compiler_override ? compiler_override : "cl";
+	std::string flags = "/nologo /O2 /arch:AVX2 /LD";
+#else
+	std::string compiler = compiler_override ? compiler_override : "cc";
+	std::string flags = "-O3 -march=native -shared -fPIC";
+#endif
+
+	//the compiler and its flags are part of the key, a library built another way is a different library
+	std::string code = source(program);
+	char name[32];
+	std::snprintf(name, sizeof(name), "diff_equ_%016llx", fnv1a(compiler + "\n" + flags + "\n" + code));
+	std::string base = directory + name;
+#ifdef _WIN32
+	std::string library = base + ".dll";
+#else
+	std::string library = base + ".so";
+#endif
+
+	if (reuse_cached && file_exists(library) && trusted_file(library)) {
+		from_cache = true;
+	}
+	else {
+		//everything is built under names of this process and only the finished library is renamed into
+		//place, so two instances or a build killed halfway never leave a truncated library to load
+		static unsigned builds = 0;
+		std::string temp = base + "." + std::to_string(process_id()) + "." + std::to_string(builds++);
+		std::string source_path = temp + ".c";
+		std::string log_path = base + ".log";
+#ifdef _WIN32
+		std::string built = temp + ".dll";
+#else
+		std::string built = temp + ".so";
+#endif
+		{
+			std::ofstream file(source_path);
+			file << code;
+			if (!file) {
+				error_message = "could not write " + source_path;
+				return false;
+			}
+		}
+
+#ifdef _WIN32
+		std::string command = compiler + " " + flags + " \"" + source_path + "\" /Fe\"" + built + "\" /Fo\"" + temp + ".obj\" > \"" +
+			log_path + "\" 2>&1";
+#else
+		std::string command = compiler + " " + flags + " -o \"" + built + "\" \"" + source_path + "\" -lm > \"" + log_path + "\" 2>&1";
+#endif
+		auto start = std::chrono::steady_clock::now();
+		int status = std::system(command.c_str());
+		compile_ms = milliseconds_since(start);
+		std::remove(source_path.c_str());
+#ifdef _WIN32
+		std::remove((temp + ".obj").c_str());
+		std::remove((temp + ".lib").c_str());
+		std::remove((temp + ".exp").c_str());
+#endif
+		if (status != 0 || !file_exists(built)) {
+			std::remove(built.c_str());
+			error_message = "native compile failed, see " + log_path;
+			return false;
+		}
+		if (!replace_file(built, library)) {
+			std::remove(built.c_str());
+			error_message = "could not move the library to " + library;
+			return false;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+#ifdef _WIN32
+	HMODULE module = LoadLibraryA(library.c_str());
+	handle = (void*)module;
+	if (module) {
+		scalar = (eval_fn)GetProcAddress(module, "diff_equ_eval");
+		batch = (batch_fn)GetProcAddress(module, "diff_equ_eval_batch");
+	}
+#else
+	handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (handle) {
+		scalar = (eval_fn)dlsym(handle, "diff_equ_eval");
+		batch = (batch_fn)dlsym(handle, "diff_equ_eval_batch");
+	}
+#endif
+	load_ms = milliseconds_since(start);
+
+	if (!scalar || !batch) {
+		error_message = "could not load " + library;
+		unload();
+		return false;
+	}
+	return true;
+}
+
+void NativeModule::unload() {
+	if (handle) {
+#ifdef _WIN32
+		FreeLibrary((HMODULE)handle);
+#else
+		dlclose(handle);
+#endif
+	}
+	handle = nullptr;
+	scalar = nullptr;
+	batch = nullptr;
+}
+
+NativeModule::~NativeModule() {
+	unload();
+}
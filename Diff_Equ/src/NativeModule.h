@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+#include "Bytecode.h"
+
+//a lowered Program translated to C, built by the system compiler into a shared library and loaded.
+//libraries are cached in a per-user directory by a hash of the generated source and the compiler command,
+//so a given system only compiles once
+class NativeModule {
+public:
+	typedef void (*eval_fn)(const float* inputs, float* out);
+	typedef void (*batch_fn)(const float* xs, const float* ys, const float* uniforms, float* dxs, float* dys, size_t count);
+
+	NativeModule() {}
+	~NativeModule();
+	NativeModule(const NativeModule&) = delete;
+	NativeModule& operator=(const NativeModule&) = delete;
+
+	//false (with error set) when no compiler is available or the build fails, callers keep interpreting.
+	//reuse_cached = false always rebuilds, for measuring compile latency
+	bool load(const Program& program, bool reuse_cached = true);
+	void unload();
+
+	bool loaded() const { return scalar != nullptr; }
+	const std::string& error() const { return error_message; }
+
+	//inputs as in Program: x, y, t, parameters
+	void eval(const float* inputs, float* out) const { scalar(inputs, out); }
+	//uniforms are t and the parameters, shared by every state
+	void eval_batch(const float* xs, const float* ys, const float* uniforms, float* dxs, float* dys, size_t count) const {
+		batch(xs, ys, uniforms, dxs, dys, count);
+	}
+
+	double compile_ms = 0.0;    //0 when the library came from the cache
+	double load_ms = 0.0;
+	bool from_cache = false;
+
+	static std::string source(const Program& program);
+
+private:
+	void* handle = nullptr;
+	eval_fn scalar = nullptr;
+	batch_fn batch = nullptr;
+	std::string error_message;
+};
@@ -0,0 +1,170 @@
+#pragma once
+#include <cmath>
+
+#include "Adaptive.h"
+
+//ROS2, the two stage L-stable Rosenbrock-W method of Verwer et al. with gamma = 1 + 1/sqrt(2):
+//	(I - gamma h J) k1 = f(t, y)
+//	(I - gamma h J) k2 = f(t + h, y + h k1) - 2 k1
+//	y' = y + 3/2 h k1 + 1/2 h k2, embedded first order y + h k1
+//as a W-method it stays second order for any J, so the factorization of W = I - gamma h' J is kept
+//while h stays within factor_window of the h' it was built with (stepping with h through it is the
+//W-method with (h'/h) J in place of J). the order survives a stale J but the error estimate does not,
+//so J is only evaluated again when the estimate degrades: on a rejected step, on an accepted one that
+//could not grow, or when h has left the window and W has to be factored anyway. being second order is
+//what sets the step count, a hundredth of the tolerance takes ten times the steps, so tight tolerances
+//belong to bdf.
+//F needs operator()(t, x, y, dx, dy) and jacobian(t, x, y, out[4]) (row major), e.g. SystemEval<T>
+template <typename T, typename F>
+class Rosenbrock2 {
+public:
+	//h may move this far either way from the h the LU was factored with before J and the LU are rebuilt
+	static constexpr double factor_window = 2.0;
+
+	Rosenbrock2(F& f, Tolerance tolerance) : f(f), tolerance(tolerance) {
+		using std::sqrt;
+		gamma = T(1) + T(1) / sqrt(T(2));
+	}
+
+	//first_step 0 picks one from the local derivative scale
+	void start(T t0, T x0, T y0, T first_step = T(0)) {
+		t = previous_t = t0;
+		x = x0;
+		y = y0;
+		last_h = T(0);
+		stats = StepStats();
+		eval(t, x, y, fx, fy);
+		refresh_jacobian();
+		h = first_step > T(0) ? first_step : initial_step(f, tolerance, 2, t, x, y, fx, fy, stats);
+	}
+
+	//one accepted step that never passes t_stop. false once t_stop is reached,
+	//or when the step size underflows or the solution stops being finite
+	bool step(T t_stop) {
+		if (!(t < t_stop))
+			return false;
+
+		bool rejected = false;
+		while (true) {
+			T step_h = h;
+			bool last = false;
+			if (t + step_h >= t_stop) {
+				step_h = t_stop - t;
+				last = true;
+			}
+			if (!(step_h > T(0)) || (double)step_h <= std::fabs((double)t) * 1e-15)
+				return false;
+
+			double ratio = factored ? (double)(step_h / factored_h) : 0.0;
+			if (!factored || ratio > factor_window || ratio < 1.0 / factor_window) {
+				if (factored && jacobian_age > 0)
+					refresh_jacobian();
+				stats.factorizations++;
+				T c = gamma * step_h;
+				factored = lu.factor(T(1) - c * J[0], -c * J[1], -c * J[2], T(1) - c * J[3]);
+				factored_h = step_h;
+				if (!factored) {
+					h = step_h * T(0.5);
+					stats.rejected++;
+					continue;
+				}
+			}
+
+			T k1x, k1y, k2x, k2y, gx, gy;
+			lu.solve(fx, fy, k1x, k1y);
+			eval(t + step_h, x + step_h * k1x, y + step_h * k1y, gx, gy);
+			lu.solve(gx - T(2) * k1x, gy - T(2) * k1y, k2x, k2y);
+
+			T x1 = x + step_h * (T(1.5) * k1x + T(0.5) * k2x);
+			T y1 = y + step_h * (T(1.5) * k1y + T(0.5) * k2y);
+			//the embedded solution is not L-stable, so its raw difference tracks the stiff modes instead of
+			//the local error. filtering through W^-1 as radau5 does damps them back out
+			T ex, ey;
+			lu.solve(T(0.5) * step_h * (k1x + k2x), T(0.5) * step_h * (k1y + k2y), ex, ey);
+			double error = error_norm(tolerance, ex, ey, x, y, x1, y1);
+
+			if (!std::isfinite(error) || error > 1.0) {
+				//a stale Jacobian is the first suspect, a fresh one only leaves the step size
+				if (jacobian_age > 0)
+					refresh_jacobian();
+				double shrink = std::isfinite(error) ? 0.9 / std::sqrt(error) : 0.2;
+				h = step_h * T(shrink < 0.2 ? 0.2 : shrink);
+				rejected = true;
+				stats.rejected++;
+				continue;
+			}
+
+			//quadratic dense output through y, y' and the slope at y
+			dx0 = fx;
+			dy0 = fy;
+			previous_t = t;
+			t = last ? t_stop : t + step_h;
+			px = x;
+			py = y;
+			x = x1;
+			y = y1;
+			last_h = step_h;
+			eval(t, x, y, fx, fy);
+			jacobian_age++;
+			stats.accepted++;
+
+			double grow = error > 1e-10 ? 0.9 / std::sqrt(error) : 5.0;
+			//no growth straight after a rejection, the step that failed was only just too long
+			double most = rejected ? 1.0 : 5.0;
+			grow = grow > most ? most : grow;
+			//an estimate that keeps the step from growing is the stale J's as often as the solution's
+			if (grow < 1.0 && jacobian_age > 0)
+				refresh_jacobian();
+			if (!last)
+				h = step_h * T(grow);
+			return true;
+		}
+	}
+
+	//state anywhere inside the last accepted step [previous_t, t]
+	void dense(T time, T& out_x, T& out_y) const {
+		if (!(last_h > T(0))) {
+			out_x = x;
+			out_y = y;
+			return;
+		}
+		T theta = (time - previous_t) / last_h;
+		T lx = last_h * dx0;
+		T ly = last_h * dy0;
+		out_x = px + theta * (lx + theta * (x - px - lx));
+		out_y = py + theta * (ly + theta * (y - py - ly));
+	}
+
+	T t = T(0);
+	T x = T(0);
+	T y = T(0);
+	T previous_t = T(0);
+	T h = T(0);                 //next step size to try
+	StepStats stats;
+
+private:
+	void eval(T time, T ex, T ey, T& dx, T& dy) {
+		stats.evaluations++;
+		f(time, ex, ey, dx, dy);
+	}
+
+	void refresh_jacobian() {
+		stats.jacobians++;
+		f.jacobian(t, x, y, J);
+		jacobian_age = 0;
+		factored = false;
+	}
+
+	F& f;
+	Tolerance tolerance;
+	T gamma;
+	T J[4];
+	int jacobian_age = 0;
+	Lu2<T> lu;
+	bool factored = false;
+	T factored_h = T(0);
+	T fx = T(0), fy = T(0);     //derivative at (t, x, y)
+	T px = T(0), py = T(0);     //start of the last step
+	T dx0 = T(0), dy0 = T(0);
+	T last_h = T(0);
+};
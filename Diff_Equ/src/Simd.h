@@ -0,0 +1,243 @@
+#pragma once
+//thin wrappers over the widest float vectors the build targets, picked at compile time:
+//AVX-512 (16 lanes, /arch:AVX512), AVX2 (8 lanes, /arch:AVX2), SSE2 (4 lanes, x64 or /arch:SSE2), scalar otherwise.
+//the project builds AVX2, the others are checked by building with their flag and running --bench batch
+
+#include <cstdint>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define SIMD_WIDTH 16
+#define SIMD_NAME "avx-512"
+typedef __m512 simd_float;
+typedef __mmask16 simd_mask;
+
+static inline simd_float simd_load(const float* p) { return _mm512_load_ps(p); }
+static inline void simd_store(float* p, simd_float v) { _mm512_store_ps(p, v); }
+static inline simd_float simd_loadu(const float* p) { return _mm512_loadu_ps(p); }
+static inline void simd_storeu(float* p, simd_float v) { _mm512_storeu_ps(p, v); }
+static inline simd_float simd_set(float v) { return _mm512_set1_ps(v); }
+static inline simd_float simd_add(simd_float a, simd_float b) { return _mm512_add_ps(a, b); }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return _mm512_sub_ps(a, b); }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return _mm512_mul_ps(a, b); }
+static inline simd_float simd_div(simd_float a, simd_float b) { return _mm512_div_ps(a, b); }
+static inline simd_float simd_sqrt(simd_float a) { return _mm512_sqrt_ps(a); }
+static inline simd_float simd_min(simd_float a, simd_float b) { return _mm512_min_ps(a, b); }
+static inline simd_float simd_max(simd_float a, simd_float b) { return _mm512_max_ps(a, b); }
+static inline simd_float simd_abs(simd_float a) { return _mm512_abs_ps(a); }
+static inline simd_mask simd_lt(simd_float a, simd_float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+static inline simd_mask simd_le(simd_float a, simd_float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+static inline simd_mask simd_nonzero(simd_float a) { return _mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_NEQ_UQ); }
+static inline simd_mask simd_and(simd_mask a, simd_mask b) { return (simd_mask)(a & b); }
+static inline simd_mask simd_or(simd_mask a, simd_mask b) { return (simd_mask)(a | b); }
+static inline simd_mask simd_not(simd_mask a) { return (simd_mask)~a; }
+static inline simd_float simd_select(simd_mask m, simd_float yes, simd_float no) { return _mm512_mask_blend_ps(m, no, yes); }
+static inline simd_float simd_from_mask(simd_mask m) { return _mm512_maskz_mov_ps(m, _mm512_set1_ps(1.0f)); }
+static inline bool simd_any(simd_mask m) { return m != 0; }
+static inline simd_float simd_xor(simd_float a, simd_float b) { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_castps_si512(b))); }
+
+typedef __m512i simd_int;
+static inline simd_int simd_truncate(simd_float a) { return _mm512_cvttps_epi32(a); }
+static inline simd_float simd_to_float(simd_int a) { return _mm512_cvtepi32_ps(a); }
+static inline simd_int simd_int_add(simd_int a, int b) { return _mm512_add_epi32(a, _mm512_set1_epi32(b)); }
+static inline simd_int simd_int_and(simd_int a, int b) { return _mm512_and_si512(a, _mm512_set1_epi32(b)); }
+static inline simd_int simd_int_andnot(simd_int a, int b) { return _mm512_andnot_si512(a, _mm512_set1_epi32(b)); }
+static inline simd_mask simd_int_zero(simd_int a) { return _mm512_cmpeq_epi32_mask(a, _mm512_setzero_si512()); }
+static inline simd_float simd_bit2_to_sign(simd_int a) { return _mm512_castsi512_ps(_mm512_slli_epi32(a, 29)); }
+static inline simd_float simd_pow2(simd_int n) { return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(n, _mm512_set1_epi32(127)), 23)); }
+
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_WIDTH 8
+#define SIMD_NAME "avx2"
+typedef __m256 simd_float;
+typedef __m256 simd_mask;
+
+static inline simd_float simd_load(const float* p) { return _mm256_load_ps(p); }
+static inline void simd_store(float* p, simd_float v) { _mm256_store_ps(p, v); }
+static inline simd_float simd_loadu(const float* p) { return _mm256_loadu_ps(p); }
+static inline void simd_storeu(float* p, simd_float v) { _mm256_storeu_ps(p, v); }
+static inline simd_float simd_set(float v) { return _mm256_set1_ps(v); }
+static inline simd_float simd_add(simd_float a, simd_float b) { return _mm256_add_ps(a, b); }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return _mm256_sub_ps(a, b); }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return _mm256_mul_ps(a, b); }
+static inline simd_float simd_div(simd_float a, simd_float b) { return _mm256_div_ps(a, b); }
+static inline simd_float simd_sqrt(simd_float a) { return _mm256_sqrt_ps(a); }
+static inline simd_float simd_min(simd_float a, simd_float b) { return _mm256_min_ps(a, b); }
+static inline simd_float simd_max(simd_float a, simd_float b) { return _mm256_max_ps(a, b); }
+static inline simd_float simd_abs(simd_float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+static inline simd_mask simd_lt(simd_float a, simd_float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline simd_mask simd_le(simd_float a, simd_float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline simd_mask simd_nonzero(simd_float a) { return _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_NEQ_UQ); }
+static inline simd_mask simd_and(simd_mask a, simd_mask b) { return _mm256_and_ps(a, b); }
+static inline simd_mask simd_or(simd_mask a, simd_mask b) { return _mm256_or_ps(a, b); }
+static inline simd_mask simd_not(simd_mask a) { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+static inline simd_float simd_select(simd_mask m, simd_float yes, simd_float no) { return _mm256_blendv_ps(no, yes, m); }
+static inline simd_float simd_from_mask(simd_mask m) { return _mm256_and_ps(m, _mm256_set1_ps(1.0f)); }
+static inline bool simd_any(simd_mask m) { return _mm256_movemask_ps(m) != 0; }
+static inline simd_float simd_xor(simd_float a, simd_float b) { return _mm256_xor_ps(a, b); }
+
+typedef __m256i simd_int;
+static inline simd_int simd_truncate(simd_float a) { return _mm256_cvttps_epi32(a); }
+static inline simd_float simd_to_float(simd_int a) { return _mm256_cvtepi32_ps(a); }
+static inline simd_int simd_int_add(simd_int a, int b) { return _mm256_add_epi32(a, _mm256_set1_epi32(b)); }
+static inline simd_int simd_int_and(simd_int a, int b) { return _mm256_and_si256(a, _mm256_set1_epi32(b)); }
+static inline simd_int simd_int_andnot(simd_int a, int b) { return _mm256_andnot_si256(a, _mm256_set1_epi32(b)); }
+static inline simd_mask simd_int_zero(simd_int a) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, _mm256_setzero_si256())); }
+static inline simd_float simd_bit2_to_sign(simd_int a) { return _mm256_castsi256_ps(_mm256_slli_epi32(a, 29)); }
+static inline simd_float simd_pow2(simd_int n) { return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23)); }
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_WIDTH 4
+#define SIMD_NAME "sse2"
+typedef __m128 simd_float;
+typedef __m128 simd_mask;
+
+static inline simd_float simd_load(const float* p) { return _mm_load_ps(p); }
+static inline void simd_store(float* p, simd_float v) { _mm_store_ps(p, v); }
+static inline simd_float simd_loadu(const float* p) { return _mm_loadu_ps(p); }
+static inline void simd_storeu(float* p, simd_float v) { _mm_storeu_ps(p, v); }
+static inline simd_float simd_set(float v) { return _mm_set1_ps(v); }
+static inline simd_float simd_add(simd_float a, simd_float b) { return _mm_add_ps(a, b); }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return _mm_sub_ps(a, b); }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return _mm_mul_ps(a, b); }
+static inline simd_float simd_div(simd_float a, simd_float b) { return _mm_div_ps(a, b); }
+static inline simd_float simd_sqrt(simd_float a) { return _mm_sqrt_ps(a); }
+static inline simd_float simd_min(simd_float a, simd_float b) { return _mm_min_ps(a, b); }
+static inline simd_float simd_max(simd_float a, simd_float b) { return _mm_max_ps(a, b); }
+static inline simd_float simd_abs(simd_float a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline simd_mask simd_lt(simd_float a, simd_float b) { return _mm_cmplt_ps(a, b); }
+static inline simd_mask simd_le(simd_float a, simd_float b) { return _mm_cmple_ps(a, b); }
+static inline simd_mask simd_nonzero(simd_float a) { return _mm_cmpneq_ps(a, _mm_setzero_ps()); }
+static inline simd_mask simd_and(simd_mask a, simd_mask b) { return _mm_and_ps(a, b); }
+static inline simd_mask simd_or(simd_mask a, simd_mask b) { return _mm_or_ps(a, b); }
+static inline simd_mask simd_not(simd_mask a) { return _mm_xor_ps(a, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+static inline simd_float simd_select(simd_mask m, simd_float yes, simd_float no) { return _mm_or_ps(_mm_and_ps(m, yes), _mm_andnot_ps(m, no)); }
+static inline simd_float simd_from_mask(simd_mask m) { return _mm_and_ps(m, _mm_set1_ps(1.0f)); }
+static inline bool simd_any(simd_mask m) { return _mm_movemask_ps(m) != 0; }
+static inline simd_float simd_xor(simd_float a, simd_float b) { return _mm_xor_ps(a, b); }
+
+typedef __m128i simd_int;
+static inline simd_int simd_truncate(simd_float a) { return _mm_cvttps_epi32(a); }
+static inline simd_float simd_to_float(simd_int a) { return _mm_cvtepi32_ps(a); }
+static inline simd_int simd_int_add(simd_int a, int b) { return _mm_add_epi32(a, _mm_set1_epi32(b)); }
+static inline simd_int simd_int_and(simd_int a, int b) { return _mm_and_si128(a, _mm_set1_epi32(b)); }
+static inline simd_int simd_int_andnot(simd_int a, int b) { return _mm_andnot_si128(a, _mm_set1_epi32(b)); }
+static inline simd_mask simd_int_zero(simd_int a) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, _mm_setzero_si128())); }
+static inline simd_float simd_bit2_to_sign(simd_int a) { return _mm_castsi128_ps(_mm_slli_epi32(a, 29)); }
+static inline simd_float simd_pow2(simd_int n) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23)); }
+
+#else
+#include <cmath>
+#include <cstring>
+#define SIMD_WIDTH 1
+#define SIMD_NAME "scalar"
+typedef float simd_float;
+typedef bool simd_mask;
+
+static inline simd_float simd_load(const float* p) { return *p; }
+static inline void simd_store(float* p, simd_float v) { *p = v; }
+static inline simd_float simd_loadu(const float* p) { return *p; }
+static inline void simd_storeu(float* p, simd_float v) { *p = v; }
+static inline simd_float simd_set(float v) { return v; }
+static inline simd_float simd_add(simd_float a, simd_float b) { return a + b; }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return a - b; }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return a * b; }
+static inline simd_float simd_div(simd_float a, simd_float b) { return a / b; }
+static inline simd_float simd_sqrt(simd_float a) { return std::sqrt(a); }
+static inline simd_float simd_min(simd_float a, simd_float b) { return b < a ? b : a; }
+static inline simd_float simd_max(simd_float a, simd_float b) { return a < b ? b : a; }
+static inline simd_float simd_abs(simd_float a) { return std::fabs(a); }
+static inline simd_mask simd_lt(simd_float a, simd_float b) { return a < b; }
+static inline simd_mask simd_le(simd_float a, simd_float b) { return a <= b; }
+static inline simd_mask simd_nonzero(simd_float a) { return a != 0.0f; }
+static inline simd_mask simd_and(simd_mask a, simd_mask b) { return a && b; }
+static inline simd_mask simd_or(simd_mask a, simd_mask b) { return a || b; }
+static inline simd_mask simd_not(simd_mask a) { return !a; }
+static inline simd_float simd_select(simd_mask m, simd_float yes, simd_float no) { return m ? yes : no; }
+static inline simd_float simd_from_mask(simd_mask m) { return m ? 1.0f : 0.0f; }
+static inline bool simd_any(simd_mask m) { return m; }
+
+typedef int32_t simd_int;
+static inline float simd_bits(int32_t i) { float f; std::memcpy(&f, &i, sizeof(f)); return f; }
+static inline int32_t simd_int_bits(float f) { int32_t i; std::memcpy(&i, &f, sizeof(i)); return i; }
+static inline simd_float simd_xor(simd_float a, simd_float b) { return simd_bits(simd_int_bits(a) ^ simd_int_bits(b)); }
+static inline simd_int simd_truncate(simd_float a) { return (int32_t)a; }
+static inline simd_float simd_to_float(simd_int a) { return (float)a; }
+static inline simd_int simd_int_add(simd_int a, int b) { return a + b; }
+static inline simd_int simd_int_and(simd_int a, int b) { return a & b; }
+static inline simd_int simd_int_andnot(simd_int a, int b) { return ~a & b; }
+static inline simd_mask simd_int_zero(simd_int a) { return a == 0; }
+static inline simd_float simd_bit2_to_sign(simd_int a) { return simd_bits((int32_t)((uint32_t)a << 29)); }
+static inline simd_float simd_pow2(simd_int n) { return simd_bits((int32_t)((uint32_t)(n + 127) << 23)); }
+#endif
+
+//exprtk's relative-epsilon float equality, |a - b| <= max(1, |a|, |b|) * 1e-6
+static inline simd_mask simd_nearly_equal(simd_float a, simd_float b) {
+	simd_float scale = simd_max(simd_set(1.0f), simd_max(simd_abs(a), simd_abs(b)));
+	return simd_le(simd_abs(simd_sub(a, b)), simd_mul(scale, simd_set(0.000001f)));
+}
+
+//cephes style sin/cos/exp, within a couple of ulp of the C library for |x| <= 8192 (sin/cos)
+//and -87 <= x <= 88 (exp). callers send lanes outside those ranges, and NaNs, to std:: instead
+static inline simd_float simd_sin_poly(simd_float x, simd_float z) {
+	simd_float y = simd_add(simd_mul(simd_set(-1.9515295891e-4f), z), simd_set(8.3321608736e-3f));
+	y = simd_add(simd_mul(y, z), simd_set(-1.6666654611e-1f));
+	return simd_add(simd_mul(simd_mul(y, z), x), x);
+}
+
+static inline simd_float simd_cos_poly(simd_float z) {
+	simd_float y = simd_add(simd_mul(simd_set(2.443315711809948e-5f), z), simd_set(-1.388731625493765e-3f));
+	y = simd_add(simd_mul(y, z), simd_set(4.166664568298827e-2f));
+	y = simd_mul(simd_mul(y, z), z);
+	return simd_add(simd_sub(y, simd_mul(z, simd_set(0.5f))), simd_set(1.0f));
+}
+
+//reduces |x| by multiples of pi/4, octant gets the even octant index
+static inline simd_float simd_reduce_quarter_pi(simd_float x, simd_int& octant) {
+	octant = simd_int_and(simd_int_add(simd_truncate(simd_mul(x, simd_set(1.27323954473516f))), 1), ~1);
+	simd_float y = simd_to_float(octant);
+	x = simd_sub(x, simd_mul(y, simd_set(0.78515625f)));
+	x = simd_sub(x, simd_mul(y, simd_set(2.4187564849853515625e-4f)));
+	return simd_sub(x, simd_mul(y, simd_set(3.77489497744594108e-8f)));
+}
+
+static inline simd_float simd_sin(simd_float x) {
+	simd_float sign = simd_xor(x, simd_abs(x));
+	simd_int octant;
+	simd_float r = simd_reduce_quarter_pi(simd_abs(x), octant);
+	sign = simd_xor(sign, simd_bit2_to_sign(simd_int_and(octant, 4)));
+	simd_float z = simd_mul(r, r);
+	simd_float y = simd_select(simd_int_zero(simd_int_and(octant, 2)), simd_sin_poly(r, z), simd_cos_poly(z));
+	return simd_xor(y, sign);
+}
+
+static inline simd_float simd_cos(simd_float x) {
+	simd_int octant;
+	simd_float r = simd_reduce_quarter_pi(simd_abs(x), octant);
+	octant = simd_int_add(octant, -2);
+	simd_float sign = simd_bit2_to_sign(simd_int_andnot(octant, 4));
+	simd_float z = simd_mul(r, r);
+	simd_float y = simd_select(simd_int_zero(simd_int_and(octant, 2)), simd_sin_poly(r, z), simd_cos_poly(z));
+	return simd_xor(y, sign);
+}
+
+static inline simd_float simd_exp(simd_float x) {
+	simd_float fx = simd_add(simd_mul(x, simd_set(1.44269504088896341f)), simd_set(0.5f));
+	simd_float truncated = simd_to_float(simd_truncate(fx));
+	fx = simd_sub(truncated, simd_from_mask(simd_lt(fx, truncated)));
+
+	x = simd_sub(x, simd_mul(fx, simd_set(0.693359375f)));
+	x = simd_sub(x, simd_mul(fx, simd_set(-2.12194440e-4f)));
+	simd_float z = simd_mul(x, x);
+
+	simd_float y = simd_set(1.9875691500e-4f);
+	y = simd_add(simd_mul(y, x), simd_set(1.3981999507e-3f));
+	y = simd_add(simd_mul(y, x), simd_set(8.3334519073e-3f));
+	y = simd_add(simd_mul(y, x), simd_set(4.1665795894e-2f));
+	y = simd_add(simd_mul(y, x), simd_set(1.6666665459e-1f));
+	y = simd_add(simd_mul(y, x), simd_set(5.0000001201e-1f));
+	y = simd_add(simd_add(simd_mul(y, z), x), simd_set(1.0f));
+	return simd_mul(y, simd_pow2(simd_truncate(fx)));
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <cmath>
+#include <vector>
+
+#include "EvalContext.h"
+
+//evaluates a context's equations in scalar type T (float, double or DoubleDouble) through the lowered program.
+//each instance has its own register file, so one compiled context serves every precision.
+//equations that did not lower fall back to exprtk, which is float only
+template <typename T>
+class SystemEval {
+public:
+	explicit SystemEval(EvalContext& context) : context(&context) {
+		const Program& program = context.bytecode();
+		if (context.has_program()) {
+			registers.assign(program.num_registers, T(0));
+			program.init_registers(registers.data());
+		}
+		if (context.has_jacobian()) {
+			const Program& jacobian_program = context.jacobian_bytecode();
+			jacobian_registers.assign(jacobian_program.num_registers, T(0));
+			jacobian_program.init_registers(jacobian_registers.data());
+		}
+		for (const std::string& name : context.parameter_names())
+			parameters.push_back(context.parameter(name));
+	}
+
+	void operator()(T time, T pos_x, T pos_y, T& out_x, T& out_y) {
+		evaluations++;
+		if (registers.empty()) {
+			float fx, fy;
+			context->eval((float)time, (float)pos_x, (float)pos_y, fx, fy);
+			out_x = T(fx);
+			out_y = T(fy);
+			return;
+		}
+
+		const Program& program = context->bytecode();
+		T* r = registers.data();
+		r[0] = pos_x;
+		r[1] = pos_y;
+		r[2] = time;
+		for (size_t i = 0; i < parameters.size(); i++)
+			r[3 + i] = T(*parameters[i]);
+		program.run(r);
+		out_x = r[program.outputs[0]];
+		out_y = r[program.outputs[1]];
+	}
+
+	//row major d(dx)/dx, d(dx)/dy, d(dy)/dx, d(dy)/dy from the symbolic Jacobian,
+	//central differences when the equations could not be differentiated
+	void jacobian(T time, T pos_x, T pos_y, T* out) {
+		if (jacobian_registers.empty()) {
+			central_jacobian(time, pos_x, pos_y, out);
+			return;
+		}
+
+		jacobian_evaluations++;
+		const Program& program = context->jacobian_bytecode();
+		T* r = jacobian_registers.data();
+		r[0] = pos_x;
+		r[1] = pos_y;
+		r[2] = time;
+		for (size_t i = 0; i < parameters.size(); i++)
+			r[3 + i] = T(*parameters[i]);
+		program.run(r);
+		for (int i = 0; i < 4; i++)
+			out[i] = r[program.outputs[i]];
+	}
+
+	//four extra evaluations, step scaled by the cube root of the type's epsilon
+	void central_jacobian(T time, T pos_x, T pos_y, T* out) {
+		using std::fabs;
+		const T root_epsilon = T(sizeof(T) == sizeof(float) ? 4.9e-3 : 6.1e-6);
+		T hx = root_epsilon * (fabs(pos_x) > T(1) ? fabs(pos_x) : T(1));
+		T hy = root_epsilon * (fabs(pos_y) > T(1) ? fabs(pos_y) : T(1));
+		T px, py, mx, my;
+		(*this)(time, pos_x + hx, pos_y, px, py);
+		(*this)(time, pos_x - hx, pos_y, mx, my);
+		out[0] = (px - mx) / (hx + hx);
+		out[2] = (py - my) / (hx + hx);
+		(*this)(time, pos_x, pos_y + hy, px, py);
+		(*this)(time, pos_x, pos_y - hy, mx, my);
+		out[1] = (px - mx) / (hy + hy);
+		out[3] = (py - my) / (hy + hy);
+	}
+
+	//normalized Taylor coefficients 0..order of the solution through (time, pos_x, pos_y),
+	//xs and ys hold order + 1 values. only valid when has_taylor()
+	void taylor(T time, T pos_x, T pos_y, int order, T* xs, T* ys) {
+		taylor_expansions++;
+		const TaylorProgram& program = context->taylor_series();
+		taylor_inputs.resize(3 + parameters.size());
+		taylor_inputs[0] = pos_x;
+		taylor_inputs[1] = pos_y;
+		taylor_inputs[2] = time;
+		for (size_t i = 0; i < parameters.size(); i++)
+			taylor_inputs[3 + i] = T(*parameters[i]);
+		taylor_work.resize(program.workspace(order));
+		program.expand(taylor_inputs.data(), order, xs, ys, taylor_work.data());
+	}
+
+	bool exact() const { return !registers.empty(); }   //false when stuck at float through exprtk
+	bool exact_jacobian() const { return !jacobian_registers.empty(); }
+	bool has_taylor() const { return context->has_taylor(); }
+
+	unsigned long long evaluations = 0;
+	unsigned long long jacobian_evaluations = 0;     //symbolic ones, central differences count as evaluations
+	unsigned long long taylor_expansions = 0;
+
+private:
+	EvalContext* context;
+	std::vector<T> registers;
+	std::vector<T> jacobian_registers;
+	std::vector<T> taylor_inputs;
+	std::vector<T> taylor_work;
+	std::vector<const float*> parameters;
+};
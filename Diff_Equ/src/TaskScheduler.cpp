@@ -0,0 +1,115 @@
+#include "TaskScheduler.h"
+
+TaskScheduler::TaskScheduler(int threads) : steals(0), queued(0) {
+	if (threads <= 0) {
+		int hardware = (int)std::thread::hardware_concurrency();
+		threads = hardware > 1 ? hardware - 1 : 0;
+	}
+	wanted = threads;
+	queues.resize(threads + 1);
+	for (std::unique_ptr<Queue>& queue : queues)
+		queue.reset(new Queue());
+}
+
+TaskScheduler::~TaskScheduler() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread : workers)
+		thread.join();
+}
+
+//threads start on the first loop that needs them so --bench runs and the UI never pay for an idle pool
+void TaskScheduler::start() {
+	for (int i = 0; i < wanted; i++)
+		workers.push_back(std::thread(&TaskScheduler::worker, this, i));
+	wanted = 0;
+}
+
+void TaskScheduler::run_job(Job& job) {
+	if (wanted > 0)
+		start();
+	jobs++;
+
+	//the caller splits first, which hands the upper halves out, then helps until every item is done
+	const int self = threads();
+	execute(Range{ &job, 0, job.remaining.load() }, self);
+	while (job.remaining.load(std::memory_order_acquire) > 0) {
+		Range range;
+		if (pop(self, range) || steal(self, range))
+			execute(range, self);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void TaskScheduler::execute(Range range, int self) {
+	Job& job = *range.job;
+	while (range.end - range.begin > job.chunk) {
+		size_t half = (range.end - range.begin) / 2;
+		size_t middle = range.begin + (half + job.chunk - 1) / job.chunk * job.chunk;
+		if (middle >= range.end)
+			break;
+		push(self, Range{ range.job, middle, range.end });
+		range.end = middle;
+	}
+	job.run(job.body, range.begin, range.end, self);
+	job.remaining.fetch_sub(range.end - range.begin, std::memory_order_release);
+}
+
+void TaskScheduler::push(int self, const Range& range) {
+	{
+		std::lock_guard<std::mutex> lock(queues[self]->mutex);
+		queues[self]->ranges.push_back(range);
+	}
+	queued.fetch_add(1);
+	//taking the sleep lock orders the push before a worker's last look at queued, so no wakeup is lost
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wake.notify_one();
+}
+
+bool TaskScheduler::pop(int self, Range& range) {
+	std::lock_guard<std::mutex> lock(queues[self]->mutex);
+	std::deque<Range>& ranges = queues[self]->ranges;
+	if (ranges.empty())
+		return false;
+	range = ranges.back();
+	ranges.pop_back();
+	queued.fetch_sub(1);
+	return true;
+}
+
+//oldest range of the first non-empty deque after our own, the oldest is the biggest
+bool TaskScheduler::steal(int self, Range& range) {
+	const int count = participants();
+	for (int i = 1; i < count; i++) {
+		Queue& victim = *queues[(self + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.ranges.empty())
+			continue;
+		range = victim.ranges.front();
+		victim.ranges.pop_front();
+		queued.fetch_sub(1);
+		steals.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+void TaskScheduler::worker(int self) {
+	while (true) {
+		Range range;
+		if (pop(self, range) || steal(self, range)) {
+			execute(range, self);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+		if (stopping)
+			return;
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//work-stealing pool for data parallel loops. every participant owns a deque: it pushes and pops ranges at
+//the back, idle ones steal from the front of someone else's, so large pieces migrate and small ones stay
+//where their data is warm. ranges split lazily, a participant holding more than one chunk pushes the upper
+//half and keeps going on the lower, so a loop only fans out as far as there are idle threads to take it.
+//the calling thread is participant threads() and works too, bodies get their participant index to pick
+//per-thread state (WorkerContexts, scratch). one loop at a time, bodies must not start another
+class TaskScheduler {
+public:
+	//0 uses every hardware thread, the caller counting as one of them
+	explicit TaskScheduler(int threads = 0);
+	~TaskScheduler();
+	TaskScheduler(const TaskScheduler&) = delete;
+	TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+	int threads() const { return (int)queues.size() - 1; }
+	int participants() const { return (int)queues.size(); }
+
+	//body(begin, end, participant) over [0, count) in pieces of at most chunk, returns when all are done.
+	//a loop of one chunk, or a pool without threads, runs inline on the caller
+	template <typename Body>
+	void parallel_for(size_t count, size_t chunk, const Body& body) {
+		if (count == 0)
+			return;
+		chunk = chunk < 1 ? 1 : chunk;
+		if (count <= chunk || queues.size() == 1) {
+			body((size_t)0, count, threads());
+			return;
+		}
+		Job job;
+		job.run = &call<Body>;
+		job.body = &body;
+		job.chunk = chunk;
+		job.remaining.store(count);
+		run_job(job);
+	}
+
+	//loops run so far and ranges that were taken from another participant's deque
+	unsigned long long jobs = 0;
+	std::atomic<unsigned long long> steals;
+
+private:
+	struct Job {
+		void (*run)(const void* body, size_t begin, size_t end, int participant);
+		const void* body;
+		size_t chunk;
+		std::atomic<size_t> remaining;      //items not yet finished
+	};
+
+	struct Range {
+		Job* job;
+		size_t begin;
+		size_t end;
+	};
+
+	//separately allocated and padded past a cache line, owners and thieves hammer different deques
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Range> ranges;
+		char padding[64];
+	};
+
+	template <typename Body>
+	static void call(const void* body, size_t begin, size_t end, int participant) {
+		(*static_cast<const Body*>(body))(begin, end, participant);
+	}
+
+	void start();
+	void worker(int self);
+	void run_job(Job& job);
+	void execute(Range range, int self);
+	void push(int self, const Range& range);
+	bool pop(int self, Range& range);
+	bool steal(int self, Range& range);
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<Queue>> queues;     //one per participant, the caller's last
+	int wanted;
+	std::atomic<int> queued;                        //ranges sitting in any deque
+
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+};
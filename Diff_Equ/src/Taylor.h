@@ -0,0 +1,121 @@
+#pragma once
+#include <cmath>
+
+#include "Adaptive.h"
+
+//Taylor series integrator on the coefficient recurrences of EvalContext::taylor_series(). every step expands
+//the solution to order p at the current point and sums the polynomial, so the step size comes from the
+//series itself and nothing is ever rejected. p follows the tolerance like Jorba and Zou, about
+//-ln(tol) / 2 + 1 kept within [10, 30], and the step is where the last two terms fall to the tolerance.
+//dense output is the step's own polynomial, as accurate as the steps. needs equations that lowered
+//(f.has_taylor()), otherwise step() fails straight away. stats.evaluations counts expansions,
+//each about p / 2 plain evaluations of work
+template <typename T, typename F>
+class Taylor {
+public:
+	static const int min_order = 10;
+	static const int max_order = 30;
+
+	Taylor(F& f, Tolerance tolerance) : f(f), tolerance(tolerance) {
+		double tol = std::fmin(tolerance.relative, tolerance.absolute);
+		order = (int)std::ceil(1.0 - 0.5 * std::log(tol > 0.0 ? tol : 1e-300));
+		order = order < min_order ? min_order : (order > max_order ? max_order : order);
+	}
+
+	//steps are sized from their own series, first_step > 0 only caps the first one
+	void start(T t0, T x0, T y0, T first_step = T(0)) {
+		t = previous_t = t0;
+		x = x0;
+		y = y0;
+		h = T(0);
+		first_cap = first_step;
+		stats = StepStats();
+	}
+
+	//one step that never passes t_stop. false once t_stop is reached, when the equations have
+	//no Taylor program, or when the series stops being finite
+	bool step(T t_stop) {
+		if (!(t < t_stop) || !f.has_taylor())
+			return false;
+
+		f.taylor(t, x, y, order, xs, ys);
+		stats.evaluations++;
+
+		//radius where the last two terms reach the tolerance, both so an odd or even series is not cut short
+		double scale = tolerance.absolute + tolerance.relative * std::fmax(std::fabs((double)x), std::fabs((double)y));
+		double limit = INFINITY;
+		for (int j = order - 1; j <= order; j++) {
+			double term = std::fmax(std::fabs((double)xs[j]), std::fabs((double)ys[j]));
+			if (!std::isfinite(term))
+				return false;
+			if (term > 0.0)
+				limit = std::fmin(limit, std::pow(scale / term, 1.0 / j));
+		}
+
+		T step_h = t_stop - t;
+		bool last = true;
+		if (limit < (double)step_h) {
+			step_h = T(safety * limit);
+			last = false;
+		}
+		if (first_cap > T(0) && step_h > first_cap) {
+			step_h = first_cap;
+			last = false;
+		}
+		if (!(step_h > T(0)) || (double)step_h <= std::fabs((double)t) * 1e-15)
+			return false;
+
+		T nx, ny;
+		sum(step_h, nx, ny);
+		if (!std::isfinite((double)nx) || !std::isfinite((double)ny))
+			return false;
+
+		previous_t = t;
+		t = last ? t_stop : t + step_h;
+		x = nx;
+		y = ny;
+		h = step_h;
+		first_cap = T(0);
+		stats.accepted++;
+		return true;
+	}
+
+	//state anywhere inside the last step [previous_t, t] from its series
+	void dense(T time, T& out_x, T& out_y) const {
+		if (!(h > T(0))) {
+			out_x = x;
+			out_y = y;
+			return;
+		}
+		sum(time - previous_t, out_x, out_y);
+	}
+
+	T t = T(0);
+	T x = T(0);
+	T y = T(0);
+	T previous_t = T(0);
+	T h = T(0);                 //last step size
+	int order = min_order;
+	StepStats stats;
+
+private:
+	static constexpr double safety = 0.9;
+
+	//Horner on the coefficients of the last expansion
+	void sum(T s, T& out_x, T& out_y) const {
+		T sx = xs[order];
+		T sy = ys[order];
+		for (int j = order - 1; j >= 0; j--) {
+			sx = sx * s + xs[j];
+			sy = sy * s + ys[j];
+		}
+		out_x = sx;
+		out_y = sy;
+	}
+
+	F& f;
+	Tolerance tolerance;
+	T first_cap = T(0);         //start()'s first_step until the first step is taken
+	T xs[max_order + 1];
+	T ys[max_order + 1];
+};
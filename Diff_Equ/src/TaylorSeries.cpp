@@ -0,0 +1,326 @@
+#include "TaylorSeries.h"
+
+#include <cmath>
+
+#include "DoubleDouble.h"
+#include "ExprMath.h"
+
+static const int max_integer_power = 16;
+
+//helper series each op needs next to its own
+static int helper_count(const TaylorOp& op) {
+	switch (op.op) {
+	case ExprOp::Sin: case ExprOp::Cos: case ExprOp::Sinh: case ExprOp::Cosh:   //the partner function
+	case ExprOp::Tan: case ExprOp::Tanh:                                        //1 +- w^2
+	case ExprOp::Asin: case ExprOp::Acos:                                       //sqrt(1 - u^2)
+	case ExprOp::Atan:                                                          //1 + u^2
+	case ExprOp::Atan2:                                                         //a^2 + b^2
+		return 1;
+	case ExprOp::Pow:
+		if (op.power == TaylorProgram::variable_power)
+			return 2;                                                           //log a, b log a
+		return op.power > 2 ? op.power - 2 : 0;                                 //a^2 .. a^(n-1)
+	default:
+		return 0;
+	}
+}
+
+bool TaylorProgram::build(const ExprTree& tree, const std::vector<int>& roots, int inputs) {
+	tape.clear();
+	num_inputs = inputs;
+	num_series = 0;
+	outputs[0] = outputs[1] = -1;
+	if (roots.size() != 2 || roots[0] < 0 || roots[1] < 0)
+		return false;
+
+	//only what the roots read, children precede parents so one backward pass marks it all
+	size_t n = tree.nodes.size();
+	std::vector<char> live(n, 0);
+	live[roots[0]] = live[roots[1]] = 1;
+	for (size_t i = n; i-- > 0;) {
+		if (!live[i])
+			continue;
+		const ExprNode& node = tree.nodes[i];
+		if (node.a >= 0) live[node.a] = 1;
+		if (node.b >= 0) live[node.b] = 1;
+		if (node.c >= 0) live[node.c] = 1;
+	}
+
+	std::vector<int> series(n, -1);
+	for (size_t i = 0; i < n; i++) {
+		if (!live[i])
+			continue;
+		const ExprNode& node = tree.nodes[i];
+		if (node.op == ExprOp::Var && (node.slot < 0 || node.slot >= inputs))
+			return false;
+
+		TaylorOp op;
+		op.op = node.op;
+		op.a = node.a >= 0 ? series[node.a] : -1;
+		op.b = node.b >= 0 ? series[node.b] : -1;
+		op.c = node.c >= 0 ? series[node.c] : -1;
+		op.aux = -1;
+		op.power = 0;
+		op.slot = node.slot;
+		op.value = node.value;
+		if (node.op == ExprOp::Pow) {
+			const ExprNode& exponent = tree.nodes[node.b];
+			double e = exponent.value;
+			if (exponent.op != ExprOp::Const)
+				op.power = variable_power;
+			else if (e >= 0.0 && e <= max_integer_power && e == std::floor(e))
+				op.power = (int)e;
+			else {
+				op.power = constant_power;
+				op.value = e;
+			}
+		}
+		series[i] = (int)tape.size();
+		tape.push_back(op);
+	}
+
+	num_series = (int)tape.size();
+	for (TaylorOp& op : tape) {
+		int helpers = helper_count(op);
+		if (helpers) {
+			op.aux = num_series;
+			num_series += helpers;
+		}
+	}
+	outputs[0] = series[roots[0]];
+	outputs[1] = series[roots[1]];
+	return true;
+}
+
+//coefficient k of u v
+template <typename T>
+static inline T product(const T* u, const T* v, int k) {
+	T sum = T(0);
+	for (int j = 0; j <= k; j++)
+		sum += u[j] * v[k - j];
+	return sum;
+}
+
+//coefficient k >= 1 of w where w' = g u'
+template <typename T>
+static inline T chain(const T* u, const T* g, int k) {
+	T sum = T(0);
+	for (int j = 1; j <= k; j++)
+		sum += T(j) * u[j] * g[k - j];
+	return sum / T(k);
+}
+
+//coefficient k >= 1 of w where r w' = p, numerator = p_(k-1) / k
+template <typename T>
+static inline T divided(const T* w, const T* r, T numerator, int k) {
+	T sum = T(0);
+	for (int j = 1; j < k; j++)
+		sum += T(j) * w[j] * r[k - j];
+	return (numerator - sum / T(k)) / r[0];
+}
+
+//coefficient k >= 1 of w where w^2 = s, square = s_k
+template <typename T>
+static inline T root(const T* w, T square, int k) {
+	T sum = T(0);
+	for (int j = 1; j < k; j++)
+		sum += w[j] * w[k - j];
+	return (square - sum) / (T(2) * w[0]);
+}
+
+//coefficient k of one tape node (and its helpers), all lower coefficients and the children's k-th are in place
+template <typename T>
+static void coefficient(const TaylorOp& op, T* work, int stride, int self, int k) {
+	using namespace std;
+	T* w = work + (size_t)self * stride;
+	const T* a = op.a >= 0 ? work + (size_t)op.a * stride : nullptr;
+	const T* b = op.b >= 0 ? work + (size_t)op.b * stride : nullptr;
+	const T* c = op.c >= 0 ? work + (size_t)op.c * stride : nullptr;
+	T* h = op.aux >= 0 ? work + (size_t)op.aux * stride : nullptr;
+	bool first = k == 0;
+
+	switch (op.op) {
+	case ExprOp::Const: w[k] = first ? T(op.value) : T(0); break;
+	case ExprOp::Var: break;
+	case ExprOp::Neg: w[k] = -a[k]; break;
+	case ExprOp::Add: w[k] = a[k] + b[k]; break;
+	case ExprOp::Sub: w[k] = a[k] - b[k]; break;
+	case ExprOp::Mul: w[k] = product(a, b, k); break;
+	case ExprOp::Div: {
+		T sum = a[k];
+		for (int j = 1; j <= k; j++)
+			sum -= b[j] * w[k - j];
+		w[k] = sum / b[0];
+		break;
+	}
+	//a - trunc(a / b) b, the quotient stays at its expansion point value
+	case ExprOp::Mod: w[k] = first ? fmod(a[0], b[0]) : a[k] - trunc(a[0] / b[0]) * b[k]; break;
+	case ExprOp::Pow:
+		if (op.power == TaylorProgram::variable_power) {
+			T* l = h;
+			T* m = h + stride;
+			l[k] = first ? log(a[0]) : divided(l, a, a[k], k);
+			m[k] = product(b, l, k);
+			w[k] = first ? pow(a[0], b[0]) : chain(m, w, k);
+		}
+		else if (op.power == TaylorProgram::constant_power) {
+			if (first) {
+				w[0] = pow(a[0], T(op.value));
+				break;
+			}
+			T sum = T(0);
+			for (int j = 1; j <= k; j++)
+				sum += (T(op.value + 1.0) * T(j) - T(k)) * a[j] * w[k - j];
+			w[k] = sum / (T(k) * a[0]);
+		}
+		else if (op.power == 0) {
+			w[k] = first ? T(1) : T(0);
+		}
+		else if (op.power == 1) {
+			w[k] = a[k];
+		}
+		else {
+			//a^2, a^3, .. a^(n-1) in the helpers, then one more product
+			const T* previous = a;
+			for (int p = 0; p < op.power - 2; p++) {
+				T* next = h + (size_t)p * stride;
+				next[k] = product(previous, a, k);
+				previous = next;
+			}
+			w[k] = product(previous, a, k);
+		}
+		break;
+	case ExprOp::Abs: w[k] = a[0] < T(0) ? -a[k] : a[k]; break;
+	case ExprOp::Sqrt: w[k] = first ? sqrt(a[0]) : root(w, a[k], k); break;
+	case ExprOp::Exp: w[k] = first ? exp(a[0]) : chain(a, w, k); break;
+	case ExprOp::Log: w[k] = first ? log(a[0]) : divided(w, a, a[k], k); break;
+	case ExprOp::Log2: w[k] = first ? log2(a[0]) : divided(w, a, a[k] / log(T(2)), k); break;
+	case ExprOp::Log10: w[k] = first ? log10(a[0]) : divided(w, a, a[k] / log(T(10)), k); break;
+	case ExprOp::Sin:
+	case ExprOp::Cos: {
+		//sin' = cos u', cos' = -sin u'
+		T* s = op.op == ExprOp::Sin ? w : h;
+		T* co = op.op == ExprOp::Sin ? h : w;
+		if (first) {
+			s[0] = sin(a[0]);
+			co[0] = cos(a[0]);
+		} else {
+			s[k] = chain(a, (const T*)co, k);
+			co[k] = -chain(a, (const T*)s, k);
+		}
+		break;
+	}
+	case ExprOp::Sinh:
+	case ExprOp::Cosh: {
+		T* s = op.op == ExprOp::Sinh ? w : h;
+		T* co = op.op == ExprOp::Sinh ? h : w;
+		if (first) {
+			s[0] = sinh(a[0]);
+			co[0] = cosh(a[0]);
+		} else {
+			s[k] = chain(a, (const T*)co, k);
+			co[k] = chain(a, (const T*)s, k);
+		}
+		break;
+	}
+	case ExprOp::Tan:
+	case ExprOp::Tanh: {
+		//tan' = (1 + tan^2) u', tanh' = (1 - tanh^2) u'
+		T sign = op.op == ExprOp::Tan ? T(1) : T(-1);
+		w[k] = first ? (op.op == ExprOp::Tan ? tan(a[0]) : tanh(a[0])) : chain(a, (const T*)h, k);
+		h[k] = sign * product(w, w, k) + (first ? T(1) : T(0));
+		break;
+	}
+	case ExprOp::Asin:
+	case ExprOp::Acos: {
+		//sqrt(1 - u^2) w' = +-u'
+		T sign = op.op == ExprOp::Asin ? T(1) : T(-1);
+		if (first) {
+			w[0] = op.op == ExprOp::Asin ? asin(a[0]) : acos(a[0]);
+			h[0] = sqrt(T(1) - a[0] * a[0]);
+		} else {
+			w[k] = divided(w, (const T*)h, sign * a[k], k);
+			h[k] = root(h, -product(a, a, k), k);
+		}
+		break;
+	}
+	case ExprOp::Atan:
+		h[k] = product(a, a, k) + (first ? T(1) : T(0));
+		w[k] = first ? atan(a[0]) : divided(w, (const T*)h, a[k], k);
+		break;
+	case ExprOp::Atan2: {
+		//(a^2 + b^2) w' = b a' - a b'
+		h[k] = product(a, a, k) + product(b, b, k);
+		if (first) {
+			w[0] = atan2(a[0], b[0]);
+			break;
+		}
+		T numerator = T(0);
+		for (int j = 0; j < k; j++)
+			numerator += T(k - j) * (b[j] * a[k - j] - a[j] * b[k - j]);
+		w[k] = divided(w, (const T*)h, numerator / T(k), k);
+		break;
+	}
+	case ExprOp::Hypot: w[k] = first ? hypot(a[0], b[0]) : root(w, product(a, a, k) + product(b, b, k), k); break;
+	case ExprOp::Min: w[k] = first ? fmin(a[0], b[0]) : (b[0] < a[0] ? b[k] : a[k]); break;
+	case ExprOp::Max: w[k] = first ? fmax(a[0], b[0]) : (b[0] > a[0] ? b[k] : a[k]); break;
+	case ExprOp::Select: w[k] = a[0] != T(0) ? b[k] : c[k]; break;
+	default: {
+		//piecewise constant: rounding, sign, comparisons and logic
+		if (!first) {
+			w[k] = T(0);
+			break;
+		}
+		switch (op.op) {
+		case ExprOp::Floor: w[0] = floor(a[0]); break;
+		case ExprOp::Ceil: w[0] = ceil(a[0]); break;
+		case ExprOp::Round: w[0] = round_half_away(a[0]); break;
+		case ExprOp::Trunc: w[0] = trunc(a[0]); break;
+		case ExprOp::Sgn: w[0] = sign_of(a[0]); break;
+		case ExprOp::Lt: w[0] = a[0] < b[0] ? T(1) : T(0); break;
+		case ExprOp::Le: w[0] = a[0] <= b[0] ? T(1) : T(0); break;
+		case ExprOp::Gt: w[0] = a[0] > b[0] ? T(1) : T(0); break;
+		case ExprOp::Ge: w[0] = a[0] >= b[0] ? T(1) : T(0); break;
+		case ExprOp::Eq: w[0] = nearly_equal(a[0], b[0]) ? T(1) : T(0); break;
+		case ExprOp::Ne: w[0] = nearly_equal(a[0], b[0]) ? T(0) : T(1); break;
+		case ExprOp::And: w[0] = (a[0] != T(0) && b[0] != T(0)) ? T(1) : T(0); break;
+		case ExprOp::Or: w[0] = (a[0] != T(0) || b[0] != T(0)) ? T(1) : T(0); break;
+		case ExprOp::Not: w[0] = a[0] == T(0) ? T(1) : T(0); break;
+		default: w[0] = T(0); break;
+		}
+		break;
+	}
+	}
+}
+
+template <typename T>
+void TaylorProgram::expand(const T* inputs, int order, T* xs, T* ys, T* work) const {
+	const int stride = order + 1;
+	xs[0] = inputs[0];
+	ys[0] = inputs[1];
+	for (int k = 0; k < order; k++) {
+		for (size_t i = 0; i < tape.size(); i++) {
+			const TaylorOp& op = tape[i];
+			if (op.op != ExprOp::Var) {
+				coefficient(op, work, stride, (int)i, k);
+				continue;
+			}
+			//the state follows its own series, t is t0 + (t - t0), parameters are constant
+			T* w = work + i * stride;
+			if (op.slot == 0)
+				w[k] = xs[k];
+			else if (op.slot == 1)
+				w[k] = ys[k];
+			else if (op.slot == 2)
+				w[k] = k == 0 ? inputs[2] : (k == 1 ? T(1) : T(0));
+			else
+				w[k] = k == 0 ? inputs[op.slot] : T(0);
+		}
+		xs[k + 1] = work[(size_t)outputs[0] * stride + k] / T(k + 1);
+		ys[k + 1] = work[(size_t)outputs[1] * stride + k] / T(k + 1);
+	}
+}
+
+template void TaylorProgram::expand<float>(const float*, int, float*, float*, float*) const;
+template void TaylorProgram::expand<double>(const double*, int, double*, double*, double*) const;
+template void TaylorProgram::expand<DoubleDouble>(const DoubleDouble*, int, DoubleDouble*, DoubleDouble*, DoubleDouble*) const;
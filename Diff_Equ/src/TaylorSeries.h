@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+
+#include "Expr.h"
+
+//one node of the Taylor tape, children and helpers are series indices
+struct TaylorOp {
+	ExprOp op;
+	int a;
+	int b;
+	int c;
+	int aux;        //first helper series (cos beside sin, 1 + w^2 beside tan, ...), -1 when none
+	int power;      //Pow: >= 0 a small integer exponent as a chain of products, constant_power or variable_power
+	int slot;       //Var, index into the inputs
+	double value;   //Const value, constant exponent of Pow
+};
+
+//Taylor-mode automatic differentiation of the lowered equations. every reachable node owns a series of
+//normalized coefficients w_k = w^(k)(t) / k!, and pass k computes coefficient k of each node from its
+//children's first k + 1 and its own first k: products are convolutions, exp/log/sin/... follow from the
+//linear ODE each satisfies (w' = w u' for exp). piecewise ops keep the branch of the expansion point.
+//an ODE feeds its own series back in, x_(k+1) = dx_k / (k + 1), so order p costs p passes of O(k) each
+class TaylorProgram {
+public:
+	static const int constant_power = -1;   //a^c from a w' = c a' w, needs a != 0
+	static const int variable_power = -2;   //a^b as exp(b log a)
+
+	//false when a root is missing or a symbol slot is out of range
+	bool build(const ExprTree& tree, const std::vector<int>& roots, int num_inputs);
+
+	//coefficients 0..order of x(t) and y(t) through inputs (x, y, t, then the parameters) at t.
+	//work holds workspace(order) values. instantiated for float, double and DoubleDouble
+	template <typename T>
+	void expand(const T* inputs, int order, T* xs, T* ys, T* work) const;
+
+	size_t workspace(int order) const { return (size_t)num_series * (order + 1); }
+	bool empty() const { return tape.empty(); }
+
+	int num_inputs = 0;
+	int num_series = 0;             //tape nodes, then helper series
+	std::vector<TaylorOp> tape;     //children before parents, tape[i] fills series i
+	int outputs[2] = { -1, -1 };    //series of dx and dy
+};
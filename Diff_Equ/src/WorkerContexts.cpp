@@ -0,0 +1,25 @@
+#include "WorkerContexts.h"
+
+#include <chrono>
+
+void WorkerContexts::bind(EvalContext& context, int participants) {
+	size_t wanted = participants > 1 ? (size_t)(participants - 1) : 0;
+	if (&context != source || context.generation() != generation || copies.size() != wanted) {
+		auto start = std::chrono::steady_clock::now();
+		source = &context;
+		generation = context.generation();
+		copies.clear();
+		for (size_t i = 0; i < wanted; i++) {
+			copies.emplace_back(new EvalContext());
+			copies.back()->clone_from(context);
+		}
+		build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		builds++;
+	}
+
+	//the native toggle can flip without a recompile
+	for (std::unique_ptr<EvalContext>& copy : copies) {
+		copy->copy_parameters(context);
+		copy->enable_native(context.native_allowed());
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "EvalContext.h"
+
+//a private instance of the active system for every TaskScheduler participant. exprtk expressions and the
+//batch evaluator's registers belong to their context, so two threads must never evaluate through one.
+//the calling thread's participant (the last) uses the source itself
+class WorkerContexts {
+public:
+	//re-clones the copies when source is another system or was recompiled, then copies its parameter values,
+	//so sliders moved since the last loop are seen by every thread
+	void bind(EvalContext& source, int participants);
+
+	EvalContext& operator[](int participant) {
+		return participant < (int)copies.size() ? *copies[participant] : *source;
+	}
+
+	double build_ms = 0.0;      //time the last rebuild took
+	int builds = 0;
+
+private:
+	EvalContext* source = nullptr;
+	unsigned long long generation = 0;
+	std::vector<std::unique_ptr<EvalContext>> copies;
+};